@@ -104,6 +104,18 @@ bool KFileItemListView::enlargeSmallPreviews() const
     return m_modelRolesUpdater ? m_modelRolesUpdater->enlargeSmallPreviews() : false;
 }
 
+void KFileItemListView::setDirectoryContentsSizeShown(bool show)
+{
+    if (m_modelRolesUpdater) {
+        m_modelRolesUpdater->setDirectoryContentsSizeShown(show);
+    }
+}
+
+bool KFileItemListView::directoryContentsSizeShown() const
+{
+    return m_modelRolesUpdater ? m_modelRolesUpdater->directoryContentsSizeShown() : false;
+}
+
 void KFileItemListView::setEnabledPlugins(const QStringList& list)
 {
     if (m_modelRolesUpdater) {
@@ -211,6 +223,15 @@ void KFileItemListView::initializeItemListWidget(KItemListWidget* item)
     }
 }
 
+bool KFileItemListView::itemSizeHintUpdateRequired(const QSet<QByteArray>& changedRoles) const
+{
+    // The "size" of a directory is shown as the size of its contents if it is known.
+    if (changedRoles.contains("contentsSize") && visibleRoles().contains("size")) {
+        return true;
+    }
+    return KStandardItemListView::itemSizeHintUpdateRequired(changedRoles);
+}
+
 void KFileItemListView::onPreviewsShownChanged(bool shown)
 {
     Q_UNUSED(shown);
@@ -54,6 +54,14 @@ public:
     void setEnlargeSmallPreviews(bool enlarge);
     bool enlargeSmallPreviews() const;
 
+    /**
+     * If enabled, the "size" of directories is shown as the size of their
+     * contents instead of the number of their items. Per default the number
+     * of items is shown.
+     */
+    void setDirectoryContentsSizeShown(bool show);
+    bool directoryContentsSizeShown() const;
+
     /**
      * Sets the list of enabled thumbnail plugins that are used for previews.
      * Per default all plugins enabled in the KConfigGroup "PreviewSettings"
@@ -76,6 +84,7 @@ public:
 protected:
     KItemListWidgetCreatorBase* defaultWidgetCreator() const override;
     void initializeItemListWidget(KItemListWidget* item) override;
+    bool itemSizeHintUpdateRequired(const QSet<QByteArray>& changedRoles) const override;
     virtual void onPreviewsShownChanged(bool shown);
     void onItemLayoutChanged(ItemLayout current, ItemLayout previous) override;
     void onModelChanged(KItemModelBase* current, KItemModelBase* previous) override;
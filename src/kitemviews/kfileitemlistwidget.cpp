@@ -64,9 +64,13 @@ QString KFileItemListWidgetInformant::roleText(const QByteArray& role,
 
     if (role == "size") {
         if (values.value("isDir").toBool()) {
-            // The item represents a directory. Show the number of sub directories
-            // instead of the file size of the directory.
-            if (!roleValue.isNull()) {
+            // The item represents a directory. Show the size of its contents
+            // if it is known, or the number of sub directories instead of the
+            // file size of the directory.
+            const QVariant contentsSize = values.value("contentsSize");
+            if (!contentsSize.isNull()) {
+                text = KFormat().formatByteSize(contentsSize.value<KIO::filesize_t>());
+            } else if (!roleValue.isNull()) {
                 const int count = roleValue.toInt();
                 if (count < 0) {
                     text = i18nc("@item:intable", "Unknown");
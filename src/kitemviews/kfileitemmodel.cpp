@@ -25,17 +25,37 @@
 #include "dolphindebug.h"
 #include "private/kfileitemmodeldirlister.h"
 #include "private/kfileitemmodelsortalgorithm.h"
+#include "private/kmimetyperesolver.h"
 
 #include <KLocalizedString>
 #include <KUrlMimeData>
 
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QMimeData>
 #include <QTimer>
 #include <QWidget>
+#include <QtConcurrentMap>
+
+#include <iterator>
 
 // #define KFILEITEMMODEL_DEBUG
 
+namespace {
+    // Local directories with at least StreamingFirstBatchSize pending items
+    // are inserted in batches, so that huge directories do not show an empty
+    // view until the listing has been completed. The first batch contains
+    // the StreamingFirstBatchSize items that belong to the top of the view,
+    // the remaining items are inserted every StreamingInterval ms.
+    const int StreamingFirstBatchSize = 500;
+    const int StreamingInterval = 300;
+
+    // Local directories with at least AsynchronousSortingThreshold pending
+    // items are sorted by a worker thread to keep the user interface
+    // responsive, see KFileItemModel::startAsynchronousSorting().
+    const int AsynchronousSortingThreshold = 10000;
+}
+
 KFileItemModel::KFileItemModel(QObject* parent) :
     KItemModelBase("text", parent),
     m_dirLister(nullptr),
@@ -44,16 +64,34 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     m_sortingProgressPercent(-1),
     m_roles(),
     m_itemData(),
+    m_itemDataPool(),
+    m_roleStore(),
     m_items(),
     m_filter(),
     m_filteredItems(),
+    m_filteredItemsSorted(true),
     m_requestRole(),
     m_maximumUpdateIntervalTimer(nullptr),
+    m_streamingTimer(nullptr),
     m_resortAllItemsTimer(nullptr),
     m_pendingItemsToInsert(),
+    m_itemsToResort(),
     m_groups(),
     m_expandedDirs(),
-    m_urlsToExpand()
+    m_urlsToExpand(),
+    m_prefetchedItems(),
+    m_loadingTimer(),
+    m_timeToFirstItemsInserted(-1),
+    m_transactionLevel(0),
+    m_itemsChangedInTransaction(),
+    m_rolesChangedInTransaction(),
+    m_itemsChangedTimer(),
+    m_itemsChangedCount(0),
+    m_itemsChangedPerSecond(0),
+    m_sortingWatcher(nullptr),
+    m_itemsBeingSorted(),
+    m_sortingCanceled(0),
+    m_completedAfterSorting(false)
 {
     m_collator.setNumericMode(true);
 
@@ -67,7 +105,7 @@ KFileItemModel::KFileItemModel(QObject* parent) :
         m_dirLister->setMainWindow(parentWidget->window());
     }
 
-    connect(m_dirLister, &KFileItemModelDirLister::started, this, &KFileItemModel::directoryLoadingStarted);
+    connect(m_dirLister, &KFileItemModelDirLister::started, this, &KFileItemModel::slotStarted);
     connect(m_dirLister, static_cast<void(KFileItemModelDirLister::*)()>(&KFileItemModelDirLister::canceled), this, &KFileItemModel::slotCanceled);
     connect(m_dirLister, static_cast<void(KFileItemModelDirLister::*)(const QUrl&)>(&KFileItemModelDirLister::completed), this, &KFileItemModel::slotCompleted);
     connect(m_dirLister, &KFileItemModelDirLister::itemsAdded, this, &KFileItemModel::slotItemsAdded);
@@ -97,6 +135,15 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     m_maximumUpdateIntervalTimer->setSingleShot(true);
     connect(m_maximumUpdateIntervalTimer, &QTimer::timeout, this, &KFileItemModel::dispatchPendingItemsToInsert);
 
+    m_streamingTimer = new QTimer(this);
+    m_streamingTimer->setInterval(StreamingInterval);
+    m_streamingTimer->setSingleShot(true);
+    connect(m_streamingTimer, &QTimer::timeout, this, &KFileItemModel::dispatchStreamingBatch);
+
+    m_sortingWatcher = new QFutureWatcher<QList<ItemData*> >(this);
+    connect(m_sortingWatcher, &QFutureWatcher<QList<ItemData*> >::finished,
+            this, &KFileItemModel::slotAsynchronousSortingFinished);
+
     // When changing the value of an item which represents the sort-role a resorting must be
     // triggered. Especially in combination with KFileItemModelRolesUpdater this might be done
     // for a lot of items within a quite small timeslot. To prevent expensive resortings the
@@ -104,16 +151,17 @@ KFileItemModel::KFileItemModel(QObject* parent) :
     m_resortAllItemsTimer = new QTimer(this);
     m_resortAllItemsTimer->setInterval(500);
     m_resortAllItemsTimer->setSingleShot(true);
-    connect(m_resortAllItemsTimer, &QTimer::timeout, this, &KFileItemModel::resortAllItems);
+    connect(m_resortAllItemsTimer, &QTimer::timeout, this, &KFileItemModel::resortChangedItems);
 
     connect(GeneralSettings::self(), &GeneralSettings::sortingChoiceChanged, this, &KFileItemModel::slotSortingChoiceChanged);
 }
 
 KFileItemModel::~KFileItemModel()
 {
-    qDeleteAll(m_itemData);
-    qDeleteAll(m_filteredItems);
-    qDeleteAll(m_pendingItemsToInsert);
+    cancelAsynchronousSorting();
+
+    // Deletes all items of m_itemData, m_filteredItems and m_pendingItemsToInsert
+    m_itemDataPool.clear();
 }
 
 void KFileItemModel::loadDirectory(const QUrl &url)
@@ -133,6 +181,11 @@ void KFileItemModel::refreshDirectory(const QUrl &url)
     m_dirLister->openUrl(url, KDirLister::Reload);
 }
 
+void KFileItemModel::setPrefetchedItems(const QHash<QUrl, KFileItem>& items)
+{
+    m_prefetchedItems = items;
+}
+
 QUrl KFileItemModel::directory() const
 {
     return m_dirLister->url();
@@ -140,6 +193,7 @@ QUrl KFileItemModel::directory() const
 
 void KFileItemModel::cancelDirectoryLoading()
 {
+    cancelAsynchronousSorting();
     m_dirLister->stop();
 }
 
@@ -153,10 +207,10 @@ QHash<QByteArray, QVariant> KFileItemModel::data(int index) const
     if (index >= 0 && index < count()) {
         ItemData* data = m_itemData.at(index);
         if (data->values.isEmpty()) {
-            data->values = retrieveData(data->item, data->parent);
+            setRoleValues(data, retrieveData(data->item, data->parent));
         }
 
-        return data->values;
+        return roleValues(data);
     }
     return QHash<QByteArray, QVariant>();
 }
@@ -187,22 +241,113 @@ bool KFileItemModel::setData(int index, const QHash<QByteArray, QVariant>& value
         return false;
     }
 
-    m_itemData[index]->values = currentValues;
+    setRoleValues(m_itemData[index], currentValues);
     if (changedRoles.contains("text")) {
         QUrl url = m_itemData[index]->item.url();
         url = url.adjusted(QUrl::RemoveFilename);
         url.setPath(url.path() + currentValues["text"].toString());
+        removeFromUrlHash(m_itemData[index]);
         m_itemData[index]->item.setUrl(url);
+        m_itemData[index]->sortKey.reset();
+        m_items.insert(url, m_itemData[index]);
     }
 
-    emitItemsChangedAndTriggerResorting(KItemRangeList() << KItemRange(index, 1), changedRoles);
-
+    notifyItemsChanged(KItemRangeList() << KItemRange(index, 1), changedRoles);
     return true;
 }
 
+void KFileItemModel::setItemsData(const QVector<ItemValues>& itemValues)
+{
+    QVector<int> changedIndexes;
+    changedIndexes.reserve(itemValues.count());
+    QSet<QByteArray> changedRoles;
+
+    foreach (const ItemValues& itemValue, itemValues) {
+        const int index = itemValue.index;
+        if (index < 0 || index >= count()) {
+            continue;
+        }
+
+        Q_ASSERT(!itemValue.values.contains("text"));
+
+        ItemData* itemData = m_itemData.at(index);
+
+        // Replacing the KFileItem does not change any role values, so the
+        // item is only reported as changed if one of its values differs.
+        if (!itemValue.item.isNull()) {
+            Q_ASSERT(itemValue.item.url() == itemData->item.url());
+            itemData->item = itemValue.item;
+        }
+
+        QHash<QByteArray, QVariant> currentValues = data(index);
+        bool valuesChanged = false;
+
+        QHashIterator<QByteArray, QVariant> it(itemValue.values);
+        while (it.hasNext()) {
+            it.next();
+            const QByteArray role = sharedValue(it.key());
+            const QVariant value = it.value();
+
+            if (currentValues[role] != value) {
+                currentValues[role] = value;
+                changedRoles.insert(role);
+                valuesChanged = true;
+            }
+        }
+
+        if (valuesChanged) {
+            setRoleValues(itemData, currentValues);
+            changedIndexes.append(index);
+        }
+    }
+
+    if (changedIndexes.isEmpty()) {
+        return;
+    }
+
+    std::sort(changedIndexes.begin(), changedIndexes.end());
+    changedIndexes.erase(std::unique(changedIndexes.begin(), changedIndexes.end()), changedIndexes.end());
+
+    notifyItemsChanged(KItemRangeList::fromSortedContainer(changedIndexes), changedRoles);
+}
+
+void KFileItemModel::beginTransaction()
+{
+    ++m_transactionLevel;
+}
+
+void KFileItemModel::endTransaction()
+{
+    Q_ASSERT(m_transactionLevel > 0);
+    --m_transactionLevel;
+    if (m_transactionLevel > 0 || m_itemsChangedInTransaction.isEmpty()) {
+        return;
+    }
+
+    // The items might have been moved during the transaction, so their
+    // current indexes are determined now.
+    QVector<int> changedIndexes;
+    changedIndexes.reserve(m_itemsChangedInTransaction.count());
+    foreach (const ItemData* itemData, m_itemsChangedInTransaction) {
+        if (itemData->index >= 0) {
+            changedIndexes.append(itemData->index);
+        }
+    }
+
+    const QSet<QByteArray> changedRoles = m_rolesChangedInTransaction;
+    m_itemsChangedInTransaction.clear();
+    m_rolesChangedInTransaction.clear();
+
+    if (!changedIndexes.isEmpty()) {
+        std::sort(changedIndexes.begin(), changedIndexes.end());
+        emitItemsChangedAndTriggerResorting(KItemRangeList::fromSortedContainer(changedIndexes), changedRoles);
+    }
+}
+
 void KFileItemModel::setSortDirectoriesFirst(bool dirsFirst)
 {
     if (dirsFirst != m_sortDirsFirst) {
+        cancelAsynchronousSorting();
         m_sortDirsFirst = dirsFirst;
         resortAllItems();
     }
@@ -337,8 +482,8 @@ QList<QPair<int, QVariant> > KFileItemModel::groups() const
             });
             break;
         case DeletionTimeRole:
-            m_groups = timeRoleGroups([](const ItemData *item) {
-                return item->values.value("deletiontime").toDateTime();
+            m_groups = timeRoleGroups([this](const ItemData *item) {
+                return roleValue(item, "deletiontime").toDateTime();
             });
             break;
         case PermissionsRole: m_groups = permissionRoleGroups(); break;
@@ -381,39 +526,21 @@ int KFileItemModel::index(const QUrl& url) const
 {
     const QUrl urlToFind = url.adjusted(QUrl::StripTrailingSlash);
 
-    const int itemCount = m_itemData.count();
-    int itemsInHash = m_items.count();
-
-    int index = m_items.value(urlToFind, -1);
-    while (index < 0 && itemsInHash < itemCount) {
-        // Not all URLs are stored yet in m_items. We grow m_items until either
-        // urlToFind is found, or all URLs have been stored in m_items.
-        // Note that we do not add the URLs to m_items one by one, but in
-        // larger blocks. After each block, we check if urlToFind is in
-        // m_items. We could in principle compare urlToFind with each URL while
-        // we are going through m_itemData, but comparing two QUrls will,
-        // unlike calling qHash for the URLs, trigger a parsing of the URLs
-        // which costs both CPU cycles and memory.
-        const int blockSize = 1000;
-        const int currentBlockEnd = qMin(itemsInHash + blockSize, itemCount);
-        for (int i = itemsInHash; i < currentBlockEnd; ++i) {
-            const QUrl nextUrl = m_itemData.at(i)->item.url();
-            m_items.insert(nextUrl, i);
-        }
-
-        itemsInHash = currentBlockEnd;
-        index = m_items.value(urlToFind, -1);
-    }
-
-    if (index < 0) {
-        // The item could not be found, even though all items from m_itemData
-        // should be in m_items now. We print some diagnostic information which
+    const ItemData* itemData = m_items.value(urlToFind);
+    if (itemData) {
+        Q_ASSERT(m_itemData.at(itemData->index) == itemData);
+        return itemData->index;
+    }
+
+    if (m_items.count() != m_itemData.count()) {
+        // Every item from m_itemData should be in m_items. If this is not the
+        // case, several items share the same URL. We print some diagnostic information which
         // might help to find the cause of the problem, but only once. This
         // prevents that obtaining and printing the debugging information
         // wastes CPU cycles and floods the shell or .xsession-errors.
         static bool printDebugInfo = true;
 
-        if (m_items.count() != m_itemData.count() && printDebugInfo) {
+        if (printDebugInfo) {
             printDebugInfo = false;
 
             qCWarning(DolphinDebug) << "The model is in an inconsistent state.";
@@ -444,7 +571,7 @@ int KFileItemModel::index(const QUrl& url) const
         }
     }
 
-    return index;
+    return -1;
 }
 
 KFileItem KFileItemModel::rootItem() const
@@ -489,20 +616,20 @@ void KFileItemModel::setRoles(const QSet<QByteArray>& roles)
         // Update m_data with the changed requested roles
         const int maxIndex = count() - 1;
         for (int i = 0; i <= maxIndex; ++i) {
-            m_itemData[i]->values = retrieveData(m_itemData.at(i)->item, m_itemData.at(i)->parent);
+            setRoleValues(m_itemData[i], retrieveData(m_itemData.at(i)->item, m_itemData.at(i)->parent));
         }
 
+        countItemsChangedSignal();
         emit itemsChanged(KItemRangeList() << KItemRange(0, count()), changedRoles);
     }
 
     // Clear the 'values' of all filtered items. They will be re-populated with the
     // correct roles the next time 'values' will be accessed via data(int).
-    QHash<KFileItem, ItemData*>::iterator filteredIt = m_filteredItems.begin();
-    const QHash<KFileItem, ItemData*>::iterator filteredEnd = m_filteredItems.end();
-    while (filteredIt != filteredEnd) {
-        (*filteredIt)->values.clear();
-        ++filteredIt;
+    // The values might be required for sorting the filtered items.
+    foreach (ItemData* itemData, m_filteredItems) {
+        clearRoleValues(itemData);
     }
+    m_filteredItemsSorted = m_filteredItems.isEmpty();
 }
 
 QSet<QByteArray> KFileItemModel::roles() const
@@ -659,8 +786,9 @@ void KFileItemModel::setNameFilter(const QString& nameFilter)
 {
     if (m_filter.pattern() != nameFilter) {
         dispatchPendingItemsToInsert();
+        const QString previousNameFilter = m_filter.pattern();
         m_filter.setPattern(nameFilter);
-        applyFilters();
+        applyFilters(m_filter.narrows(previousNameFilter));
     }
 }
 
@@ -684,11 +812,12 @@ QStringList KFileItemModel::mimeTypeFilters() const
 }
 
 
-void KFileItemModel::applyFilters()
+void KFileItemModel::applyFilters(bool narrowed)
 {
     // Check which shown items from m_itemData must get
     // hidden and hence moved to m_filteredItems.
     QVector<int> newFilteredIndexes;
+    QList<ItemData*> newFilteredItems;
 
     const int itemCount = m_itemData.count();
     for (int index = 0; index < itemCount; ++index) {
@@ -697,10 +826,9 @@ void KFileItemModel::applyFilters()
         // Only filter non-expanded items as child items may never
         // exist without a parent item
         if (!itemData->values.value("isExpanded").toBool()) {
-            const KFileItem item = itemData->item;
-            if (!m_filter.matches(item)) {
+            if (!m_filter.matches(itemData->item)) {
                 newFilteredIndexes.append(index);
-                m_filteredItems.insert(item, itemData);
+                newFilteredItems.append(itemData);
             }
         }
     }
@@ -708,21 +836,62 @@ void KFileItemModel::applyFilters()
     const KItemRangeList removedRanges = KItemRangeList::fromSortedContainer(newFilteredIndexes);
     removeItems(removedRanges, KeepItemData);
 
-    // Check which hidden items from m_filteredItems should
-    // get visible again and hence removed from m_filteredItems.
-    QList<ItemData*> newVisibleItems;
+    if (!narrowed) {
+        // Check which hidden items from m_filteredItems should get visible
+        // again. m_filteredItems is sorted, hence these items can be merged
+        // into m_itemData without sorting them again. Note that the new
+        // filtered items cannot match the filter and need not be checked.
+        if (!m_filteredItemsSorted) {
+            prepareItemsForSorting(m_filteredItems);
+            sort(m_filteredItems.begin(), m_filteredItems.end());
+            m_filteredItemsSorted = true;
+        }
+
+        QList<ItemData*> newVisibleItems;
+        QList<ItemData*> remainingFilteredItems;
+        remainingFilteredItems.reserve(m_filteredItems.count());
+        foreach (ItemData* itemData, m_filteredItems) {
+            if (m_filter.matches(itemData->item)) {
+                newVisibleItems.append(itemData);
+            } else {
+                remainingFilteredItems.append(itemData);
+            }
+        }
 
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
-    while (it != m_filteredItems.end()) {
-        if (m_filter.matches(it.key())) {
-            newVisibleItems.append(it.value());
-            it = m_filteredItems.erase(it);
-        } else {
-            ++it;
+        if (!newVisibleItems.isEmpty()) {
+            m_filteredItems.swap(remainingFilteredItems);
+            insertSortedItems(newVisibleItems);
         }
     }
 
-    insertItems(newVisibleItems);
+    insertFilteredItems(newFilteredItems, true);
+}
+
+void KFileItemModel::insertFilteredItems(const QList<ItemData*>& items, bool sorted)
+{
+    if (items.isEmpty()) {
+        return;
+    }
+
+    if (m_filteredItems.isEmpty()) {
+        m_filteredItems = items;
+        m_filteredItemsSorted = sorted;
+    } else if (sorted && m_filteredItemsSorted) {
+        // Both lists are sorted. Merging them is cheaper than sorting
+        // the filtered items the next time they get visible again.
+        QList<ItemData*> mergedItems;
+        mergedItems.reserve(m_filteredItems.count() + items.count());
+        std::merge(m_filteredItems.constBegin(), m_filteredItems.constEnd(),
+                   items.constBegin(), items.constEnd(),
+                   std::back_inserter(mergedItems),
+                   [this](const ItemData* a, const ItemData* b) {
+                       return lessThan(a, b, m_collator);
+                   });
+        m_filteredItems.swap(mergedItems);
+    } else {
+        m_filteredItems.append(items);
+        m_filteredItemsSorted = false;
+    }
 }
 
 void KFileItemModel::removeFilteredChildren(const KItemRangeList& itemRanges)
@@ -740,10 +909,10 @@ void KFileItemModel::removeFilteredChildren(const KItemRangeList& itemRanges)
         }
     }
 
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
+    QList<ItemData*>::iterator it = m_filteredItems.begin();
     while (it != m_filteredItems.end()) {
-        if (parents.contains(it.value()->parent)) {
-            delete it.value();
+        if (parents.contains((*it)->parent)) {
+            deleteItemData(*it);
             it = m_filteredItems.erase(it);
         } else {
             ++it;
@@ -789,6 +958,7 @@ void KFileItemModel::onGroupedSortingChanged(bool current)
 void KFileItemModel::onSortRoleChanged(const QByteArray& current, const QByteArray& previous)
 {
     Q_UNUSED(previous);
+    cancelAsynchronousSorting();
     m_sortRole = typeForRole(current);
 
     if (!m_requestRole[m_sortRole]) {
@@ -804,6 +974,7 @@ void KFileItemModel::onSortOrderChanged(Qt::SortOrder current, Qt::SortOrder pre
 {
     Q_UNUSED(current);
     Q_UNUSED(previous);
+    cancelAsynchronousSorting();
     resortAllItems();
 }
 
@@ -834,6 +1005,10 @@ void KFileItemModel::loadSortingSettings()
 void KFileItemModel::resortAllItems()
 {
     m_resortAllItemsTimer->stop();
+    m_itemsToResort.clear();
+
+    // The filtered items get sorted when they are shown again.
+    m_filteredItemsSorted = m_filteredItems.isEmpty();
 
     const int itemCount = count();
     if (itemCount <= 0) {
@@ -847,28 +1022,16 @@ void KFileItemModel::resortAllItems()
     qCDebug(DolphinDebug) << "Resorting" << itemCount << "items";
 #endif
 
-    // Remember the order of the current URLs so
-    // that it can be determined which indexes have
-    // been moved because of the resorting.
-    QList<QUrl> oldUrls;
-    oldUrls.reserve(itemCount);
-    foreach (const ItemData* itemData, m_itemData) {
-        oldUrls.append(itemData->item.url());
-    }
-
-    m_items.clear();
-    m_items.reserve(itemCount);
-
-    // Resort the items
+    // Resort the items. ItemData::index still contains the old index
+    // of each item afterwards, so it can be determined which indexes
+    // have been moved because of the resorting.
+    updateSortKeys(m_itemData, m_collator);
     sort(m_itemData.begin(), m_itemData.end());
-    for (int i = 0; i < itemCount; ++i) {
-        m_items.insert(m_itemData.at(i)->item.url(), i);
-    }
 
     // Determine the first index that has been moved.
     int firstMovedIndex = 0;
     while (firstMovedIndex < itemCount
-           && firstMovedIndex == m_items.value(oldUrls.at(firstMovedIndex))) {
+           && firstMovedIndex == m_itemData.at(firstMovedIndex)->index) {
         ++firstMovedIndex;
     }
 
@@ -878,7 +1041,7 @@ void KFileItemModel::resortAllItems()
 
         int lastMovedIndex = itemCount - 1;
         while (lastMovedIndex > firstMovedIndex
-               && lastMovedIndex == m_items.value(oldUrls.at(lastMovedIndex))) {
+               && lastMovedIndex == m_itemData.at(lastMovedIndex)->index) {
             --lastMovedIndex;
         }
 
@@ -888,12 +1051,13 @@ void KFileItemModel::resortAllItems()
         // movedToIndexes[i] is the new index of the item with the old index
         // firstMovedIndex + i.
         const int movedItemsCount = lastMovedIndex - firstMovedIndex + 1;
-        QList<int> movedToIndexes;
-        movedToIndexes.reserve(movedItemsCount);
+        QVector<int> movedTo(movedItemsCount);
         for (int i = firstMovedIndex; i <= lastMovedIndex; ++i) {
-            const int newIndex = m_items.value(oldUrls.at(i));
-            movedToIndexes.append(newIndex);
+            ItemData* itemData = m_itemData.at(i);
+            movedTo[itemData->index - firstMovedIndex] = i;
+            itemData->index = i;
         }
+        const QList<int> movedToIndexes = movedTo.toList();
 
         emit itemsMoved(KItemRange(firstMovedIndex, movedItemsCount), movedToIndexes);
     } else if (groupedSorting()) {
@@ -910,9 +1074,166 @@ void KFileItemModel::resortAllItems()
 #endif
 }
 
+void KFileItemModel::resortChangedItems()
+{
+    m_resortAllItemsTimer->stop();
+
+    const int itemCount = count();
+
+    // Determine the current indexes of the changed items. Items that have
+    // been filtered in the meantime are not part of m_itemData anymore.
+    QVector<int> changedIndexes;
+    changedIndexes.reserve(m_itemsToResort.count());
+    foreach (ItemData* itemData, m_itemsToResort) {
+        if (itemData->index >= 0) {
+            changedIndexes.append(itemData->index);
+        }
+    }
+
+    // Moving a directory in the tree view also moves its expanded children,
+    // and binary insertion only pays off if few items have changed.
+    // Resort all items in these cases, which also updates the groups if
+    // m_resortAllItemsTimer has been started because of them.
+    const int changedCount = changedIndexes.count();
+    if (changedCount == 0 || changedCount > itemCount / 2 || !m_expandedDirs.isEmpty()) {
+        resortAllItems();
+        return;
+    }
+
+    m_itemsToResort.clear();
+    std::sort(changedIndexes.begin(), changedIndexes.end());
+
+#ifdef KFILEITEMMODEL_DEBUG
+    QElapsedTimer timer;
+    timer.start();
+    qCDebug(DolphinDebug) << "Resorting" << changedCount << "of" << itemCount << "items";
+#endif
+
+    // The items that have not changed are still sorted correctly. Take the
+    // changed items out, sort them, and insert them at the positions found
+    // by a binary search, which needs O(k * log(n)) comparisons for k
+    // changed items.
+    QList<ItemData*> changedItems;
+    changedItems.reserve(changedCount);
+    QList<ItemData*> unchangedItems;
+    unchangedItems.reserve(itemCount - changedCount);
+    QVector<int> oldIndexes;
+    oldIndexes.reserve(itemCount - changedCount);
+    for (int i = 0, changed = 0; i < itemCount; ++i) {
+        if (changed < changedCount && changedIndexes.at(changed) == i) {
+            changedItems.append(m_itemData.at(i));
+            ++changed;
+        } else {
+            unchangedItems.append(m_itemData.at(i));
+            oldIndexes.append(i);
+        }
+    }
+
+    updateSortKeys(changedItems, m_collator);
+    sort(changedItems.begin(), changedItems.end());
+
+    const auto lessThanFunction = [this](const ItemData* a, const ItemData* b) {
+        return lessThan(a, b, m_collator);
+    };
+
+    // newToOldIndexes[i] is the old index of the item with the new index i.
+    QList<ItemData*> sortedItems;
+    sortedItems.reserve(itemCount);
+    QVector<int> newToOldIndexes;
+    newToOldIndexes.reserve(itemCount);
+    auto unchangedIt = unchangedItems.constBegin();
+    for (int changed = 0; changed < changedCount; ++changed) {
+        ItemData* changedItem = changedItems.at(changed);
+        const auto insertIt = std::upper_bound(unchangedIt, unchangedItems.constEnd(),
+                                               changedItem, lessThanFunction);
+        for (; unchangedIt != insertIt; ++unchangedIt) {
+            newToOldIndexes.append(oldIndexes.at(unchangedIt - unchangedItems.constBegin()));
+            sortedItems.append(*unchangedIt);
+        }
+        newToOldIndexes.append(changedIndexes.at(changed));
+        sortedItems.append(changedItem);
+    }
+    for (; unchangedIt != unchangedItems.constEnd(); ++unchangedIt) {
+        newToOldIndexes.append(oldIndexes.at(unchangedIt - unchangedItems.constBegin()));
+        sortedItems.append(*unchangedIt);
+    }
+    Q_ASSERT(sortedItems.count() == itemCount);
+
+    QVector<int> oldToNewIndexes(itemCount);
+    for (int i = 0; i < itemCount; ++i) {
+        oldToNewIndexes[newToOldIndexes.at(i)] = i;
+    }
+
+    // Split the permutation into the smallest blocks [first, last] that are
+    // only moved within themselves. Every block is applied to m_itemData
+    // and announced separately, so that the model is consistent with the
+    // itemsMoved() signals that have been emitted so far, and the views
+    // only need to update the items in between the old and new positions.
+    bool itemsHaveMoved = false;
+    int first = 0;
+    while (first < itemCount) {
+        if (oldToNewIndexes.at(first) == first) {
+            ++first;
+            continue;
+        }
+
+        int last = oldToNewIndexes.at(first);
+        for (int i = first + 1; i <= last; ++i) {
+            last = qMax(last, oldToNewIndexes.at(i));
+        }
+
+        if (!itemsHaveMoved) {
+            itemsHaveMoved = true;
+            m_groups.clear();
+        }
+
+        QList<int> movedToIndexes;
+        movedToIndexes.reserve(last - first + 1);
+        for (int i = first; i <= last; ++i) {
+            movedToIndexes.append(oldToNewIndexes.at(i));
+            m_itemData[i] = sortedItems.at(i);
+            m_itemData[i]->index = i;
+        }
+
+        emit itemsMoved(KItemRange(first, last - first + 1), movedToIndexes);
+        first = last + 1;
+    }
+
+    if (!itemsHaveMoved && groupedSorting()) {
+        // The groups might have changed even if the order of the items has not.
+        const QList<QPair<int, QVariant> > oldGroups = m_groups;
+        m_groups.clear();
+        if (groups() != oldGroups) {
+            emit groupsChanged();
+        }
+    }
+
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "[TIME] Resorting of" << changedCount << "items:" << timer.elapsed();
+#endif
+}
+
+void KFileItemModel::slotStarted()
+{
+    m_loadingTimer.start();
+    m_timeToFirstItemsInserted = -1;
+
+    emit directoryLoadingStarted();
+}
+
 void KFileItemModel::slotCompleted()
 {
+    m_streamingTimer->stop();
+
+    if (!m_itemsBeingSorted.isEmpty() || startAsynchronousSorting()) {
+        // slotAsynchronousSortingFinished() completes the loading
+        // after the sorted items have been inserted.
+        m_completedAfterSorting = true;
+        return;
+    }
+
     dispatchPendingItemsToInsert();
+    m_prefetchedItems.clear();
 
     if (!m_urlsToExpand.isEmpty()) {
         // Try to find a URL that can be expanded.
@@ -942,7 +1263,10 @@ void KFileItemModel::slotCompleted()
 void KFileItemModel::slotCanceled()
 {
     m_maximumUpdateIntervalTimer->stop();
+    m_streamingTimer->stop();
+    m_completedAfterSorting = false;
     dispatchPendingItemsToInsert();
+    m_prefetchedItems.clear();
 
     emit directoryLoadingCanceled();
 }
@@ -993,19 +1317,27 @@ void KFileItemModel::slotItemsAdded(const QUrl &directoryUrl, const KFileItemLis
         // The name or type filter is active. Hide filtered items
         // before inserting them into the model and remember
         // the filtered items in m_filteredItems.
+        QList<ItemData*> filteredItems;
         foreach (ItemData* itemData, itemDataList) {
             if (m_filter.matches(itemData->item)) {
                 m_pendingItemsToInsert.append(itemData);
             } else {
-                m_filteredItems.insert(itemData->item, itemData);
+                filteredItems.append(itemData);
             }
         }
+        insertFilteredItems(filteredItems, false);
     }
 
-    if (useMaximumUpdateInterval() && !m_maximumUpdateIntervalTimer->isActive()) {
-        // Assure that items get dispatched if no completed() or canceled() signal is
-        // emitted during the maximum update interval.
-        m_maximumUpdateIntervalTimer->start();
+    if (useMaximumUpdateInterval()) {
+        if (!m_maximumUpdateIntervalTimer->isActive()) {
+            // Assure that items get dispatched if no completed() or canceled() signal is
+            // emitted during the maximum update interval.
+            m_maximumUpdateIntervalTimer->start();
+        }
+    } else if (m_pendingItemsToInsert.count() >= StreamingFirstBatchSize && !m_streamingTimer->isActive()) {
+        // Local directories are usually listed fast enough to insert all items
+        // when completed() is emitted. Huge directories are inserted in batches.
+        m_streamingTimer->start();
     }
 }
 
@@ -1015,17 +1347,28 @@ void KFileItemModel::slotItemsDeleted(const KFileItemList& items)
 
     QVector<int> indexesToRemove;
     indexesToRemove.reserve(items.count());
+    QSet<QUrl> filteredUrlsToRemove;
 
     foreach (const KFileItem& item, items) {
         const int indexForItem = index(item);
         if (indexForItem >= 0) {
             indexesToRemove.append(indexForItem);
-        } else {
+        } else if (!m_filteredItems.isEmpty()) {
             // Probably the item has been filtered.
-            QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.find(item);
-            if (it != m_filteredItems.end()) {
-                delete it.value();
-                m_filteredItems.erase(it);
+            filteredUrlsToRemove.insert(item.url());
+        }
+    }
+
+    if (!filteredUrlsToRemove.isEmpty()) {
+        // Remove the filtered items in a single pass. This keeps
+        // the order of the remaining filtered items.
+        QList<ItemData*>::iterator it = m_filteredItems.begin();
+        while (it != m_filteredItems.end()) {
+            if (filteredUrlsToRemove.contains((*it)->item.url())) {
+                deleteItemData(*it);
+                it = m_filteredItems.erase(it);
+            } else {
+                ++it;
             }
         }
     }
@@ -1069,6 +1412,7 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
     indexes.reserve(items.count());
 
     QSet<QByteArray> changedRoles;
+    QHash<QUrl, KFileItem> refreshedFilteredItems;
 
     QListIterator<QPair<KFileItem, KFileItem> > it(items);
     while (it.hasNext()) {
@@ -1077,42 +1421,49 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
         const KFileItem& newItem = itemPair.second;
         const int indexForItem = index(oldItem);
         if (indexForItem >= 0) {
+            if (oldItem.text() != newItem.text()) {
+                m_itemData[indexForItem]->sortKey.reset();
+            }
             m_itemData[indexForItem]->item = newItem;
 
             // Keep old values as long as possible if they could not retrieved synchronously yet.
             // The update of the values will be done asynchronously by KFileItemModelRolesUpdater.
-            QHashIterator<QByteArray, QVariant> it(retrieveData(newItem, m_itemData.at(indexForItem)->parent));
-            QHash<QByteArray, QVariant>& values = m_itemData[indexForItem]->values;
+            ItemData* itemData = m_itemData[indexForItem];
+            QHashIterator<QByteArray, QVariant> it(retrieveData(newItem, itemData->parent));
             while (it.hasNext()) {
                 it.next();
                 const QByteArray& role = it.key();
-                if (values.value(role) != it.value()) {
-                    values.insert(role, it.value());
+                if (roleValue(itemData, role) != it.value()) {
+                    setRoleValue(itemData, role, it.value());
                     changedRoles.insert(role);
                 }
             }
 
             m_items.remove(oldItem.url());
-            m_items.insert(newItem.url(), indexForItem);
+            m_items.insert(newItem.url(), itemData);
             indexes.append(indexForItem);
-        } else {
-            // Check if 'oldItem' is one of the filtered items.
-            QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.find(oldItem);
-            if (it != m_filteredItems.end()) {
-                ItemData* itemData = it.value();
-                itemData->item = newItem;
+        } else if (!m_filteredItems.isEmpty()) {
+            // Check later if 'oldItem' is one of the filtered items.
+            refreshedFilteredItems.insert(oldItem.url(), newItem);
+        }
+    }
+
+    if (!refreshedFilteredItems.isEmpty()) {
+        foreach (ItemData* itemData, m_filteredItems) {
+            const QHash<QUrl, KFileItem>::const_iterator newItemIt = refreshedFilteredItems.constFind(itemData->item.url());
+            if (newItemIt != refreshedFilteredItems.constEnd()) {
+                itemData->item = newItemIt.value();
+                itemData->sortKey.reset();
 
                 // The data stored in 'values' might have changed. Therefore, we clear
                 // 'values' and re-populate it the next time it is requested via data(int).
-                itemData->values.clear();
-
-                m_filteredItems.erase(it);
-                m_filteredItems.insert(newItem, itemData);
+                clearRoleValues(itemData);
+                m_filteredItemsSorted = false;
             }
         }
     }
 
-    // If the changed items have been created recently, they might not be in m_items yet.
+    // If the changed items have been created recently, they might not be in m_itemData yet.
     // In that case, the list 'indexes' might be empty.
     if (indexes.isEmpty()) {
         return;
@@ -1121,7 +1472,7 @@ void KFileItemModel::slotRefreshItems(const QList<QPair<KFileItem, KFileItem> >&
     // Extract the item-ranges out of the changed indexes
     qSort(indexes);
     const KItemRangeList itemRangeList = KItemRangeList::fromSortedContainer(indexes);
-    emitItemsChangedAndTriggerResorting(itemRangeList, changedRoles);
+    notifyItemsChanged(itemRangeList, changedRoles);
 }
 
 void KFileItemModel::slotClear()
@@ -1130,21 +1481,31 @@ void KFileItemModel::slotClear()
     qCDebug(DolphinDebug) << "Clearing all items";
 #endif
 
-    qDeleteAll(m_filteredItems);
+    cancelAsynchronousSorting();
+    m_completedAfterSorting = false;
+
     m_filteredItems.clear();
+    m_filteredItemsSorted = true;
     m_groups.clear();
 
     m_maximumUpdateIntervalTimer->stop();
+    m_streamingTimer->stop();
     m_resortAllItemsTimer->stop();
+    m_itemsToResort.clear();
+    m_itemsChangedInTransaction.clear();
 
-    qDeleteAll(m_pendingItemsToInsert);
     m_pendingItemsToInsert.clear();
 
     const int removedCount = m_itemData.count();
+    m_itemData.clear();
+    m_items.clear();
+
+    // Delete the items of m_itemData, m_filteredItems and m_pendingItemsToInsert
+    // at once. No slot of m_roleStore is in use anymore afterwards.
+    m_itemDataPool.clear();
+    m_roleStore.clear();
+
     if (removedCount > 0) {
-        qDeleteAll(m_itemData);
-        m_itemData.clear();
-        m_items.clear();
         emit itemsRemoved(KItemRangeList() << KItemRange(0, removedCount));
     }
 
@@ -1153,18 +1514,171 @@ void KFileItemModel::slotClear()
 
 void KFileItemModel::slotSortingChoiceChanged()
 {
+    cancelAsynchronousSorting();
     loadSortingSettings();
+    resetSortKeys();
     resortAllItems();
 }
 
 void KFileItemModel::dispatchPendingItemsToInsert()
 {
+    finishAsynchronousSorting();
+
     if (!m_pendingItemsToInsert.isEmpty()) {
         insertItems(m_pendingItemsToInsert);
         m_pendingItemsToInsert.clear();
     }
 }
 
+void KFileItemModel::dispatchStreamingBatch()
+{
+    if (!m_itemData.isEmpty() || m_pendingItemsToInsert.count() <= StreamingFirstBatchSize) {
+        if (m_itemsBeingSorted.isEmpty() && !startAsynchronousSorting()) {
+            dispatchPendingItemsToInsert();
+        }
+        return;
+    }
+
+    // Insert only the items that belong to the top of the view first. Finding
+    // them with std::partial_sort() needs O(N * log(StreamingFirstBatchSize))
+    // comparisons. The other items are merged into the model by insertItems()
+    // with the next batch.
+    prepareItemsForSorting(m_pendingItemsToInsert);
+
+    const auto middle = m_pendingItemsToInsert.begin() + StreamingFirstBatchSize;
+    std::partial_sort(m_pendingItemsToInsert.begin(), middle, m_pendingItemsToInsert.end(),
+                      [this](const ItemData* a, const ItemData* b) {
+                          return lessThan(a, b, m_collator);
+                      });
+
+    QList<ItemData*> firstBatch = m_pendingItemsToInsert.mid(0, StreamingFirstBatchSize);
+    m_pendingItemsToInsert.erase(m_pendingItemsToInsert.begin(), middle);
+    insertItems(firstBatch);
+
+    m_streamingTimer->start();
+}
+
+bool KFileItemModel::startAsynchronousSorting()
+{
+    if (!m_itemsBeingSorted.isEmpty()
+        || m_pendingItemsToInsert.count() < AsynchronousSortingThreshold
+        || useMaximumUpdateInterval()) {
+        return false;
+    }
+
+    // Items of different expanded folders can only be compared by lessThan(),
+    // which accesses data that belongs to the GUI thread.
+    const ItemData* parent = m_pendingItemsToInsert.first()->parent;
+    const bool haveSameParent = std::all_of(m_pendingItemsToInsert.constBegin(), m_pendingItemsToInsert.constEnd(),
+                                            [parent](const ItemData* itemData) {
+                                                return itemData->parent == parent;
+                                            });
+    if (!haveSameParent) {
+        return false;
+    }
+
+    m_itemsBeingSorted = m_pendingItemsToInsert;
+    m_pendingItemsToInsert.clear();
+
+    // m_roleStore may only be accessed by the GUI thread. Hence the values
+    // of the sort role are retrieved and copied to the sort keys here.
+    retrieveSortRoleValues(m_itemsBeingSorted);
+
+    std::vector<ItemSortKey> keys;
+    keys.reserve(m_itemsBeingSorted.count());
+    foreach (ItemData* itemData, m_itemsBeingSorted) {
+        keys.push_back(extractSortKey(itemData));
+    }
+
+    // The worker thread gets its own collator, because m_collator is used by
+    // the GUI thread in the meantime. See also loadSortingSettings().
+    QCollator collator(m_collator.locale());
+    collator.setNumericMode(m_collator.numericMode());
+    collator.setCaseSensitivity(m_collator.caseSensitivity());
+    collator.compare(QString(), QString());
+
+    const bool dirsFirst = m_sortDirsFirst || m_sortRole == SizeRole;
+    const bool ascending = (sortOrder() == Qt::AscendingOrder);
+
+    m_sortingCanceled.store(0);
+    m_sortingWatcher->setFuture(QtConcurrent::run([this, keys, collator, dirsFirst, ascending]() mutable {
+        return sortItemsInThread(keys, collator, dirsFirst, ascending);
+    }));
+
+    return true;
+}
+
+QList<KFileItemModel::ItemData*> KFileItemModel::sortItemsInThread(std::vector<ItemSortKey>& keys,
+                                                                   const QCollator& collator,
+                                                                   bool dirsFirst,
+                                                                   bool ascending) const
+{
+    QList<ItemData*> itemDataList;
+    itemDataList.reserve(static_cast<int>(keys.size()));
+    for (const ItemSortKey& key : keys) {
+        itemDataList.append(key.itemData);
+    }
+
+    updateSortKeys(itemDataList, collator, &m_sortingCanceled);
+    if (m_sortingCanceled.load()) {
+        return QList<ItemData*>();
+    }
+
+    auto keyLessThan = [&] (const ItemSortKey& a, const ItemSortKey& b)
+    {
+        return sortKeyLessThan(a, b, dirsFirst, ascending, collator);
+    };
+    workStealingMergeSort(keys.begin(), keys.end(), keyLessThan, QThread::idealThreadCount(), 2048, &m_sortingCanceled);
+    if (m_sortingCanceled.load()) {
+        return QList<ItemData*>();
+    }
+
+    for (int i = 0; i < itemDataList.count(); ++i) {
+        itemDataList[i] = keys[i].itemData;
+    }
+    return itemDataList;
+}
+
+void KFileItemModel::finishAsynchronousSorting()
+{
+    if (m_itemsBeingSorted.isEmpty()) {
+        return;
+    }
+
+    m_sortingWatcher->waitForFinished();
+    QList<ItemData*> sortedItems = m_sortingWatcher->result();
+    Q_ASSERT(sortedItems.count() == m_itemsBeingSorted.count());
+    m_itemsBeingSorted.clear();
+
+    insertSortedItems(sortedItems);
+}
+
+void KFileItemModel::cancelAsynchronousSorting()
+{
+    if (m_itemsBeingSorted.isEmpty()) {
+        return;
+    }
+
+    m_sortingCanceled.store(1);
+    m_sortingWatcher->waitForFinished();
+
+    // The items are inserted later together with the other pending items.
+    m_pendingItemsToInsert = m_itemsBeingSorted + m_pendingItemsToInsert;
+    m_itemsBeingSorted.clear();
+}
+
+void KFileItemModel::slotAsynchronousSortingFinished()
+{
+    // Note that the sorted items might have been inserted already
+    // by dispatchPendingItemsToInsert(), or the sorting has been canceled.
+    finishAsynchronousSorting();
+
+    if (m_completedAfterSorting) {
+        m_completedAfterSorting = false;
+        slotCompleted();
+    }
+}
+
 void KFileItemModel::insertItems(QList<ItemData*>& newItems)
 {
     if (newItems.isEmpty()) {
@@ -1178,23 +1692,25 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
     qCDebug(DolphinDebug) << "Inserting" << newItems.count() << "items";
 #endif
 
-    m_groups.clear();
     prepareItemsForSorting(newItems);
 
-    if (m_sortRole == NameRole && m_naturalSorting) {
-        // Natural sorting of items can be very slow. However, it becomes much
-        // faster if the input sequence is already mostly sorted. Therefore, we
-        // first sort 'newItems' according to the QStrings returned by
-        // KFileItem::text() using QString::operator<(), which is quite fast.
-        parallelMergeSort(newItems.begin(), newItems.end(), nameLessThan, QThread::idealThreadCount());
-    }
-
     sort(newItems.begin(), newItems.end());
 
 #ifdef KFILEITEMMODEL_DEBUG
     qCDebug(DolphinDebug) << "[TIME] Sorting:" << timer.elapsed();
 #endif
 
+    insertSortedItems(newItems);
+
+#ifdef KFILEITEMMODEL_DEBUG
+    qCDebug(DolphinDebug) << "[TIME] Inserting of" << newItems.count() << "items:" << timer.elapsed();
+#endif
+}
+
+void KFileItemModel::insertSortedItems(const QList<ItemData*>& newItems)
+{
+    m_groups.clear();
+
     KItemRangeList itemRanges;
     const int existingItemCount = m_itemData.count();
     const int newItemCount = newItems.count();
@@ -1249,15 +1765,21 @@ void KFileItemModel::insertItems(QList<ItemData*>& newItems)
         std::reverse(itemRanges.begin(), itemRanges.end());
     }
 
-    // The indexes in m_items are not correct anymore. Therefore, we clear m_items.
-    // It will be re-populated with the updated indices if index(const QUrl&) is called.
-    m_items.clear();
+    // Only the indexes of the items behind the first inserted item have changed.
+    updateItemIndexes(itemRanges.first().index);
+    m_items.reserve(totalItemCount);
+    foreach (ItemData* itemData, newItems) {
+        m_items.insert(itemData->item.url(), itemData);
+    }
 
     emit itemsInserted(itemRanges);
 
+    if (m_timeToFirstItemsInserted < 0 && m_loadingTimer.isValid()) {
+        m_timeToFirstItemsInserted = m_loadingTimer.elapsed();
 #ifdef KFILEITEMMODEL_DEBUG
-    qCDebug(DolphinDebug) << "[TIME] Inserting of" << newItems.count() << "items:" << timer.elapsed();
+        qCDebug(DolphinDebug) << "Time to first items of" << m_dirLister->url() << ":" << m_timeToFirstItemsInserted << "ms";
 #endif
+    }
 }
 
 void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBehavior behavior)
@@ -1274,8 +1796,12 @@ void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBe
         removedItemsCount += range.count;
 
         for (int index = range.index; index < range.index + range.count; ++index) {
+            ItemData* itemData = m_itemData.at(index);
+            removeFromUrlHash(itemData);
+            itemData->index = -1;
+            m_roleStore.resetFlags(itemData->slot);
             if (behavior == DeleteItemData) {
-                delete m_itemData.at(index);
+                deleteItemData(itemData);
             }
 
             m_itemData[index] = nullptr;
@@ -1302,32 +1828,47 @@ void KFileItemModel::removeItems(const KItemRangeList& itemRanges, RemoveItemsBe
 
     m_itemData.erase(m_itemData.end() - removedItemsCount, m_itemData.end());
 
-    // The indexes in m_items are not correct anymore. Therefore, we clear m_items.
-    // It will be re-populated with the updated indices if index(const QUrl&) is called.
-    m_items.clear();
+    // Only the indexes of the items behind the first removed item have changed.
+    updateItemIndexes(itemRanges.at(0).index);
 
     emit itemsRemoved(itemRanges);
 }
 
-QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl& parentUrl, const KFileItemList& items) const
+QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl& parentUrl, const KFileItemList& items)
 {
+    KFileItemList newItems = items;
+    if (!m_prefetchedItems.isEmpty()) {
+        // Use the prefetched items with known MIME types instead of the items
+        // of the dir lister if the files have not been changed in the meantime.
+        for (int i = 0; i < newItems.count(); ++i) {
+            const KFileItem prefetchedItem = m_prefetchedItems.take(newItems.at(i).url());
+            if (!prefetchedItem.isNull()
+                && prefetchedItem.time(KFileItem::ModificationTime) == newItems.at(i).time(KFileItem::ModificationTime)
+                && prefetchedItem.size() == newItems.at(i).size()) {
+                newItems[i] = prefetchedItem;
+            }
+        }
+    }
+
     if (m_sortRole == TypeRole) {
         // Try to resolve the MIME-types synchronously to prevent a reordering of
         // the items when sorting by type (per default MIME-types are resolved
         // asynchronously by KFileItemModelRolesUpdater).
-        determineMimeTypes(items, 200);
+        determineMimeTypes(newItems, 200);
     }
 
     const int parentIndex = index(parentUrl);
     ItemData* parentItem = parentIndex < 0 ? nullptr : m_itemData.at(parentIndex);
 
     QList<ItemData*> itemDataList;
-    itemDataList.reserve(items.count());
+    itemDataList.reserve(newItems.count());
 
-    foreach (const KFileItem& item, items) {
-        ItemData* itemData = new ItemData();
+    foreach (const KFileItem& item, newItems) {
+        ItemData* itemData = m_itemDataPool.create();
         itemData->item = item;
         itemData->parent = parentItem;
+        itemData->index = -1;
+        itemData->slot = m_roleStore.allocateSlot();
         itemDataList.append(itemData);
     }
 
@@ -1335,6 +1876,14 @@ QList<KFileItemModel::ItemData*> KFileItemModel::createItemDataList(const QUrl&
 }
 
 void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
+{
+    // The name is used as fallback for all sort roles, hence the collation
+    // keys are required independent from m_sortRole.
+    updateSortKeys(itemDataList, m_collator);
+    retrieveSortRoleValues(itemDataList);
+}
+
+void KFileItemModel::retrieveSortRoleValues(QList<ItemData*>& itemDataList)
 {
     switch (m_sortRole) {
     case PermissionsRole:
@@ -1347,7 +1896,7 @@ void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
         // in the QHash "values" for the sorting.
         foreach (ItemData* itemData, itemDataList) {
             if (itemData->values.isEmpty()) {
-                itemData->values = retrieveData(itemData->item, itemData->parent);
+                setRoleValues(itemData, retrieveData(itemData->item, itemData->parent));
             }
         }
         break;
@@ -1358,7 +1907,7 @@ void KFileItemModel::prepareItemsForSorting(QList<ItemData*>& itemDataList)
             if (itemData->values.isEmpty()) {
                 const KFileItem item = itemData->item;
                 if (item.isDir() || item.isMimeTypeKnown()) {
-                    itemData->values = retrieveData(itemData->item, itemData->parent);
+                    setRoleValues(itemData, retrieveData(itemData->item, itemData->parent));
                 }
             }
         }
@@ -1407,12 +1956,10 @@ void KFileItemModel::removeExpandedItems()
     m_expandedDirs.clear();
 
     // Also remove all filtered items which have a parent.
-    QHash<KFileItem, ItemData*>::iterator it = m_filteredItems.begin();
-    const QHash<KFileItem, ItemData*>::iterator end = m_filteredItems.end();
-
-    while (it != end) {
-        if (it.value()->parent) {
-            delete it.value();
+    QList<ItemData*>::iterator it = m_filteredItems.begin();
+    while (it != m_filteredItems.end()) {
+        if ((*it)->parent) {
+            deleteItemData(*it);
             it = m_filteredItems.erase(it);
         } else {
             ++it;
@@ -1420,15 +1967,38 @@ void KFileItemModel::removeExpandedItems()
     }
 }
 
+void KFileItemModel::notifyItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles)
+{
+    if (m_transactionLevel == 0) {
+        emitItemsChangedAndTriggerResorting(itemRanges, changedRoles);
+        return;
+    }
+
+    foreach (const KItemRange& range, itemRanges) {
+        for (int index = range.index; index < range.index + range.count; ++index) {
+            m_itemsChangedInTransaction.insert(m_itemData.at(index));
+        }
+    }
+    m_rolesChangedInTransaction.unite(changedRoles);
+}
+
 void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles)
 {
+    countItemsChangedSignal();
     emit itemsChanged(itemRanges, changedRoles);
 
     // Trigger a resorting if necessary. Note that this can happen even if the sort
     // role has not changed at all because the file name can be used as a fallback.
-    if (changedRoles.contains(sortRole()) || changedRoles.contains(roleForType(NameRole))) {
+    const bool sortRoleChanged = changedRoles.contains(sortRole())
+                                 || (m_sortRole == SizeRole && changedRoles.contains("contentsSize"));
+    if (sortRoleChanged || changedRoles.contains(roleForType(NameRole))) {
+        // While other items are waiting to be moved, the neighbours of the
+        // changed items are no reliable reference for the checks below.
+        bool needsResorting = !m_itemsToResort.isEmpty();
         foreach (const KItemRange& range, itemRanges) {
-            bool needsResorting = false;
+            if (needsResorting) {
+                break;
+            }
 
             const int first = range.index;
             const int last = range.index + range.count - 1;
@@ -1451,11 +2021,19 @@ void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& i
                     }
                 }
             }
+        }
 
-            if (needsResorting) {
-                m_resortAllItemsTimer->start();
-                return;
+        if (needsResorting) {
+            // Only the changed items can be at a wrong position. All of them
+            // are moved by resortChangedItems(), as the neighbours that have
+            // been used for the check above might have changed too.
+            foreach (const KItemRange& range, itemRanges) {
+                for (int index = range.index; index < range.index + range.count; ++index) {
+                    m_itemsToResort.insert(m_itemData.at(index));
+                }
             }
+            m_resortAllItemsTimer->start();
+            return;
         }
     }
 
@@ -1472,6 +2050,19 @@ void KFileItemModel::emitItemsChangedAndTriggerResorting(const KItemRangeList& i
     }
 }
 
+void KFileItemModel::countItemsChangedSignal()
+{
+    if (!m_itemsChangedTimer.isValid() || m_itemsChangedTimer.elapsed() >= 1000) {
+        // Remember the number of signals of the last second, unless the
+        // last signal has been emitted even longer ago.
+        const bool lastSecond = m_itemsChangedTimer.isValid() && m_itemsChangedTimer.elapsed() < 2000;
+        m_itemsChangedPerSecond = lastSecond ? m_itemsChangedCount : 0;
+        m_itemsChangedCount = 0;
+        m_itemsChangedTimer.start();
+    }
+    ++m_itemsChangedCount;
+}
+
 void KFileItemModel::resetRoles()
 {
     for (int i = 0; i < RolesCount; ++i) {
@@ -1629,12 +2220,12 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
         data.insert(sharedValue("path"), path);
     }
 
-    if (m_requestRole[DeletionTimeRole]) {
-        QDateTime deletionTime;
-        if (item.url().scheme() == QLatin1String("trash")) {
-            deletionTime = QDateTime::fromString(item.entry().stringValue(KIO::UDSEntry::UDS_EXTRA + 1), Qt::ISODate);
+    if (m_requestRole[DeletionTimeRole] && item.url().scheme() == QLatin1String("trash")) {
+        // An unknown deletion time is not stored at all, see setStoredRoleValue().
+        const QDateTime deletionTime = QDateTime::fromString(item.entry().stringValue(KIO::UDSEntry::UDS_EXTRA + 1), Qt::ISODate);
+        if (deletionTime.isValid()) {
+            data.insert(sharedValue("deletiontime"), deletionTime);
         }
-        data.insert(sharedValue("deletiontime"), deletionTime);
     }
 
     if (m_requestRole[IsExpandableRole] && isDir) {
@@ -1662,6 +2253,154 @@ QHash<QByteArray, QVariant> KFileItemModel::retrieveData(const KFileItem& item,
     return data;
 }
 
+QVariant KFileItemModel::roleValue(const ItemData* itemData, const QByteArray& role) const
+{
+    const KFileItemModelRoleStore::Column column = KFileItemModelRoleStore::columnForRole(role);
+    if (column == KFileItemModelRoleStore::NoColumn) {
+        return itemData->values.value(role);
+    }
+
+    return storedRoleValue(itemData, column);
+}
+
+QHash<QByteArray, QVariant> KFileItemModel::roleValues(const ItemData* itemData) const
+{
+    QHash<QByteArray, QVariant> values = itemData->values;
+    for (int i = 0; i < KFileItemModelRoleStore::ColumnCount; ++i) {
+        const KFileItemModelRoleStore::Column column = static_cast<KFileItemModelRoleStore::Column>(i);
+        if (m_roleStore.contains(itemData->slot, column)) {
+            values.insert(KFileItemModelRoleStore::roleForColumn(column), storedRoleValue(itemData, column));
+        }
+    }
+
+    return values;
+}
+
+void KFileItemModel::setRoleValue(ItemData* itemData, const QByteArray& role, const QVariant& value) const
+{
+    const KFileItemModelRoleStore::Column column = KFileItemModelRoleStore::columnForRole(role);
+    if (column == KFileItemModelRoleStore::NoColumn) {
+        itemData->values.insert(role, value);
+    } else {
+        setStoredRoleValue(itemData, column, value);
+    }
+}
+
+void KFileItemModel::setRoleValues(ItemData* itemData, const QHash<QByteArray, QVariant>& values) const
+{
+    clearRoleValues(itemData);
+
+    QHashIterator<QByteArray, QVariant> it(values);
+    while (it.hasNext()) {
+        it.next();
+        setRoleValue(itemData, it.key(), it.value());
+    }
+}
+
+void KFileItemModel::clearRoleValues(ItemData* itemData) const
+{
+    itemData->values.clear();
+    m_roleStore.resetSlot(itemData->slot);
+}
+
+QVariant KFileItemModel::storedRoleValue(const ItemData* itemData, KFileItemModelRoleStore::Column column) const
+{
+    const int slot = itemData->slot;
+    if (!m_roleStore.contains(slot, column)) {
+        return QVariant();
+    }
+
+    switch (column) {
+    case KFileItemModelRoleStore::SizeColumn: {
+        // The "size" of a directory is the number of its items,
+        // see KFileItemModelRolesUpdater.
+        const qint64 size = m_roleStore.number(slot, column);
+        if (itemData->item.isDir()) {
+            return static_cast<int>(size);
+        }
+        return static_cast<KIO::filesize_t>(size);
+    }
+
+    case KFileItemModelRoleStore::ContentsSizeColumn:
+        return static_cast<KIO::filesize_t>(m_roleStore.number(slot, column));
+
+    case KFileItemModelRoleStore::ModificationTimeColumn:
+    case KFileItemModelRoleStore::CreationTimeColumn:
+    case KFileItemModelRoleStore::AccessTimeColumn:
+        return static_cast<long long>(m_roleStore.number(slot, column));
+
+    case KFileItemModelRoleStore::DeletionTimeColumn:
+        return QDateTime::fromMSecsSinceEpoch(m_roleStore.number(slot, column));
+
+    case KFileItemModelRoleStore::VersionColumn:
+        return m_roleStore.version(slot);
+
+    default:
+        Q_ASSERT(KFileItemModelRoleStore::isStringColumn(column));
+        return m_roleStore.string(slot, column);
+    }
+}
+
+void KFileItemModel::setStoredRoleValue(const ItemData* itemData, KFileItemModelRoleStore::Column column, const QVariant& value) const
+{
+    const int slot = itemData->slot;
+    if (!value.isValid()) {
+        m_roleStore.reset(slot, column);
+        return;
+    }
+
+    switch (column) {
+    case KFileItemModelRoleStore::DeletionTimeColumn: {
+        // An invalid deletion time is equivalent to an unset one for sorting and displaying.
+        const QDateTime dateTime = value.toDateTime();
+        if (dateTime.isValid()) {
+            m_roleStore.setNumber(slot, column, dateTime.toMSecsSinceEpoch());
+        } else {
+            m_roleStore.reset(slot, column);
+        }
+        break;
+    }
+
+    case KFileItemModelRoleStore::VersionColumn:
+        m_roleStore.setVersion(slot, value.toInt());
+        break;
+
+    default:
+        if (KFileItemModelRoleStore::isNumberColumn(column)) {
+            m_roleStore.setNumber(slot, column, value.toLongLong());
+        } else {
+            m_roleStore.setString(slot, column, value.toString());
+        }
+        break;
+    }
+}
+
+void KFileItemModel::updateItemIndexes(int first)
+{
+    for (int i = first, iMax = m_itemData.count(); i < iMax; ++i) {
+        m_itemData.at(i)->index = i;
+    }
+}
+
+void KFileItemModel::removeFromUrlHash(const ItemData* itemData)
+{
+    // If the model is inconsistent and contains several items with the same
+    // URL, the entry might belong to another item.
+    const QUrl url = itemData->item.url();
+    const auto it = m_items.find(url);
+    if (it != m_items.end() && it.value() == itemData) {
+        m_items.erase(it);
+    }
+}
+
+void KFileItemModel::deleteItemData(ItemData* itemData)
+{
+    m_itemsToResort.remove(itemData);
+    m_itemsChangedInTransaction.remove(itemData);
+    m_roleStore.releaseSlot(itemData->slot);
+    m_itemDataPool.destroy(itemData);
+}
+
 bool KFileItemModel::lessThan(const ItemData* a, const ItemData* b, const QCollator& collator) const
 {
     int result = 0;
@@ -1715,22 +2454,186 @@ bool KFileItemModel::lessThan(const ItemData* a, const ItemData* b, const QColla
 void KFileItemModel::sort(QList<KFileItemModel::ItemData*>::iterator begin,
                           QList<KFileItemModel::ItemData*>::iterator end) const
 {
-    auto lambdaLessThan = [&] (const KFileItemModel::ItemData* a, const KFileItemModel::ItemData* b)
+    const int itemCount = end - begin;
+    if (itemCount < 2) {
+        return;
+    }
+
+    static const int numberOfThreads = QThread::idealThreadCount();
+
+    const ItemData* parent = (*begin)->parent;
+    const bool haveSameParent = std::all_of(begin, end, [parent](const ItemData* itemData) {
+        return itemData->parent == parent;
+    });
+
+    if (!haveSameParent) {
+        // Items with different parents are compared by walking up their parent
+        // chains in lessThan(). This happens only when items of different
+        // expanded folders are sorted together.
+        auto lambdaLessThan = [&] (const KFileItemModel::ItemData* a, const KFileItemModel::ItemData* b)
+        {
+            return lessThan(a, b, m_collator);
+        };
+
+        if (m_sortRole == NameRole) {
+            parallelMergeSort(begin, end, lambdaLessThan, numberOfThreads);
+        } else {
+            // Use only one thread to prevent problems caused by non-reentrant
+            // comparison functions, see https://bugs.kde.org/show_bug.cgi?id=312679
+            mergeSort(begin, end, lambdaLessThan);
+        }
+        return;
+    }
+
+    // Extract the sort keys in the calling thread. Comparing the keys does not
+    // modify any data, hence items can be sorted by all roles in parallel.
+    std::vector<ItemSortKey> keys;
+    keys.reserve(itemCount);
+    for (QList<ItemData*>::iterator it = begin; it != end; ++it) {
+        keys.push_back(extractSortKey(*it));
+    }
+
+    const bool dirsFirst = m_sortDirsFirst || m_sortRole == SizeRole;
+    const bool ascending = (sortOrder() == Qt::AscendingOrder);
+    auto keyLessThan = [&] (const ItemSortKey& a, const ItemSortKey& b)
     {
-        return lessThan(a, b, m_collator);
+        return sortKeyLessThan(a, b, dirsFirst, ascending, m_collator);
     };
 
-    if (m_sortRole == NameRole) {
-        // Sorting by name can be expensive, in particular if natural sorting is
-        // enabled. Use all CPU cores to speed up the sorting process.
-        static const int numberOfThreads = QThread::idealThreadCount();
-        parallelMergeSort(begin, end, lambdaLessThan, numberOfThreads);
-    } else {
-        // Sorting by other roles is quite fast. Use only one thread to prevent
-        // problems caused by non-reentrant comparison functions, see
-        // https://bugs.kde.org/show_bug.cgi?id=312679
-        mergeSort(begin, end, lambdaLessThan);
+    workStealingMergeSort(keys.begin(), keys.end(), keyLessThan, numberOfThreads);
+
+    QList<ItemData*>::iterator it = begin;
+    for (const ItemSortKey& key : keys) {
+        *it = key.itemData;
+        ++it;
+    }
+}
+
+KFileItemModel::ItemSortKey KFileItemModel::extractSortKey(ItemData* itemData) const
+{
+    const KFileItem& item = itemData->item;
+
+    ItemSortKey key;
+    key.itemData = itemData;
+    key.number = 0;
+    key.isDir = item.isDir();
+
+    switch (m_sortRole) {
+    case NameRole:
+        break;
+
+    case SizeRole:
+        if (key.isDir) {
+            key.number = directorySizeSortValue(itemData);
+        } else {
+            key.number = static_cast<qint64>(item.size());
+        }
+        break;
+
+    case ModificationTimeRole:
+        key.number = item.entry().numberValue(KIO::UDSEntry::UDS_MODIFICATION_TIME, -1);
+        break;
+
+    case CreationTimeRole:
+        key.number = item.entry().numberValue(KIO::UDSEntry::UDS_CREATION_TIME, -1);
+        break;
+
+    case AccessTimeRole:
+        key.number = item.entry().numberValue(KIO::UDSEntry::UDS_ACCESS_TIME, -1);
+        break;
+
+    case DeletionTimeRole:
+        key.number = m_roleStore.number(itemData->slot, KFileItemModelRoleStore::DeletionTimeColumn);
+        break;
+
+    case RatingRole:
+    case WidthRole:
+    case HeightRole:
+    case WordCountRole:
+    case LineCountRole:
+    case TrackRole:
+    case ReleaseYearRole:
+        key.number = itemData->values.value(roleForType(m_sortRole)).toInt();
+        break;
+
+    case TypeRole:
+    case OwnerRole:
+    case GroupRole:
+    case PermissionsRole: {
+        const int id = m_roleStore.stringId(itemData->slot, stringColumnForRole(m_sortRole));
+        key.number = id;
+        key.string = m_roleStore.stringForId(id);
+        break;
+    }
+
+    default:
+        key.string = itemData->values.value(roleForType(m_sortRole)).toString();
+        break;
+    }
+
+    return key;
+}
+
+bool KFileItemModel::sortKeyLessThan(const ItemSortKey& a, const ItemSortKey& b,
+                                     bool dirsFirst, bool ascending, const QCollator& collator) const
+{
+    // See "if (m_sortDirsFirst || m_sortRole == SizeRole)" in KFileItemModel::lessThan()
+    if (dirsFirst && a.isDir != b.isDir) {
+        return a.isDir;
     }
+
+    const int result = sortKeyCompare(a, b, collator);
+    return ascending ? result < 0 : result > 0;
+}
+
+int KFileItemModel::sortKeyCompare(const ItemSortKey& a, const ItemSortKey& b, const QCollator& collator) const
+{
+    int result = 0;
+
+    if (stringColumnForRole(m_sortRole) != KFileItemModelRoleStore::NoColumn) {
+        // The number is the ID of an interned string, see sortRoleCompare().
+        if (a.number != b.number) {
+            result = QString::compare(a.string, b.string);
+        }
+    } else if (a.number != b.number) {
+        result = (a.number < b.number) ? -1 : +1;
+    } else if (!a.string.isNull() || !b.string.isNull()) {
+        result = QString::compare(a.string, b.string);
+    }
+
+    if (result != 0) {
+        return result;
+    }
+
+    return fallbackCompare(a.itemData, b.itemData, collator);
+}
+
+KFileItemModelRoleStore::Column KFileItemModel::stringColumnForRole(RoleType roleType)
+{
+    switch (roleType) {
+    case TypeRole:        return KFileItemModelRoleStore::TypeColumn;
+    case OwnerRole:       return KFileItemModelRoleStore::OwnerColumn;
+    case GroupRole:       return KFileItemModelRoleStore::GroupColumn;
+    case PermissionsRole: return KFileItemModelRoleStore::PermissionsColumn;
+    default:              return KFileItemModelRoleStore::NoColumn;
+    }
+}
+
+qint64 KFileItemModel::directorySizeSortValue(const ItemData* itemData) const
+{
+    const qint64 contentsSize = m_roleStore.number(itemData->slot, KFileItemModelRoleStore::ContentsSizeColumn);
+    if (contentsSize != KFileItemModelRoleStore::NoNumber) {
+        return contentsSize;
+    }
+
+    const qint64 count = m_roleStore.number(itemData->slot, KFileItemModelRoleStore::SizeColumn);
+    if (count == KFileItemModelRoleStore::NoNumber) {
+        return count;
+    }
+
+    // Map the numbers of items, including -1 for an unknown number, to the
+    // range above NoNumber, which is below all sizes of contents.
+    return KFileItemModelRoleStore::NoNumber + 2 + qMax(count, qint64(-1));
 }
 
 int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const
@@ -1750,16 +2653,12 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
             // See "if (m_sortFoldersFirst || m_sortRole == SizeRole)" in KFileItemModel::lessThan():
             Q_ASSERT(itemB.isDir());
 
-            const QVariant valueA = a->values.value("size");
-            const QVariant valueB = b->values.value("size");
-            if (valueA.isNull() && valueB.isNull()) {
-                result = 0;
-            } else if (valueA.isNull()) {
+            const qint64 valueA = directorySizeSortValue(a);
+            const qint64 valueB = directorySizeSortValue(b);
+            if (valueA < valueB) {
                 result = -1;
-            } else if (valueB.isNull()) {
+            } else if (valueA > valueB) {
                 result = +1;
-            } else {
-                result = valueA.toInt() - valueB.toInt();
             }
         } else {
             // See "if (m_sortFoldersFirst || m_sortRole == SizeRole)" in KFileItemModel::lessThan():
@@ -1799,9 +2698,21 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
         break;
     }
 
+    case AccessTimeRole: {
+        const long long dateTimeA = itemA.entry().numberValue(KIO::UDSEntry::UDS_ACCESS_TIME, -1);
+        const long long dateTimeB = itemB.entry().numberValue(KIO::UDSEntry::UDS_ACCESS_TIME, -1);
+        if (dateTimeA < dateTimeB) {
+            result = -1;
+        } else if (dateTimeA > dateTimeB) {
+            result = +1;
+        }
+        break;
+    }
+
     case DeletionTimeRole: {
-        const QDateTime dateTimeA = a->values.value("deletiontime").toDateTime();
-        const QDateTime dateTimeB = b->values.value("deletiontime").toDateTime();
+        // Unknown deletion times are stored as NoNumber, which is smaller than all valid times.
+        const qint64 dateTimeA = m_roleStore.number(a->slot, KFileItemModelRoleStore::DeletionTimeColumn);
+        const qint64 dateTimeB = m_roleStore.number(b->slot, KFileItemModelRoleStore::DeletionTimeColumn);
         if (dateTimeA < dateTimeB) {
             result = -1;
         } else if (dateTimeA > dateTimeB) {
@@ -1821,6 +2732,21 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
         break;
     }
 
+    case TypeRole:
+    case OwnerRole:
+    case GroupRole:
+    case PermissionsRole: {
+        const KFileItemModelRoleStore::Column column = stringColumnForRole(m_sortRole);
+
+        // The strings are interned, hence equal IDs imply equal strings.
+        const int idA = m_roleStore.stringId(a->slot, column);
+        const int idB = m_roleStore.stringId(b->slot, column);
+        if (idA != idB) {
+            result = QString::compare(m_roleStore.stringForId(idA), m_roleStore.stringForId(idB));
+        }
+        break;
+    }
+
     default: {
         const QByteArray role = roleForType(m_sortRole);
         result = QString::compare(a->values.value(role).toString(),
@@ -1835,8 +2761,16 @@ int KFileItemModel::sortRoleCompare(const ItemData* a, const ItemData* b, const
         return result;
     }
 
+    return fallbackCompare(a, b, collator);
+}
+
+int KFileItemModel::fallbackCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const
+{
+    const KFileItem& itemA = a->item;
+    const KFileItem& itemB = b->item;
+
     // Fallback #1: Compare the text of the items
-    result = stringCompare(itemA.text(), itemB.text(), collator);
+    int result = nameCompare(a, b, collator);
     if (result != 0) {
         return result;
     }
@@ -1870,6 +2804,75 @@ int KFileItemModel::stringCompare(const QString& a, const QString& b, const QCol
     return QString::compare(a, b, Qt::CaseSensitive);
 }
 
+int KFileItemModel::nameCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const
+{
+    if (m_naturalSorting && a->sortKey && b->sortKey) {
+        return a->sortKey->compare(*b->sortKey);
+    }
+
+    return stringCompare(a->item.text(), b->item.text(), collator);
+}
+
+void KFileItemModel::updateSortKeys(const QList<ItemData*>& itemDataList, const QCollator& collator,
+                                    const QAtomicInt* canceled) const
+{
+    if (!m_naturalSorting) {
+        return;
+    }
+
+    QList<ItemData*> itemsWithoutSortKey;
+    foreach (ItemData* itemData, itemDataList) {
+        if (!itemData->sortKey) {
+            itemsWithoutSortKey.append(itemData);
+        }
+    }
+
+    auto createSortKey = [&collator, canceled](ItemData* itemData) {
+        if (canceled && canceled->loadAcquire()) {
+            return;
+        }
+        itemData->sortKey.reset(new QCollatorSortKey(collator.sortKey(itemData->item.text())));
+    };
+
+    // Creating the collation keys is the expensive part of natural sorting, and it is
+    // done once per item. Use all CPU cores for large lists. Note that the collator
+    // must be in a clean state, see the workaround in loadSortingSettings().
+    if (itemsWithoutSortKey.count() > 1000) {
+        QtConcurrent::blockingMap(itemsWithoutSortKey, createSortKey);
+    } else {
+        std::for_each(itemsWithoutSortKey.begin(), itemsWithoutSortKey.end(), createSortKey);
+    }
+}
+
+void KFileItemModel::resetSortKeys()
+{
+    foreach (ItemData* itemData, m_itemData) {
+        itemData->sortKey.reset();
+    }
+    foreach (ItemData* itemData, m_filteredItems) {
+        itemData->sortKey.reset();
+    }
+    m_filteredItemsSorted = m_filteredItems.isEmpty();
+    foreach (ItemData* itemData, m_pendingItemsToInsert) {
+        itemData->sortKey.reset();
+    }
+}
+
+qint64 KFileItemModel::timeToFirstItemsInserted() const
+{
+    return m_timeToFirstItemsInserted;
+}
+
+int KFileItemModel::itemsChangedPerSecond() const
+{
+    if (!m_itemsChangedTimer.isValid() || m_itemsChangedTimer.elapsed() >= 2000) {
+        return 0;
+    } else if (m_itemsChangedTimer.elapsed() >= 1000) {
+        return m_itemsChangedCount;
+    }
+    return qMax(m_itemsChangedCount, m_itemsChangedPerSecond);
+}
+
 bool KFileItemModel::useMaximumUpdateInterval() const
 {
     return !m_dirLister->url().isLocalFile();
@@ -2118,7 +3121,7 @@ QList<QPair<int, QVariant> > KFileItemModel::permissionRoleGroups() const
         }
 
         const ItemData* itemData = m_itemData.at(i);
-        const QString newPermissionsString = itemData->values.value("permissions").toString();
+        const QString newPermissionsString = m_roleStore.string(itemData->slot, KFileItemModelRoleStore::PermissionsColumn);
         if (newPermissionsString == permissionsString) {
             continue;
         }
@@ -2210,7 +3213,7 @@ QList<QPair<int, QVariant> > KFileItemModel::genericStringRoleGroups(const QByte
         if (isChildItem(i)) {
             continue;
         }
-        const QString newGroupValue = m_itemData.at(i)->values.value(role).toString();
+        const QString newGroupValue = roleValue(m_itemData.at(i), role).toString();
         if (newGroupValue != groupValue || isFirstGroupValue) {
             groupValue = newGroupValue;
             groups.append(QPair<int, QVariant>(i, newGroupValue));
@@ -2249,6 +3252,31 @@ void KFileItemModel::emitSortProgress(int resolvedCount)
     }
 }
 
+bool KFileItemModel::itemFlag(int index, ItemFlag flag) const
+{
+    if (index < 0 || index >= m_itemData.count()) {
+        return false;
+    }
+    return m_roleStore.flag(m_itemData.at(index)->slot, flag);
+}
+
+void KFileItemModel::setItemFlag(int index, ItemFlag flag, bool set)
+{
+    if (index >= 0 && index < m_itemData.count()) {
+        m_roleStore.setFlag(m_itemData.at(index)->slot, flag, set);
+    }
+}
+
+int KFileItemModel::itemFlagCount(ItemFlag flag) const
+{
+    return m_roleStore.flagCount(flag);
+}
+
+void KFileItemModel::resetItemFlag(ItemFlag flag)
+{
+    m_roleStore.resetFlag(flag);
+}
+
 const KFileItemModel::RoleInfoMap* KFileItemModel::rolesInfoMap(int& count)
 {
     static const RoleInfoMap rolesInfoMap[] = {
@@ -2292,24 +3320,22 @@ const KFileItemModel::RoleInfoMap* KFileItemModel::rolesInfoMap(int& count)
 
 void KFileItemModel::determineMimeTypes(const KFileItemList& items, int timeout)
 {
-    QElapsedTimer timer;
-    timer.start();
+    // Only determine mime types for files here. For directories,
+    // KFileItem::determineMimeType() reads the .directory file inside to
+    // load the icon, but this is not necessary at all if we just need the
+    // type. Some special code for setting the correct mime type for
+    // directories is in retrieveData().
+    KFileItemList files;
+    files.reserve(items.count());
     foreach (const KFileItem& item, items) { // krazy:exclude=foreach
-        // Only determine mime types for files here. For directories,
-        // KFileItem::determineMimeType() reads the .directory file inside to
-        // load the icon, but this is not necessary at all if we just need the
-        // type. Some special code for setting the correct mime type for
-        // directories is in retrieveData().
         if (!item.isDir()) {
-            item.determineMimeType();
-        }
-
-        if (timer.elapsed() > timeout) {
-            // Don't block the user interface, let the remaining items
-            // be resolved asynchronously.
-            return;
+            files.append(item);
         }
     }
+
+    // Don't block the user interface longer than the timeout, let the
+    // remaining items be resolved asynchronously by KFileItemModelRolesUpdater.
+    KMimeTypeResolver::determineMimeTypes(files, timeout);
 }
 
 QByteArray KFileItemModel::sharedValue(const QByteArray& value)
@@ -2327,9 +3353,8 @@ QByteArray KFileItemModel::sharedValue(const QByteArray& value)
 
 bool KFileItemModel::isConsistent() const
 {
-    // m_items may contain less items than m_itemData because m_items
-    // is populated lazily, see KFileItemModel::index(const QUrl& url).
-    if (m_items.count() > m_itemData.count()) {
+    if (m_items.count() != m_itemData.count()) {
+        qCWarning(DolphinDebug) << "m_items contains" << m_items.count() << "items, m_itemData" << m_itemData.count();
         return false;
     }
 
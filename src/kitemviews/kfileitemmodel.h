@@ -23,18 +23,26 @@
 #include "dolphin_export.h"
 #include "kitemviews/kitemmodelbase.h"
 #include "kitemviews/private/kfileitemmodelfilter.h"
+#include "kitemviews/private/kfileitemmodelrolestore.h"
+#include "kitemviews/private/kitemdatapool.h"
 
 #include <KFileItem>
 
+#include <QAtomicInt>
 #include <QCollator>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QScopedPointer>
 #include <QSet>
 #include <QUrl>
+#include <QVector>
 
 #include <functional>
+#include <vector>
 
 class KFileItemModelDirLister;
 class QTimer;
+template <typename T> class QFutureWatcher;
 
 /**
  * @brief KItemModelBase implementation for KFileItems.
@@ -59,6 +67,7 @@ public:
      * directoryLoadingStarted(), directoryLoadingProgress() and directoryLoadingCompleted()
      * indicate the current state of the loading process. The items
      * of the directory are added after the loading has been completed.
+     * Huge local directories are added in batches while loading.
      */
     void loadDirectory(const QUrl& url);
 
@@ -68,6 +77,16 @@ public:
      */
     void refreshDirectory(const QUrl& url);
 
+    /**
+     * Sets items of the directory that is loaded next whose MIME types are
+     * known already, e.g. because they have been prefetched by
+     * KDirectoryPrefetcher. If the dir lister reports an item with the same
+     * URL, modification time and size, the prefetched item is used instead,
+     * so that the item is shown with its final icon immediately. The items
+     * are dropped when loading the directory has been completed or canceled.
+     */
+    void setPrefetchedItems(const QHash<QUrl, KFileItem>& items);
+
     /**
      * @return Parent directory of the items that are shown. In case
      *         if a directory tree is shown, KFileItemModel::dir() returns
@@ -82,10 +101,62 @@ public:
      */
     void cancelDirectoryLoading();
 
+    /**
+     * @return Time in milliseconds between the start of loading the current
+     *         directory and the first itemsInserted() signal, or -1 if no
+     *         items have been inserted yet.
+     */
+    qint64 timeToFirstItemsInserted() const;
+
+    /**
+     * @return Number of itemsChanged() signals that have been emitted per
+     *         second. The signals are counted in intervals of one second, and
+     *         the higher count of the current and the previous interval is
+     *         returned. Useful for profiling how the changes of the roles are
+     *         announced to the view.
+     */
+    int itemsChangedPerSecond() const;
+
     int count() const override;
     QHash<QByteArray, QVariant> data(int index) const override;
     bool setData(int index, const QHash<QByteArray, QVariant>& values) override;
 
+    /**
+     * Values of one item for setItemsData().
+     */
+    struct ItemValues
+    {
+        int index;
+        QHash<QByteArray, QVariant> values;
+        // If not null, the KFileItem at the index is replaced by this item, which
+        // must have the same URL, e.g., because its MIME type has been determined.
+        KFileItem item;
+    };
+
+    /**
+     * Sets the values of several items at once. In contrast to calling setData()
+     * for each item, only one itemsChanged() signal is emitted for all changed
+     * items. Renaming items by changing the role "text" is not supported.
+     * Items of which only the KFileItem has been replaced are not reported
+     * as changed.
+     */
+    void setItemsData(const QVector<ItemValues>& itemValues);
+
+    /**
+     * Starts a transaction for changing the values of items. Until
+     * endTransaction() has been invoked as often as beginTransaction(),
+     * setData(), setItemsData() and items that are refreshed by the directory
+     * lister don't emit itemsChanged(). Instead, the changed items and roles
+     * are collected, and endTransaction() emits a single itemsChanged() signal
+     * with coalesced ranges for all of them. Items may be inserted, removed or
+     * moved during a transaction.
+     *
+     * As the transaction delays the changes of all users of the model, it
+     * should be ended before returning to the event loop.
+     */
+    void beginTransaction();
+    void endTransaction();
+
     /**
      * Sets a separate sorting with directories first (true) or a mixed
      * sorting of files and directories (false).
@@ -270,6 +341,15 @@ private slots:
      */
     void resortAllItems();
 
+    /**
+     * Moves the items from m_itemsToResort to their correct positions
+     * by binary insertion and emits one itemsMoved() signal per
+     * contiguous block of moved items. Falls back to resortAllItems()
+     * if too many items have changed or if directories are expanded.
+     */
+    void resortChangedItems();
+
+    void slotStarted();
     void slotCompleted();
     void slotCanceled();
     void slotItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
@@ -280,6 +360,20 @@ private slots:
 
     void dispatchPendingItemsToInsert();
 
+    /**
+     * Inserts the pending items of a local directory while it is still
+     * being listed. If the model is empty, only the items that belong to
+     * the top of the view are inserted, and the timer is restarted for
+     * the remaining items.
+     */
+    void dispatchStreamingBatch();
+
+    /**
+     * Inserts the items that have been sorted by the worker thread
+     * and completes the loading if slotCompleted() has been deferred.
+     */
+    void slotAsynchronousSortingFinished();
+
 private:
     enum RoleType {
         // User visible roles:
@@ -295,11 +389,52 @@ private:
         RolesCount
     };
 
+    /**
+     * State flags which KFileItemModelRolesUpdater stores for each item in
+     * m_roleStore. The flags move together with the items, and are unset if
+     * an item gets removed from m_itemData, e.g. because it is filtered.
+     */
+    enum ItemFlag {
+        // All roles of the item have been resolved.
+        FinishedFlag,
+        // The sort role of the item still has to be determined.
+        PendingSortRoleFlag,
+        // The item has been changed and its roles must be resolved again.
+        ChangedFlag,
+        // The item has been changed while resolving changes was postponed.
+        RecentlyChangedFlag
+    };
+
     struct ItemData
     {
         KFileItem item;
+        // Values of all roles that are not part of m_roleStore. Use roleValue()
+        // and setRoleValue() to access the roles independent from their storage.
         QHash<QByteArray, QVariant> values;
         ItemData* parent;
+        // Position of the item in m_itemData, or -1 if the item is
+        // filtered or has not been inserted yet.
+        int index;
+        // Slot of the item in m_roleStore.
+        int slot;
+        // Collation key of item.text() that is used instead of QCollator::compare()
+        // if natural sorting is enabled. It is created by updateSortKeys() and
+        // reset if the item gets renamed or the sorting choice has been changed.
+        QScopedPointer<QCollatorSortKey> sortKey;
+    };
+
+    /**
+     * Sort key of an item that is extracted by extractSortKey() before sorting. Comparing
+     * the keys with sortKeyCompare() results in the same order as sortRoleCompare(), but
+     * only data is read that is not modified while sorting. Hence the comparison is
+     * reentrant for all sort roles.
+     */
+    struct ItemSortKey
+    {
+        ItemData* itemData;
+        qint64 number;      // Value of numeric sort roles or ID of interned strings
+        QString string;     // Value of string sort roles
+        bool isDir;
     };
 
     enum RemoveItemsBehavior {
@@ -308,15 +443,51 @@ private:
     };
 
     void insertItems(QList<ItemData*>& items);
+
+    /**
+     * Merges the sorted items \a newItems into m_itemData and emits
+     * itemsInserted(). Helper method for insertItems().
+     */
+    void insertSortedItems(const QList<ItemData*>& newItems);
+
+    /**
+     * Moves the pending items to m_itemsBeingSorted and starts sorting them
+     * in a worker thread if the directory is local, all items have the same
+     * parent and there are enough of them to block the user interface.
+     * Only the final merge into m_itemData is done by the GUI thread.
+     * @return True if the sorting has been started.
+     */
+    bool startAsynchronousSorting();
+
+    /**
+     * Sorts the items of \a keys. Is executed by the worker thread
+     * and may not access any data that is modified by the GUI thread.
+     * @return The sorted items, or an empty list if the sorting has
+     *         been canceled.
+     */
+    QList<ItemData*> sortItemsInThread(std::vector<ItemSortKey>& keys, const QCollator& collator,
+                                       bool dirsFirst, bool ascending) const;
+
+    /**
+     * Waits for the worker thread and inserts the sorted items.
+     */
+    void finishAsynchronousSorting();
+
+    /**
+     * Cancels the worker thread and moves the items back to
+     * m_pendingItemsToInsert. Must be called before the sorting
+     * settings are changed and before the items are deleted.
+     */
+    void cancelAsynchronousSorting();
     void removeItems(const KItemRangeList& itemRanges, RemoveItemsBehavior behavior);
 
     /**
      * Helper method for insertItems() and removeItems(): Creates
      * a list of ItemData elements based on the given items.
-     * Note that the ItemData instances are created dynamically and
-     * must be deleted by the caller.
+     * Note that the ItemData instances are created by m_itemDataPool and
+     * must be deleted by the caller with deleteItemData().
      */
-    QList<ItemData*> createItemDataList(const QUrl& parentUrl, const KFileItemList& items) const;
+    QList<ItemData*> createItemDataList(const QUrl& parentUrl, const KFileItemList& items);
 
     /**
      * Prepares the items for sorting. Normally, the hash 'values' in ItemData is filled
@@ -325,17 +496,37 @@ private:
      */
     void prepareItemsForSorting(QList<ItemData*>& itemDataList);
 
+    /**
+     * Stores the values of the sort role in 'values' or m_roleStore if
+     * they are required for sorting, see prepareItemsForSorting().
+     */
+    void retrieveSortRoleValues(QList<ItemData*>& itemDataList);
+
     static int expandedParentsCount(const ItemData* data);
 
     void removeExpandedItems();
 
     /**
-     * This function is called by setData() and slotRefreshItems(). It emits
+     * Is called by setData(), setItemsData() and slotRefreshItems(). Emits the
+     * itemsChanged() signal by emitItemsChangedAndTriggerResorting(), or
+     * remembers the changed items and roles if a transaction is running.
+     */
+    void notifyItemsChanged(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles);
+
+    /**
+     * This function is called by notifyItemsChanged() and endTransaction(). It emits
      * the itemsChanged() signal, checks if the sort order is still correct,
-     * and starts m_resortAllItemsTimer if that is not the case.
+     * and starts m_resortAllItemsTimer if that is not the case. The
+     * changed items are remembered in m_itemsToResort.
      */
     void emitItemsChangedAndTriggerResorting(const KItemRangeList& itemRanges, const QSet<QByteArray>& changedRoles);
 
+    /**
+     * Updates the counters for itemsChangedPerSecond(). Must be invoked
+     * for each emitted itemsChanged() signal.
+     */
+    void countItemsChangedSignal();
+
     /**
      * Resets all values from m_requestRole to false.
      */
@@ -356,10 +547,53 @@ private:
     QHash<QByteArray, QVariant> retrieveData(const KFileItem& item, const ItemData* parent) const;
 
     /**
-     * @return True if \a a has a KFileItem whose text is 'less than' the one
-     *         of \a b according to QString::operator<(const QString&).
+     * @return Value of the role \a role for the item \a itemData. The value
+     *         is read from m_roleStore if the role is stored there and from
+     *         ItemData::values otherwise.
+     */
+    QVariant roleValue(const ItemData* itemData, const QByteArray& role) const;
+
+    /**
+     * @return Values of all roles of the item \a itemData. This is the only place
+     *         where the QHash for the roles of m_roleStore gets assembled.
+     */
+    QHash<QByteArray, QVariant> roleValues(const ItemData* itemData) const;
+
+    /**
+     * Sets the value of the role \a role for the item \a itemData. For roles that
+     * are stored in m_roleStore an invalid variant unsets the value.
      */
-    static bool nameLessThan(const ItemData* a, const ItemData* b);
+    void setRoleValue(ItemData* itemData, const QByteArray& role, const QVariant& value) const;
+
+    /**
+     * Replaces the values of all roles of the item \a itemData by \a values.
+     */
+    void setRoleValues(ItemData* itemData, const QHash<QByteArray, QVariant>& values) const;
+
+    /**
+     * Unsets the values of all roles of the item \a itemData. They will be
+     * retrieved again the next time data(int) is invoked for the item.
+     */
+    void clearRoleValues(ItemData* itemData) const;
+
+    QVariant storedRoleValue(const ItemData* itemData, KFileItemModelRoleStore::Column column) const;
+    void setStoredRoleValue(const ItemData* itemData, KFileItemModelRoleStore::Column column, const QVariant& value) const;
+
+    /**
+     * Sets ItemData::index of all items in m_itemData starting at \a first.
+     */
+    void updateItemIndexes(int first);
+
+    /**
+     * Removes the URL of \a itemData from m_items if it belongs to \a itemData.
+     */
+    void removeFromUrlHash(const ItemData* itemData);
+
+    /**
+     * Deletes the item \a itemData and releases its slot in m_roleStore. The
+     * memory is kept by m_itemDataPool for items that get created later.
+     */
+    void deleteItemData(ItemData* itemData);
 
     /**
      * @return True if the item-data \a a should be ordered before the item-data
@@ -369,10 +603,44 @@ private:
 
     /**
      * Sorts the items between \a begin and \a end using the comparison
-     * function lessThan().
+     * function lessThan(). If all items have the same parent, the sort keys
+     * of the items are extracted and sorted by all CPU cores.
      */
     void sort(QList<ItemData*>::iterator begin, QList<ItemData*>::iterator end) const;
 
+    ItemSortKey extractSortKey(ItemData* itemData) const;
+
+    /**
+     * @return True if the sort key \a a should be ordered before \a b.
+     *         \a dirsFirst and \a ascending are passed explicitly, so that
+     *         the settings can be read once before sorting.
+     */
+    bool sortKeyLessThan(const ItemSortKey& a, const ItemSortKey& b,
+                         bool dirsFirst, bool ascending, const QCollator& collator) const;
+
+    /**
+     * Compares the sort keys \a a and \a b. Both items must have the same
+     * parent item. Uses fallbackCompare() if the sort role does not define
+     * an order.
+     */
+    int sortKeyCompare(const ItemSortKey& a, const ItemSortKey& b, const QCollator& collator) const;
+
+    /**
+     * @return Value by which the directory \a itemData is sorted if the model
+     *         is sorted by size. Directories are sorted by the size of their
+     *         contents if it is known, and by the number of their items
+     *         otherwise. A known size of the contents is considered larger
+     *         than any number of items, and an unknown "size" is the smallest
+     *         value (KFileItemModelRoleStore::NoNumber).
+     */
+    qint64 directorySizeSortValue(const ItemData* itemData) const;
+
+    /**
+     * @return Column of m_roleStore for the roles that are stored as interned
+     *         strings, or KFileItemModelRoleStore::NoColumn for all other roles.
+     */
+    static KFileItemModelRoleStore::Column stringColumnForRole(RoleType roleType);
+
     /**
      * Helper method for lessThan() and expandedParentsCountCompare(): Compares
      * the passed item-data using m_sortRole as criteria. Both items must
@@ -380,8 +648,36 @@ private:
      */
     int sortRoleCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const;
 
+    /**
+     * Compares the passed item-data by their names and URLs. Is used if the sort
+     * role does not define an order. The result is unique for different items.
+     */
+    int fallbackCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const;
+
     int stringCompare(const QString& a, const QString& b, const QCollator& collator) const;
 
+    /**
+     * Compares the texts of the items \a a and \a b. If natural sorting is enabled
+     * and both items have a collation key, the keys are compared, otherwise
+     * stringCompare() is used as fallback.
+     */
+    int nameCompare(const ItemData* a, const ItemData* b, const QCollator& collator) const;
+
+    /**
+     * Creates the collation keys for all items of \a itemDataList that don't
+     * have one yet with \a collator. Large lists are processed by multiple
+     * threads. Nothing is done if natural sorting is disabled. No further
+     * keys are created after \a canceled has been set.
+     */
+    void updateSortKeys(const QList<ItemData*>& itemDataList, const QCollator& collator,
+                        const QAtomicInt* canceled = nullptr) const;
+
+    /**
+     * Resets the collation keys of all items, including the filtered and
+     * pending items. Must be invoked if the collator settings have been changed.
+     */
+    void resetSortKeys();
+
     bool useMaximumUpdateInterval() const;
 
     QList<QPair<int, QVariant> > nameRoleGroups() const;
@@ -407,10 +703,28 @@ private:
      */
     void emitSortProgress(int resolvedCount);
 
+    /**
+     * Accessors for the flags of KFileItemModelRolesUpdater, see ItemFlag.
+     * Invalid indexes are ignored, and have no flags set.
+     */
+    bool itemFlag(int index, ItemFlag flag) const;
+    void setItemFlag(int index, ItemFlag flag, bool set);
+    int itemFlagCount(ItemFlag flag) const;
+    void resetItemFlag(ItemFlag flag);
+
     /**
      * Applies the filters set through @ref setNameFilter and @ref setMimeTypeFilters.
+     * If \a narrowed is true, the filters can only have become stricter, and the
+     * items that are hidden already are not checked again.
+     */
+    void applyFilters(bool narrowed = false);
+
+    /**
+     * Adds \a items to m_filteredItems. If \a sorted is true, the items are
+     * sorted already and get merged into m_filteredItems, which keeps
+     * m_filteredItems sorted if it has been sorted before.
      */
-    void applyFilters();
+    void insertFilteredItems(const QList<ItemData*>& items, bool sorted);
 
     /**
      * Removes filtered items whose expanded parents have been deleted
@@ -446,7 +760,8 @@ private:
 
     /**
      * Determines the MIME-types of all items that can be done within
-     * the given timeout.
+     * the given timeout. The MIME-types are determined in parallel
+     * by KMimeTypeResolver.
      */
     static void determineMimeTypes(const KFileItemList& items, int timeout);
 
@@ -474,21 +789,38 @@ private:
 
     QList<ItemData*> m_itemData;
 
-    // m_items is a cache for the method index(const QUrl&). If it contains N
-    // entries, it is guaranteed that these correspond to the first N items in
-    // the model, i.e., that (for every i between 0 and N - 1)
-    // m_items.value(fileItem(i).url()) == i
-    mutable QHash<QUrl, int> m_items;
+    // Owns all instances of ItemData, including the filtered and pending items.
+    KItemDataPool<ItemData> m_itemDataPool;
+
+    // Typed storage for the roles that are used for sorting and grouping,
+    // indexed by ItemData::slot. It is mutable because data(int) populates
+    // the roles of an item lazily.
+    mutable KFileItemModelRoleStore m_roleStore;
+
+    // Maps the URLs of all items in m_itemData to their ItemData. Together
+    // with ItemData::index, it allows index(const QUrl&) to find an item in
+    // constant time. Only inserting and removing items modifies m_items,
+    // moving items just updates ItemData::index.
+    QHash<QUrl, ItemData*> m_items;
 
     KFileItemModelFilter m_filter;
-    QHash<KFileItem, ItemData*> m_filteredItems; // Items that got hidden by KFileItemModel::setNameFilter()
+    // Items that got hidden by KFileItemModel::setNameFilter() or setMimeTypeFilters().
+    // If m_filteredItemsSorted is true, the items are sorted like m_itemData, and
+    // items that get visible again can be merged into m_itemData without sorting.
+    QList<ItemData*> m_filteredItems;
+    bool m_filteredItemsSorted;
 
     bool m_requestRole[RolesCount];
 
     QTimer* m_maximumUpdateIntervalTimer;
+    QTimer* m_streamingTimer;
     QTimer* m_resortAllItemsTimer;
     QList<ItemData*> m_pendingItemsToInsert;
 
+    // Items that might not be at their correct position anymore. They are
+    // moved by resortChangedItems() when m_resortAllItemsTimer fires.
+    QSet<ItemData*> m_itemsToResort;
+
     // Cache for KFileItemModel::groups()
     mutable QList<QPair<int, QVariant> > m_groups;
 
@@ -499,19 +831,40 @@ private:
     // and done step after step in slotCompleted().
     QSet<QUrl> m_urlsToExpand;
 
-    friend class KFileItemModelRolesUpdater;   // Accesses emitSortProgress() method
+    // Items with known MIME types that replace the items of the dir lister,
+    // see setPrefetchedItems().
+    QHash<QUrl, KFileItem> m_prefetchedItems;
+
+    // Measures the time between starting to load a directory and the first
+    // itemsInserted() signal, see timeToFirstItemsInserted().
+    QElapsedTimer m_loadingTimer;
+    qint64 m_timeToFirstItemsInserted;
+
+    // Items and roles that have been changed during a transaction, see beginTransaction()
+    int m_transactionLevel;
+    QSet<ItemData*> m_itemsChangedInTransaction;
+    QSet<QByteArray> m_rolesChangedInTransaction;
+
+    // Counts the itemsChanged() signals, see itemsChangedPerSecond()
+    QElapsedTimer m_itemsChangedTimer;
+    int m_itemsChangedCount;
+    int m_itemsChangedPerSecond;
+
+    // Sorting of huge directories in a worker thread, see startAsynchronousSorting().
+    // The items in m_itemsBeingSorted may not be accessed until the worker has finished.
+    QFutureWatcher<QList<ItemData*> >* m_sortingWatcher;
+    QList<ItemData*> m_itemsBeingSorted;
+    QAtomicInt m_sortingCanceled;
+    bool m_completedAfterSorting;
+
+    friend class KFileItemModelRolesUpdater;   // Accesses emitSortProgress() and the item flags
     friend class KFileItemModelTest;           // For unit testing
     friend class KFileItemModelBenchmark;      // For unit testing
+    friend class KItemListViewLayouterBenchmark; // For unit testing
     friend class KFileItemListViewTest;        // For unit testing
     friend class DolphinPart;                  // Accesses m_dirLister
 };
 
-inline bool KFileItemModel::nameLessThan(const ItemData* a, const ItemData* b)
-{
-    return a->item.text() < b->item.text();
-}
-
-
 inline bool KFileItemModel::isChildItem(int index) const
 {
     if (m_itemData.at(index)->parent) {
@@ -21,7 +21,9 @@
 
 #include "kfileitemmodel.h"
 #include "private/kdirectorycontentscounter.h"
+#include "private/kmimetyperesolver.h"
 #include "private/kpixmapmodifier.h"
+#include "private/kpreviewcache.h"
 
 #include <KConfig>
 #include <KConfigGroup>
@@ -40,9 +42,13 @@
 #endif
 
 #include <QApplication>
+#include <QDataStream>
 #include <QPainter>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QThread>
 #include <QTimer>
+#include <QtConcurrentMap>
 
 
 // #define KFILEITEMMODELROLESUPDATER_DEBUG
@@ -59,6 +65,94 @@ namespace {
     // Not only the visible area, but up to ReadAheadPages before and after
     // this area will be resolved.
     const int ReadAheadPages = 5;
+
+    // Maximum time in ms that the asynchronous resolving of roles may block
+    // the event loop before the resolved roles are applied to the model.
+    const int ResolveSliceTimeout = 20;
+
+    // Maximum number of items that are passed to the KMimeTypeResolver
+    // at once.
+    const int ResolveInThreadChunkSize = 200;
+
+    // Maximum number of preview jobs that run concurrently.
+    const int MaxPreviewJobs = 4;
+
+    // Minimum number of items for which one preview job creates previews.
+    // Smaller chunks allow to react faster to changes of the visible area,
+    // but increase the overhead of the preview jobs.
+    const int MinPreviewJobChunkSize = 8;
+
+    // Time in ms during which the resolved roles are collected before they
+    // are applied to the model at once. This is about one frame at 60 Hz.
+    const int PendingItemValuesInterval = 16;
+
+    // The "size" of a directory is the number of its items. The size of its
+    // contents is stored as "contentsSize" if KDirectoryContentsCounter
+    // determines it, and is reset otherwise.
+    void insertDirectorySize(QHash<QByteArray, QVariant>& data, int count, qint64 size)
+    {
+        data.insert("size", count);
+        data.insert("contentsSize", size >= 0 ? QVariant::fromValue<KIO::filesize_t>(size) : QVariant());
+    }
+
+    QImage framedPreview(const QImage& preview, const QSize& iconSize, qreal devicePixelRatio, bool enlargeSmallPreviews)
+    {
+        QImage scaledPreview = preview;
+
+        if (!preview.hasAlphaChannel()
+            && iconSize.width()  > KIconLoader::SizeSmallMedium
+            && iconSize.height() > KIconLoader::SizeSmallMedium) {
+            if (enlargeSmallPreviews) {
+                KPixmapModifier::applyFrame(scaledPreview, iconSize, devicePixelRatio);
+            } else {
+                // Assure that small previews don't get enlarged. Instead they
+                // should be shown centered within the frame.
+                const QSize contentSize = KPixmapModifier::sizeInsideFrame(iconSize);
+                const bool enlargingRequired = scaledPreview.width()  < contentSize.width() &&
+                                               scaledPreview.height() < contentSize.height();
+                if (enlargingRequired) {
+                    QSize frameSize = scaledPreview.size() / scaledPreview.devicePixelRatio();
+                    frameSize.scale(iconSize, Qt::KeepAspectRatio);
+
+                    QImage largeFrame(frameSize, QImage::Format_ARGB32_Premultiplied);
+                    largeFrame.fill(Qt::transparent);
+
+                    KPixmapModifier::applyFrame(largeFrame, frameSize, devicePixelRatio);
+
+                    QPainter painter(&largeFrame);
+                    painter.drawImage((largeFrame.width()  - scaledPreview.width() / scaledPreview.devicePixelRatio()) / 2,
+                                      (largeFrame.height() - scaledPreview.height() / scaledPreview.devicePixelRatio()) / 2,
+                                      scaledPreview);
+                    painter.end();
+                    scaledPreview = largeFrame;
+                } else {
+                    // The image must be shrinked as it is too large to fit into
+                    // the available icon size
+                    KPixmapModifier::applyFrame(scaledPreview, iconSize, devicePixelRatio);
+                }
+            }
+        } else {
+            KPixmapModifier::scale(scaledPreview, iconSize * devicePixelRatio);
+            scaledPreview.setDevicePixelRatio(devicePixelRatio);
+        }
+
+        return scaledPreview;
+    }
+
+    // Scales and frames the previews in worker threads, see startFramingPreviews().
+    struct PreviewFramer
+    {
+        typedef QImage result_type;
+
+        QImage operator()(const QImage& preview) const
+        {
+            return framedPreview(preview, iconSize, devicePixelRatio, enlargeSmallPreviews);
+        }
+
+        QSize iconSize;
+        qreal devicePixelRatio;
+        bool enlargeSmallPreviews;
+    };
 }
 
 KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QObject* parent) :
@@ -70,7 +164,6 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_previewShown(false),
     m_enlargeSmallPreviews(true),
     m_clearPreviews(false),
-    m_finishedItems(),
     m_model(model),
     m_iconSize(),
     m_firstVisibleIndex(0),
@@ -79,14 +172,24 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_roles(),
     m_resolvableRoles(),
     m_enabledPlugins(),
-    m_pendingSortRoleItems(),
+    m_sortRoleResolveIndex(0),
     m_pendingIndexes(),
     m_pendingPreviewItems(),
-    m_previewJob(),
+    m_previewJobs(),
+    m_maximumPreviewJobs(qBound(1, QThread::idealThreadCount() / 2, MaxPreviewJobs)),
+    m_visibleRangeTimer(),
+    m_visibleRangeLatency(-1),
+    m_previewCache(nullptr),
+    m_previewItemsToFrame(),
+    m_previewsToFrame(),
+    m_previewItemsBeingFramed(),
+    m_framingWatcher(nullptr),
     m_recentlyChangedItemsTimer(nullptr),
-    m_recentlyChangedItems(),
-    m_changedItems(),
-    m_directoryContentsCounter(nullptr)
+    m_pendingItemValues(),
+    m_pendingItemValuesTimer(nullptr),
+    m_directoryContentsCounter(nullptr),
+    m_mimeTypeResolver(nullptr),
+    m_resolvingHint(ResolveFast)
   #ifdef HAVE_BALOO
   , m_balooFileMonitor(nullptr)
   #endif
@@ -114,6 +217,14 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_recentlyChangedItemsTimer->setSingleShot(true);
     connect(m_recentlyChangedItemsTimer, &QTimer::timeout, this, &KFileItemModelRolesUpdater::resolveRecentlyChangedItems);
 
+    m_pendingItemValuesTimer = new QTimer(this);
+    m_pendingItemValuesTimer->setInterval(PendingItemValuesInterval);
+    m_pendingItemValuesTimer->setSingleShot(true);
+    connect(m_pendingItemValuesTimer, &QTimer::timeout, this, &KFileItemModelRolesUpdater::applyPendingItemValues);
+
+    // The pending values do not need to be applied anymore if the model is destroyed.
+    connect(m_model, &QObject::destroyed, m_pendingItemValuesTimer, &QTimer::stop);
+
     m_resolvableRoles.insert("size");
     m_resolvableRoles.insert("type");
     m_resolvableRoles.insert("isExpandable");
@@ -121,9 +232,21 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
     m_resolvableRoles += KBalooRolesProvider::instance().roles();
 #endif
 
+    m_previewCache = new KPreviewCache(this);
+
+    m_framingWatcher = new QFutureWatcher<QImage>(this);
+    connect(m_framingWatcher, &QFutureWatcher<QImage>::finished,
+            this,             &KFileItemModelRolesUpdater::slotPreviewsFramed);
+
+    m_mimeTypeResolver = new KMimeTypeResolver(this);
+    connect(m_mimeTypeResolver, &KMimeTypeResolver::mimeTypesResolved,
+            this,               &KFileItemModelRolesUpdater::slotMimeTypesResolved);
+
     m_directoryContentsCounter = new KDirectoryContentsCounter(m_model, this);
     connect(m_directoryContentsCounter, &KDirectoryContentsCounter::result,
             this,                       &KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived);
+    connect(m_directoryContentsCounter, &KDirectoryContentsCounter::sizeProgress,
+            this,                       &KFileItemModelRolesUpdater::slotDirectorySizeProgress);
 
     auto plugins = KPluginLoader::instantiatePlugins(QStringLiteral("kf5/overlayicon"), nullptr, qApp);
     foreach (QObject *it, plugins) {
@@ -140,7 +263,12 @@ KFileItemModelRolesUpdater::KFileItemModelRolesUpdater(KFileItemModel* model, QO
 
 KFileItemModelRolesUpdater::~KFileItemModelRolesUpdater()
 {
-    killPreviewJob();
+    killPreviewJobs();
+
+    if (m_pendingItemValuesTimer->isActive()) {
+        m_pendingItemValuesTimer->stop();
+        applyPendingItemValues();
+    }
 }
 
 void KFileItemModelRolesUpdater::setIconSize(const QSize& size)
@@ -152,7 +280,8 @@ void KFileItemModelRolesUpdater::setIconSize(const QSize& size)
         } else if (m_previewShown) {
             // An icon size change requires the regenerating of
             // all previews
-            m_finishedItems.clear();
+            killPreviewJobs();
+            m_model->resetItemFlag(KFileItemModel::FinishedFlag);
             startUpdating();
         }
     }
@@ -180,6 +309,9 @@ void KFileItemModelRolesUpdater::setVisibleIndexRange(int index, int count)
     m_firstVisibleIndex = index;
     m_lastVisibleIndex = qMin(index + count - 1, m_model->count() - 1);
 
+    m_visibleRangeTimer.start();
+    m_visibleRangeLatency = -1;
+
     startUpdating();
 }
 
@@ -222,6 +354,56 @@ bool KFileItemModelRolesUpdater::enlargeSmallPreviews() const
     return m_enlargeSmallPreviews;
 }
 
+void KFileItemModelRolesUpdater::setDirectoryContentsSizeShown(bool show)
+{
+    if (show == m_directoryContentsCounter->countsRecursiveSize()) {
+        return;
+    }
+
+    m_directoryContentsCounter->setCountRecursiveSize(show);
+
+    // The "size" of all directories must be determined again. The
+    // directories are resolved like changed items, and if the model is
+    // sorted by size, the sizes of all directories are requested.
+    const bool sortBySize = (m_model->sortRole() == "size");
+
+    QVector<KFileItemModel::ItemValues> itemValues;
+    const int count = m_model->count();
+    for (int index = 0; index < count; ++index) {
+        const KFileItem item = m_model->fileItem(index);
+        if (!item.isDir() || !item.isLocalFile()) {
+            continue;
+        }
+
+        m_model->setItemFlag(index, KFileItemModel::FinishedFlag, false);
+
+        KFileItemModel::ItemValues values;
+        values.index = index;
+        values.values.insert("size", QVariant());
+        values.values.insert("contentsSize", QVariant());
+        if (sortBySize) {
+            const KDirectoryContentsCounterWorker::CountResult result = m_directoryContentsCounter->addDirectory(item);
+            if (result.count >= 0) {
+                insertDirectorySize(values.values, result.count, result.size);
+            }
+        }
+        itemValues.append(values);
+    }
+
+    applyItemsData(itemValues);
+
+    if (m_state == Paused) {
+        m_rolesChangedDuringPausing = true;
+    } else {
+        startUpdating();
+    }
+}
+
+bool KFileItemModelRolesUpdater::directoryContentsSizeShown() const
+{
+    return m_directoryContentsCounter->countsRecursiveSize();
+}
+
 void KFileItemModelRolesUpdater::setEnabledPlugins(const QStringList& list)
 {
     if (m_enabledPlugins != list) {
@@ -240,20 +422,20 @@ void KFileItemModelRolesUpdater::setPaused(bool paused)
 
     if (paused) {
         m_state = Paused;
-        killPreviewJob();
+        killPreviewJobs();
     } else {
         const bool updatePreviews = (m_iconSizeChangedDuringPausing && m_previewShown) ||
                                     m_previewChangedDuringPausing;
         const bool resolveAll = updatePreviews || m_rolesChangedDuringPausing;
         if (resolveAll) {
-            m_finishedItems.clear();
+            m_model->resetItemFlag(KFileItemModel::FinishedFlag);
         }
 
         m_iconSizeChangedDuringPausing = false;
         m_previewChangedDuringPausing = false;
         m_rolesChangedDuringPausing = false;
 
-        if (!m_pendingSortRoleItems.isEmpty()) {
+        if (m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag) > 0) {
             m_state = ResolvingSortRole;
             resolveNextSortRole();
         } else {
@@ -318,6 +500,24 @@ QStringList KFileItemModelRolesUpdater::enabledPlugins() const
     return m_enabledPlugins;
 }
 
+int KFileItemModelRolesUpdater::pendingPreviewCount() const
+{
+    int count = m_pendingPreviewItems.count();
+    for (QHash<KJob*, KFileItemList>::const_iterator it = m_previewJobs.constBegin(); it != m_previewJobs.constEnd(); ++it) {
+        foreach (const KFileItem& item, it.value()) {
+            if (!m_model->itemFlag(m_model->index(item), KFileItemModel::FinishedFlag)) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+qint64 KFileItemModelRolesUpdater::visibleRangeLatency() const
+{
+    return m_visibleRangeLatency;
+}
+
 void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRanges)
 {
     QElapsedTimer timer;
@@ -325,26 +525,33 @@ void KFileItemModelRolesUpdater::slotItemsInserted(const KItemRangeList& itemRan
 
     // Determine the sort role synchronously for as many items as possible.
     if (m_resolvableRoles.contains(m_model->sortRole())) {
+        QVector<KFileItemModel::ItemValues> itemValues;
+
         int insertedCount = 0;
         foreach (const KItemRange& range, itemRanges) {
             const int lastIndex = insertedCount + range.index + range.count - 1;
             for (int i = insertedCount + range.index; i <= lastIndex; ++i) {
                 if (timer.elapsed() < MaxBlockTimeout) {
-                    applySortRole(i);
+                    KFileItemModel::ItemValues values;
+                    values.index = i;
+                    values.values = sortRoleData(i);
+                    itemValues.append(values);
                 } else {
-                    m_pendingSortRoleItems.insert(m_model->fileItem(i));
+                    m_model->setItemFlag(i, KFileItemModel::PendingSortRoleFlag, true);
                 }
             }
             insertedCount += range.count;
         }
 
+        applyItemsData(itemValues);
+
         applySortProgressToModel();
 
         // If there are still items whose sort role is unknown, check if the
         // asynchronous determination of the sort role is already in progress,
         // and start it if that is not the case.
-        if (!m_pendingSortRoleItems.isEmpty() && m_state != ResolvingSortRole) {
-            killPreviewJob();
+        if (m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag) > 0 && m_state != ResolvingSortRole) {
+            killPreviewJobs();
             m_state = ResolvingSortRole;
             resolveNextSortRole();
         }
@@ -376,30 +583,16 @@ void KFileItemModelRolesUpdater::slotItemsRemoved(const KItemRangeList& itemRang
     }
 #endif
 
+    // The model has unset the flags of the removed items already.
     if (allItemsRemoved) {
         m_state = Idle;
 
-        m_finishedItems.clear();
-        m_pendingSortRoleItems.clear();
         m_pendingIndexes.clear();
         m_pendingPreviewItems.clear();
-        m_recentlyChangedItems.clear();
         m_recentlyChangedItemsTimer->stop();
-        m_changedItems.clear();
 
-        killPreviewJob();
+        killPreviewJobs();
     } else {
-        // Only remove the items from m_finishedItems. They will be removed
-        // from the other sets later on.
-        QSet<KFileItem>::iterator it = m_finishedItems.begin();
-        while (it != m_finishedItems.end()) {
-            if (m_model->index(*it) < 0) {
-                it = m_finishedItems.erase(it);
-            } else {
-                ++it;
-            }
-        }
-
         // The visible items might have changed.
         startUpdating();
     }
@@ -424,13 +617,13 @@ void KFileItemModelRolesUpdater::slotItemsChanged(const KItemRangeList& itemRang
     // to prevent expensive repeated updates if files are updated frequently.
     const bool itemsChangedRecently = m_recentlyChangedItemsTimer->isActive();
 
-    QSet<KFileItem>& targetSet = itemsChangedRecently ? m_recentlyChangedItems : m_changedItems;
+    const KFileItemModel::ItemFlag flag = itemsChangedRecently ? KFileItemModel::RecentlyChangedFlag
+                                                               : KFileItemModel::ChangedFlag;
 
     foreach (const KItemRange& itemRange, itemRanges) {
         int index = itemRange.index;
         for (int count = itemRange.count; count > 0; --count) {
-            const KFileItem item = m_model->fileItem(index);
-            targetSet.insert(item);
+            m_model->setItemFlag(index, flag, true);
             ++index;
         }
     }
@@ -449,33 +642,39 @@ void KFileItemModelRolesUpdater::slotSortRoleChanged(const QByteArray& current,
     Q_UNUSED(previous);
 
     if (m_resolvableRoles.contains(current)) {
-        m_pendingSortRoleItems.clear();
-        m_finishedItems.clear();
+        m_model->resetItemFlag(KFileItemModel::PendingSortRoleFlag);
+        m_model->resetItemFlag(KFileItemModel::FinishedFlag);
 
         const int count = m_model->count();
         QElapsedTimer timer;
         timer.start();
 
         // Determine the sort role synchronously for as many items as possible.
+        QVector<KFileItemModel::ItemValues> itemValues;
         for (int index = 0; index < count; ++index) {
             if (timer.elapsed() < MaxBlockTimeout) {
-                applySortRole(index);
+                KFileItemModel::ItemValues values;
+                values.index = index;
+                values.values = sortRoleData(index);
+                itemValues.append(values);
             } else {
-                m_pendingSortRoleItems.insert(m_model->fileItem(index));
+                m_model->setItemFlag(index, KFileItemModel::PendingSortRoleFlag, true);
             }
         }
 
+        applyItemsData(itemValues);
+
         applySortProgressToModel();
 
-        if (!m_pendingSortRoleItems.isEmpty()) {
+        if (m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag) > 0) {
             // Trigger the asynchronous determination of the sort role.
-            killPreviewJob();
+            killPreviewJobs();
             m_state = ResolvingSortRole;
             resolveNextSortRole();
         }
     } else {
         m_state = Idle;
-        m_pendingSortRoleItems.clear();
+        m_model->resetItemFlag(KFileItemModel::PendingSortRoleFlag);
         applySortProgressToModel();
     }
 }
@@ -486,77 +685,65 @@ void KFileItemModelRolesUpdater::slotGotPreview(const KFileItem& item, const QPi
         return;
     }
 
-    m_changedItems.remove(item);
-
     const int index = m_model->index(item);
     if (index < 0) {
         return;
     }
 
-    QPixmap scaledPixmap = pixmap;
+    m_model->setItemFlag(index, KFileItemModel::ChangedFlag, false);
 
-    if (!pixmap.hasAlpha()
-        && m_iconSize.width()  > KIconLoader::SizeSmallMedium
-        && m_iconSize.height() > KIconLoader::SizeSmallMedium) {
-        if (m_enlargeSmallPreviews) {
-            KPixmapModifier::applyFrame(scaledPixmap, m_iconSize);
-        } else {
-            // Assure that small previews don't get enlarged. Instead they
-            // should be shown centered within the frame.
-            const QSize contentSize = KPixmapModifier::sizeInsideFrame(m_iconSize);
-            const bool enlargingRequired = scaledPixmap.width()  < contentSize.width() &&
-                                           scaledPixmap.height() < contentSize.height();
-            if (enlargingRequired) {
-                QSize frameSize = scaledPixmap.size() / scaledPixmap.devicePixelRatio();
-                frameSize.scale(m_iconSize, Qt::KeepAspectRatio);
-
-                QPixmap largeFrame(frameSize);
-                largeFrame.fill(Qt::transparent);
-
-                KPixmapModifier::applyFrame(largeFrame, frameSize);
-
-                QPainter painter(&largeFrame);
-                painter.drawPixmap((largeFrame.width()  - scaledPixmap.width() / scaledPixmap.devicePixelRatio()) / 2,
-                                   (largeFrame.height() - scaledPixmap.height() / scaledPixmap.devicePixelRatio()) / 2,
-                                   scaledPixmap);
-                scaledPixmap = largeFrame;
-            } else {
-                // The image must be shrinked as it is too large to fit into
-                // the available icon size
-                KPixmapModifier::applyFrame(scaledPixmap, m_iconSize);
-            }
-        }
-    } else {
-        KPixmapModifier::scale(scaledPixmap, m_iconSize * qApp->devicePixelRatio());
-        scaledPixmap.setDevicePixelRatio(qApp->devicePixelRatio());
+    // Scaling the preview and applying the frame is done in worker
+    // threads. The previews that arrive in the meantime are collected
+    // and framed together afterwards.
+    m_previewItemsToFrame.append(item);
+    m_previewsToFrame.append(pixmap.toImage());
+
+    if (m_previewItemsBeingFramed.isEmpty()) {
+        startFramingPreviews();
     }
+}
 
-    QHash<QByteArray, QVariant> data = rolesData(item);
+void KFileItemModelRolesUpdater::slotPreviewsFramed()
+{
+    const QList<QImage> previews = m_framingWatcher->future().results();
+    const KFileItemList items = m_previewItemsBeingFramed;
+    m_previewItemsBeingFramed.clear();
+
+    // Keep the worker threads busy while the previews are applied.
+    startFramingPreviews();
+
+    // If the preview jobs have been killed in the meantime, the
+    // items are gone and the previews are outdated.
+    if (previews.count() == items.count()) {
+        QVector<KFileItemModel::ItemValues> itemValues;
+        itemValues.reserve(items.count());
+
+        for (int i = 0; i < items.count(); ++i) {
+            const KFileItem& item = items.at(i);
+            const int index = m_model->index(item);
+            if (index < 0) {
+                continue;
+            }
 
-    const QStringList overlays = data["iconOverlays"].toStringList();
-    // Strangely KFileItem::overlays() returns empty string-values, so
-    // we need to check first whether an overlay must be drawn at all.
-    // It is more efficient to do it here, as KIconLoader::drawOverlays()
-    // assumes that an overlay will be drawn and has some additional
-    // setup time.
-    foreach (const QString& overlay, overlays) {
-        if (!overlay.isEmpty()) {
-            // There is at least one overlay, draw all overlays above m_pixmap
-            // and cancel the check
-            KIconLoader::global()->drawOverlays(overlays, scaledPixmap, KIconLoader::Desktop);
-            break;
+            m_previewCache->insert(item, previews.at(i));
+            const QPixmap pixmap = QPixmap::fromImage(previews.at(i));
+
+            KFileItemModel::ItemValues values;
+            values.index = index;
+            values.values = previewData(item, pixmap);
+            itemValues.append(values);
+
+            m_model->setItemFlag(index, KFileItemModel::FinishedFlag, true);
         }
-    }
 
-    data.insert("iconPixmap", scaledPixmap);
+        applyItemsData(itemValues);
 
-    disconnect(m_model, &KFileItemModel::itemsChanged,
-               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-    m_model->setData(index, data);
-    connect(m_model, &KFileItemModel::itemsChanged,
-            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        updateVisibleRangeLatency();
+    }
 
-    m_finishedItems.insert(item);
+    if (m_state == PreviewJobRunning && m_previewJobs.isEmpty()) {
+        slotPreviewJobFinished(nullptr);
+    }
 }
 
 void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
@@ -565,38 +752,35 @@ void KFileItemModelRolesUpdater::slotPreviewFailed(const KFileItem& item)
         return;
     }
 
-    m_changedItems.remove(item);
-
     const int index = m_model->index(item);
     if (index >= 0) {
+        m_model->setItemFlag(index, KFileItemModel::ChangedFlag, false);
+
         QHash<QByteArray, QVariant> data;
         data.insert("iconPixmap", QPixmap());
 
-        disconnect(m_model, &KFileItemModel::itemsChanged,
-                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-        m_model->setData(index, data);
-        connect(m_model, &KFileItemModel::itemsChanged,
-                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+        applyData(index, data);
 
         applyResolvedRoles(index, ResolveAll);
-        m_finishedItems.insert(item);
+        m_model->setItemFlag(index, KFileItemModel::FinishedFlag, true);
+        updateVisibleRangeLatency();
     }
 }
 
-void KFileItemModelRolesUpdater::slotPreviewJobFinished()
+void KFileItemModelRolesUpdater::slotPreviewJobFinished(KJob* job)
 {
-    m_previewJob = nullptr;
+    m_previewJobs.remove(job);
 
     if (m_state != PreviewJobRunning) {
         return;
     }
 
-    m_state = Idle;
-
     if (!m_pendingPreviewItems.isEmpty()) {
-        startPreviewJob();
-    } else {
-        if (!m_changedItems.isEmpty()) {
+        startPreviewJobs();
+    } else if (m_previewJobs.isEmpty() && !isFramingPreviews()) {
+        m_state = Idle;
+        m_previewCache->flush();
+        if (m_model->itemFlagCount(KFileItemModel::ChangedFlag) > 0) {
             updateChangedItems();
         }
     }
@@ -604,28 +788,66 @@ void KFileItemModelRolesUpdater::slotPreviewJobFinished()
 
 void KFileItemModelRolesUpdater::resolveNextSortRole()
 {
-    if (m_state != ResolvingSortRole) {
+    if (m_state != ResolvingSortRole || m_mimeTypeResolver->isResolving()) {
         return;
     }
 
-    QSet<KFileItem>::iterator it = m_pendingSortRoleItems.begin();
-    while (it != m_pendingSortRoleItems.end()) {
-        const KFileItem item = *it;
-        const int index = m_model->index(item);
+    // Resolve the sort roles of as many items as possible within
+    // ResolveSliceTimeout, and apply them to the model at once. The MIME
+    // types of local items are determined in worker threads.
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool resolveTypeInThread = (m_model->sortRole() == "type");
+    QVector<KFileItemModel::ItemValues> itemValues;
+    KFileItemList itemsToResolveInThread;
+
+    // The pending items are searched starting behind the last resolved item.
+    // The search wraps around, as the items might have been moved in the meantime.
+    const int count = m_model->count();
+    for (int searchedCount = 0;
+         searchedCount < count
+         && m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag) > 0
+         && timer.elapsed() < ResolveSliceTimeout
+         && itemsToResolveInThread.count() < ResolveInThreadChunkSize;
+         ++searchedCount) {
+        if (m_sortRoleResolveIndex >= count) {
+            m_sortRoleResolveIndex = 0;
+        }
+        const int index = m_sortRoleResolveIndex++;
+        if (!m_model->itemFlag(index, KFileItemModel::PendingSortRoleFlag)) {
+            continue;
+        }
+        m_model->setItemFlag(index, KFileItemModel::PendingSortRoleFlag, false);
 
         // Continue if the sort role has already been determined for the
         // item, and the item has not been changed recently.
-        if (!m_changedItems.contains(item) && m_model->data(index).contains(m_model->sortRole())) {
-            it = m_pendingSortRoleItems.erase(it);
+        if (!m_model->itemFlag(index, KFileItemModel::ChangedFlag) && m_model->data(index).contains(m_model->sortRole())) {
             continue;
         }
 
-        applySortRole(index);
-        m_pendingSortRoleItems.erase(it);
-        break;
+        const KFileItem item = m_model->fileItem(index);
+        if (resolveTypeInThread && KMimeTypeResolver::canResolve(item)) {
+            itemsToResolveInThread.append(item);
+        } else {
+            KFileItemModel::ItemValues values;
+            values.index = index;
+            values.values = sortRoleData(index);
+            itemValues.append(values);
+        }
+    }
+
+    applyItemsData(itemValues);
+
+    if (!itemsToResolveInThread.isEmpty()) {
+        // slotMimeTypesResolved() continues with the remaining items.
+        applySortProgressToModel();
+        m_resolvingHint = ResolveFast;
+        m_mimeTypeResolver->resolve(itemsToResolveInThread);
+        return;
     }
 
-    if (!m_pendingSortRoleItems.isEmpty()) {
+    if (m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag) > 0) {
         applySortProgressToModel();
         QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextSortRole);
     } else {
@@ -643,50 +865,77 @@ void KFileItemModelRolesUpdater::resolveNextSortRole()
 
 void KFileItemModelRolesUpdater::resolveNextPendingRoles()
 {
-    if (m_state != ResolvingAllRoles) {
+    if (m_state != ResolvingAllRoles || m_mimeTypeResolver->isResolving()) {
         return;
     }
 
-    while (!m_pendingIndexes.isEmpty()) {
+    // Resolve the roles of as many items as possible within
+    // ResolveSliceTimeout, and apply them to the model at once. The MIME
+    // types of local items are determined in worker threads.
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<KFileItemModel::ItemValues> itemValues;
+    KFileItemList itemsToResolveInThread;
+
+    while (!m_pendingIndexes.isEmpty()
+           && timer.elapsed() < ResolveSliceTimeout
+           && itemsToResolveInThread.count() < ResolveInThreadChunkSize) {
         const int index = m_pendingIndexes.takeFirst();
         const KFileItem item = m_model->fileItem(index);
 
-        if (m_finishedItems.contains(item)) {
+        if (item.isNull() || m_model->itemFlag(index, KFileItemModel::FinishedFlag)) {
             continue;
         }
 
-        applyResolvedRoles(index, ResolveAll);
-        m_finishedItems.insert(item);
-        m_changedItems.remove(item);
-        break;
+        if (KMimeTypeResolver::canResolve(item)) {
+            itemsToResolveInThread.append(item);
+        } else {
+            KFileItemModel::ItemValues values;
+            values.index = index;
+            if (resolveRoles(index, ResolveAll, values.values)) {
+                itemValues.append(values);
+            }
+        }
+        m_model->setItemFlag(index, KFileItemModel::FinishedFlag, true);
+        m_model->setItemFlag(index, KFileItemModel::ChangedFlag, false);
+    }
+
+    applyItemsData(itemValues);
+
+    if (!itemsToResolveInThread.isEmpty()) {
+        // slotMimeTypesResolved() continues with the remaining items.
+        m_resolvingHint = ResolveAll;
+        m_mimeTypeResolver->resolve(itemsToResolveInThread);
+        return;
     }
 
+    updateVisibleRangeLatency();
+
     if (!m_pendingIndexes.isEmpty()) {
         QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextPendingRoles);
     } else {
         m_state = Idle;
 
         if (m_clearPreviews) {
+            // Previews that have not been applied yet must be cleared as well.
+            applyPendingItemValues();
+
             // Only go through the list if there are items which might still have previews.
-            if (m_finishedItems.count() != m_model->count()) {
+            if (m_model->itemFlagCount(KFileItemModel::FinishedFlag) != m_model->count()) {
                 QHash<QByteArray, QVariant> data;
                 data.insert("iconPixmap", QPixmap());
 
-                disconnect(m_model, &KFileItemModel::itemsChanged,
-                           this,    &KFileItemModelRolesUpdater::slotItemsChanged);
                 for (int index = 0; index <= m_model->count(); ++index) {
                     if (m_model->data(index).contains("iconPixmap")) {
-                        m_model->setData(index, data);
+                        applyData(index, data);
                     }
                 }
-                connect(m_model, &KFileItemModel::itemsChanged,
-                        this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-
             }
             m_clearPreviews = false;
         }
 
-        if (!m_changedItems.isEmpty()) {
+        if (m_model->itemFlagCount(KFileItemModel::ChangedFlag) > 0) {
             updateChangedItems();
         }
     }
@@ -694,11 +943,66 @@ void KFileItemModelRolesUpdater::resolveNextPendingRoles()
 
 void KFileItemModelRolesUpdater::resolveRecentlyChangedItems()
 {
-    m_changedItems += m_recentlyChangedItems;
-    m_recentlyChangedItems.clear();
+    if (m_model->itemFlagCount(KFileItemModel::RecentlyChangedFlag) > 0) {
+        const int count = m_model->count();
+        for (int index = 0; index < count; ++index) {
+            if (m_model->itemFlag(index, KFileItemModel::RecentlyChangedFlag)) {
+                m_model->setItemFlag(index, KFileItemModel::RecentlyChangedFlag, false);
+                m_model->setItemFlag(index, KFileItemModel::ChangedFlag, true);
+            }
+        }
+    }
     updateChangedItems();
 }
 
+void KFileItemModelRolesUpdater::slotMimeTypesResolved(const QHash<QUrl, KFileItem>& items)
+{
+    QVector<KFileItemModel::ItemValues> itemValues;
+    itemValues.reserve(items.count());
+
+    QHash<QUrl, KFileItem>::const_iterator it = items.constBegin();
+    for (; it != items.constEnd(); ++it) {
+        const KFileItem& resolvedItem = it.value();
+        const int index = m_model->index(it.key());
+        if (index < 0 || !m_model->fileItem(index).cmp(resolvedItem)) {
+            // The item has been removed or refreshed in the meantime. Refreshed
+            // items are resolved again after slotItemsChanged() has been invoked.
+            continue;
+        }
+
+        KFileItemModel::ItemValues values;
+        values.index = index;
+        values.item = resolvedItem;
+        if (m_resolvingHint == ResolveAll) {
+            values.values = rolesData(resolvedItem);
+            if (m_clearPreviews) {
+                values.values.insert("iconPixmap", QPixmap());
+            }
+        } else if (m_model->sortRole() == "type") {
+            values.values.insert("type", resolvedItem.mimeComment());
+        }
+        values.values.insert("iconName", resolvedItem.iconName());
+        itemValues.append(values);
+    }
+
+    applyItemsData(itemValues);
+
+    if (m_resolvingHint == ResolveAll) {
+        updateVisibleRangeLatency();
+    }
+
+    if (m_mimeTypeResolver->isResolving()) {
+        // Wait for the remaining batches.
+        return;
+    }
+
+    if (m_state == ResolvingSortRole) {
+        resolveNextSortRole();
+    } else if (m_state == ResolvingAllRoles) {
+        resolveNextPendingRoles();
+    }
+}
+
 void KFileItemModelRolesUpdater::applyChangedBalooRoles(const QString& file)
 {
 #ifdef HAVE_BALOO
@@ -735,12 +1039,7 @@ void KFileItemModelRolesUpdater::applyChangedBalooRolesForItem(const KFileItem &
         data.insert(it.key(), it.value());
     }
 
-    disconnect(m_model, &KFileItemModel::itemsChanged,
-               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-    const int index = m_model->index(item);
-    m_model->setData(index, data);
-    connect(m_model, &KFileItemModel::itemsChanged,
-            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    applyData(m_model->index(item), data);
 #else
 #ifndef Q_CC_MSVC
     Q_UNUSED(item);
@@ -748,9 +1047,9 @@ void KFileItemModelRolesUpdater::applyChangedBalooRolesForItem(const KFileItem &
 #endif
 }
 
-void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QString& path, int count)
+void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QString& path, int count, qint64 size)
 {
-    const bool getSizeRole = m_roles.contains("size");
+    const bool getSizeRole = m_roles.contains("size") || m_model->sortRole() == "size";
     const bool getIsExpandableRole = m_roles.contains("isExpandable");
 
     if (getSizeRole || getIsExpandableRole) {
@@ -759,35 +1058,52 @@ void KFileItemModelRolesUpdater::slotDirectoryContentsCountReceived(const QStrin
             QHash<QByteArray, QVariant> data;
 
             if (getSizeRole) {
-                data.insert("size", count);
+                insertDirectorySize(data, count, size);
             }
             if (getIsExpandableRole) {
                 data.insert("isExpandable", count > 0);
             }
 
-            disconnect(m_model, &KFileItemModel::itemsChanged,
-                       this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-            m_model->setData(index, data);
-            connect(m_model, &KFileItemModel::itemsChanged,
-                    this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+            applyData(index, data);
         }
     }
 }
 
+void KFileItemModelRolesUpdater::slotDirectorySizeProgress(const QString& path, qint64 size)
+{
+    if (!m_roles.contains("size") && m_model->sortRole() != "size") {
+        return;
+    }
+
+    const int index = m_model->index(QUrl::fromLocalFile(path));
+    if (index >= 0) {
+        QHash<QByteArray, QVariant> data;
+        data.insert("contentsSize", QVariant::fromValue<KIO::filesize_t>(size));
+
+        applyData(index, data);
+    }
+}
+
 void KFileItemModelRolesUpdater::startUpdating()
 {
     if (m_state == Paused) {
         return;
     }
 
-    if (m_finishedItems.count() == m_model->count()) {
+    if (m_model->itemFlagCount(KFileItemModel::FinishedFlag) == m_model->count()) {
         // All roles have been resolved already.
         m_state = Idle;
         return;
     }
 
-    // Terminate all updates that are currently active.
-    killPreviewJob();
+    // Terminate all updates that are currently active. Preview jobs that
+    // create previews for visible items are kept, as killing them would
+    // delay the previews that the user is waiting for.
+    if (m_previewShown && m_state == PreviewJobRunning) {
+        killInvisiblePreviewJobs();
+    } else {
+        killPreviewJobs();
+    }
     m_pendingIndexes.clear();
 
     QElapsedTimer timer;
@@ -806,17 +1122,33 @@ void KFileItemModelRolesUpdater::startUpdating()
     QList<int> indexes = indexesToResolve();
 
     if (m_previewShown) {
+        m_previewCache->load(m_model->directory(), previewCacheConfiguration());
+
+        QSet<KFileItem> itemsInPreviewJobs;
+        for (QHash<KJob*, KFileItemList>::const_iterator it = m_previewJobs.constBegin(); it != m_previewJobs.constEnd(); ++it) {
+            foreach (const KFileItem& item, it.value()) {
+                itemsInPreviewJobs.insert(item);
+            }
+        }
+        foreach (const KFileItem& item, m_previewItemsToFrame + m_previewItemsBeingFramed) {
+            itemsInPreviewJobs.insert(item);
+        }
+
+        // The items are ordered by their priority: visible items first.
         m_pendingPreviewItems.clear();
         m_pendingPreviewItems.reserve(indexes.count());
 
         foreach (int index, indexes) {
+            if (m_model->itemFlag(index, KFileItemModel::FinishedFlag)) {
+                continue;
+            }
             const KFileItem item = m_model->fileItem(index);
-            if (!m_finishedItems.contains(item)) {
+            if (!itemsInPreviewJobs.contains(item)) {
                 m_pendingPreviewItems.append(item);
             }
         }
 
-        startPreviewJob();
+        startPreviewJobs();
     } else {
         m_pendingIndexes = indexes;
         // Trigger the asynchronous resolving of all roles.
@@ -841,25 +1173,53 @@ void KFileItemModelRolesUpdater::updateVisibleIcons()
     timer.start();
 
     // Try to determine the final icons for all visible items.
+    QVector<KFileItemModel::ItemValues> itemValues;
     int index;
     for (index = m_firstVisibleIndex; index <= lastVisibleIndex && timer.elapsed() < MaxBlockTimeout; ++index) {
-        applyResolvedRoles(index, ResolveFast);
+        KFileItemModel::ItemValues values;
+        values.index = index;
+        if (resolveRoles(index, ResolveFast, values.values)) {
+            itemValues.append(values);
+        }
     }
 
+    applyItemsData(itemValues);
+
     // KFileItemListView::initializeItemListWidget(KItemListWidget*) will load
     // preliminary icons (i.e., without mime type determination) for the
     // remaining items.
 }
 
-void KFileItemModelRolesUpdater::startPreviewJob()
+void KFileItemModelRolesUpdater::startPreviewJobs()
 {
     m_state = PreviewJobRunning;
 
-    if (m_pendingPreviewItems.isEmpty()) {
-        QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
-        return;
+    // Previews that have been created when the directory was shown
+    // before are taken from the cache.
+    applyCachedPreviews();
+
+    // The MIME types of the items are determined with one time budget
+    // for all jobs, so that starting several jobs does not block for a
+    // multiple of MaxBlockTimeout ms. If the budget is exceeded, the
+    // remaining jobs are started when a running job has finished.
+    QElapsedTimer timer;
+    timer.start();
+
+    while (!m_pendingPreviewItems.isEmpty() && m_previewJobs.count() < m_maximumPreviewJobs) {
+        const int remainingTime = MaxBlockTimeout - static_cast<int>(timer.elapsed());
+        if (remainingTime <= 0 && !m_previewJobs.isEmpty() && !m_pendingPreviewItems.first().isMimeTypeKnown()) {
+            break;
+        }
+        startPreviewJob(qMax(0, remainingTime));
     }
 
+    if (m_previewJobs.isEmpty()) {
+        QTimer::singleShot(0, this, [this]() { slotPreviewJobFinished(nullptr); });
+    }
+}
+
+void KFileItemModelRolesUpdater::startPreviewJob(int mimeTypeTimeout)
+{
     // PreviewJob internally caches items always with the size of
     // 128 x 128 pixels or 256 x 256 pixels. A (slow) downscaling is done
     // by PreviewJob if a smaller size is requested. For images KFileItemModelRolesUpdater must
@@ -868,34 +1228,29 @@ void KFileItemModelRolesUpdater::startPreviewJob()
     const QSize cacheSize = (m_iconSize.width() > 128) || (m_iconSize.height() > 128)
                              ? QSize(256, 256) : QSize(128, 128);
 
+    // The visible items are distributed among the concurrent preview jobs.
+    const int chunkSize = qMax(MinPreviewJobChunkSize,
+                               (m_maximumVisibleItems + m_maximumPreviewJobs - 1) / m_maximumPreviewJobs);
+
     // KIO::filePreview() will request the MIME-type of all passed items, which (in the
     // worst case) might block the application for several seconds. To prevent such
     // a blocking, we only pass items with known mime type to the preview job.
-    const int count = m_pendingPreviewItems.count();
     KFileItemList itemSubSet;
-    itemSubSet.reserve(count);
-
-    if (m_pendingPreviewItems.first().isMimeTypeKnown()) {
-        // Some mime types are known already, probably because they were
-        // determined when loading the icons for the visible items. Start
-        // a preview job for all items at the beginning of the list which
-        // have a known mime type.
-        do {
-            itemSubSet.append(m_pendingPreviewItems.takeFirst());
-        } while (!m_pendingPreviewItems.isEmpty() && m_pendingPreviewItems.first().isMimeTypeKnown());
-    } else {
-        // Determine mime types for MaxBlockTimeout ms, and start a preview
-        // job for the corresponding items.
-        QElapsedTimer timer;
-        timer.start();
+    itemSubSet.reserve(chunkSize);
 
-        do {
-            const KFileItem item = m_pendingPreviewItems.takeFirst();
-            item.determineMimeType();
-            itemSubSet.append(item);
-        } while (!m_pendingPreviewItems.isEmpty() && timer.elapsed() < MaxBlockTimeout);
+    if (!m_pendingPreviewItems.first().isMimeTypeKnown()) {
+        // Determine the mime types of the next chunk in parallel for at most
+        // mimeTypeTimeout ms. Afterwards, a preview job is started for the
+        // items at the beginning of the list which have a known mime type.
+        KMimeTypeResolver::determineMimeTypes(m_pendingPreviewItems.mid(0, chunkSize), mimeTypeTimeout);
     }
 
+    do {
+        itemSubSet.append(m_pendingPreviewItems.takeFirst());
+    } while (!m_pendingPreviewItems.isEmpty()
+             && m_pendingPreviewItems.first().isMimeTypeKnown()
+             && itemSubSet.count() < chunkSize);
+
     KIO::PreviewJob* job = new KIO::PreviewJob(itemSubSet, cacheSize, &m_enabledPlugins);
 
     job->setIgnoreMaximumSize(itemSubSet.first().isLocalFile());
@@ -910,54 +1265,152 @@ void KFileItemModelRolesUpdater::startPreviewJob()
     connect(job,  &KIO::PreviewJob::finished,
             this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
 
-    m_previewJob = job;
+    m_previewJobs.insert(job, itemSubSet);
 }
 
-void KFileItemModelRolesUpdater::updateChangedItems()
+void KFileItemModelRolesUpdater::startFramingPreviews()
 {
-    if (m_state == Paused) {
+    if (m_previewItemsToFrame.isEmpty()) {
         return;
     }
 
-    if (m_changedItems.isEmpty()) {
-        return;
+    m_previewItemsBeingFramed = m_previewItemsToFrame;
+    m_previewItemsToFrame.clear();
+
+    const QList<QImage> previews = m_previewsToFrame;
+    m_previewsToFrame.clear();
+
+    PreviewFramer framer;
+    framer.iconSize = m_iconSize;
+    framer.devicePixelRatio = qApp->devicePixelRatio();
+    framer.enlargeSmallPreviews = m_enlargeSmallPreviews;
+
+    m_framingWatcher->setFuture(QtConcurrent::mapped(previews, framer));
+}
+
+bool KFileItemModelRolesUpdater::isFramingPreviews() const
+{
+    return !m_previewItemsBeingFramed.isEmpty() || !m_previewItemsToFrame.isEmpty();
+}
+
+void KFileItemModelRolesUpdater::applyCachedPreviews()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<KFileItemModel::ItemValues> itemValues;
+    KFileItemList remainingItems;
+    remainingItems.reserve(m_pendingPreviewItems.count());
+
+    foreach (const KFileItem& item, m_pendingPreviewItems) {
+        QPixmap pixmap;
+        if (timer.elapsed() < MaxBlockTimeout) {
+            pixmap = m_previewCache->preview(item);
+        }
+
+        const int index = pixmap.isNull() ? -1 : m_model->index(item);
+        if (index < 0) {
+            remainingItems.append(item);
+            continue;
+        }
+
+        KFileItemModel::ItemValues values;
+        values.index = index;
+        values.values = previewData(item, pixmap);
+        itemValues.append(values);
+
+        m_model->setItemFlag(index, KFileItemModel::ChangedFlag, false);
+        m_model->setItemFlag(index, KFileItemModel::FinishedFlag, true);
     }
 
-    m_finishedItems -= m_changedItems;
+    m_pendingPreviewItems = remainingItems;
 
-    if (m_resolvableRoles.contains(m_model->sortRole())) {
-        m_pendingSortRoleItems += m_changedItems;
+    if (!itemValues.isEmpty()) {
+        applyItemsData(itemValues);
 
-        if (m_state != ResolvingSortRole) {
-            // Stop the preview job if necessary, and trigger the
-            // asynchronous determination of the sort role.
-            killPreviewJob();
-            m_state = ResolvingSortRole;
-            QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextSortRole);
+        updateVisibleRangeLatency();
+    }
+}
+
+QHash<QByteArray, QVariant> KFileItemModelRolesUpdater::previewData(const KFileItem& item, const QPixmap& pixmap)
+{
+    QHash<QByteArray, QVariant> data = rolesData(item);
+
+    QPixmap previewPixmap = pixmap;
+    const QStringList overlays = data["iconOverlays"].toStringList();
+    // Strangely KFileItem::overlays() returns empty string-values, so
+    // we need to check first whether an overlay must be drawn at all.
+    // It is more efficient to do it here, as KIconLoader::drawOverlays()
+    // assumes that an overlay will be drawn and has some additional
+    // setup time.
+    foreach (const QString& overlay, overlays) {
+        if (!overlay.isEmpty()) {
+            // There is at least one overlay, draw all overlays above m_pixmap
+            // and cancel the check
+            KIconLoader::global()->drawOverlays(overlays, previewPixmap, KIconLoader::Desktop);
+            break;
         }
+    }
+
+    data.insert("iconPixmap", previewPixmap);
+    return data;
+}
 
+QByteArray KFileItemModelRolesUpdater::previewCacheConfiguration() const
+{
+    QByteArray configuration;
+    QDataStream stream(&configuration, QIODevice::WriteOnly);
+    stream << m_iconSize
+           << qApp->devicePixelRatio()
+           << m_enlargeSmallPreviews
+           << m_enabledPlugins;
+    return configuration;
+}
+
+void KFileItemModelRolesUpdater::updateChangedItems()
+{
+    if (m_state == Paused) {
         return;
     }
 
+    if (m_model->itemFlagCount(KFileItemModel::ChangedFlag) == 0) {
+        return;
+    }
+
+    const bool resolveSortRole = m_resolvableRoles.contains(m_model->sortRole());
+
+    // The changed indexes are collected in ascending order.
     QList<int> visibleChangedIndexes;
     QList<int> invisibleChangedIndexes;
 
-    foreach (const KFileItem& item, m_changedItems) {
-        const int index = m_model->index(item);
-
-        if (index < 0) {
-            m_changedItems.remove(item);
+    const int count = m_model->count();
+    for (int index = 0; index < count; ++index) {
+        if (!m_model->itemFlag(index, KFileItemModel::ChangedFlag)) {
             continue;
         }
 
-        if (index >= m_firstVisibleIndex && index <= m_lastVisibleIndex) {
+        m_model->setItemFlag(index, KFileItemModel::FinishedFlag, false);
+
+        if (resolveSortRole) {
+            m_model->setItemFlag(index, KFileItemModel::PendingSortRoleFlag, true);
+        } else if (index >= m_firstVisibleIndex && index <= m_lastVisibleIndex) {
             visibleChangedIndexes.append(index);
         } else {
             invisibleChangedIndexes.append(index);
         }
     }
 
-    std::sort(visibleChangedIndexes.begin(), visibleChangedIndexes.end());
+    if (resolveSortRole) {
+        if (m_state != ResolvingSortRole) {
+            // Stop the preview jobs if necessary, and trigger the
+            // asynchronous determination of the sort role.
+            killPreviewJobs();
+            m_state = ResolvingSortRole;
+            QTimer::singleShot(0, this, &KFileItemModelRolesUpdater::resolveNextSortRole);
+        }
+
+        return;
+    }
 
     if (m_previewShown) {
         foreach (int index, visibleChangedIndexes) {
@@ -968,9 +1421,7 @@ void KFileItemModelRolesUpdater::updateChangedItems()
             m_pendingPreviewItems.append(m_model->fileItem(index));
         }
 
-        if (!m_previewJob) {
-            startPreviewJob();
-        }
+        startPreviewJobs();
     } else {
         const bool resolvingInProgress = !m_pendingIndexes.isEmpty();
         m_pendingIndexes = visibleChangedIndexes + m_pendingIndexes + invisibleChangedIndexes;
@@ -982,7 +1433,7 @@ void KFileItemModelRolesUpdater::updateChangedItems()
     }
 }
 
-void KFileItemModelRolesUpdater::applySortRole(int index)
+QHash<QByteArray, QVariant> KFileItemModelRolesUpdater::sortRoleData(int index)
 {
     QHash<QByteArray, QVariant> data;
     const KFileItem item = m_model->fileItem(index);
@@ -994,29 +1445,108 @@ void KFileItemModelRolesUpdater::applySortRole(int index)
 
         data.insert("type", item.mimeComment());
     } else if (m_model->sortRole() == "size" && item.isLocalFile() && item.isDir()) {
-        const QString path = item.localPath();
-        data.insert("size", m_directoryContentsCounter->countDirectoryContentsSynchronously(path));
+        // If the number of items is not cached yet, it is counted in a worker
+        // thread and set in slotDirectoryContentsCountReceived().
+        const KDirectoryContentsCounterWorker::CountResult result = m_directoryContentsCounter->addDirectory(item);
+        if (result.count >= 0) {
+            insertDirectorySize(data, result.count, result.size);
+        }
     } else {
         // Probably the sort role is a baloo role - just determine all roles.
         data = rolesData(item);
     }
 
-    disconnect(m_model, &KFileItemModel::itemsChanged,
-               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-    m_model->setData(index, data);
-    connect(m_model, &KFileItemModel::itemsChanged,
-            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    return data;
 }
 
 void KFileItemModelRolesUpdater::applySortProgressToModel()
 {
     // Inform the model about the progress of the resolved items,
     // so that it can give an indication when the sorting has been finished.
-    const int resolvedCount = m_model->count() - m_pendingSortRoleItems.count();
+    const int resolvedCount = m_model->count() - m_model->itemFlagCount(KFileItemModel::PendingSortRoleFlag);
     m_model->emitSortProgress(resolvedCount);
 }
 
+void KFileItemModelRolesUpdater::applyData(int index, const QHash<QByteArray, QVariant>& data)
+{
+    const KFileItem item = m_model->fileItem(index);
+    if (item.isNull()) {
+        return;
+    }
+
+    KFileItemModel::ItemValues& pendingValues = m_pendingItemValues[item.url()];
+    for (QHash<QByteArray, QVariant>::const_iterator it = data.constBegin(); it != data.constEnd(); ++it) {
+        pendingValues.values.insert(it.key(), it.value());
+    }
+
+    if (!m_pendingItemValuesTimer->isActive()) {
+        m_pendingItemValuesTimer->start();
+    }
+}
+
+void KFileItemModelRolesUpdater::applyItemsData(const QVector<KFileItemModel::ItemValues>& itemValues)
+{
+    foreach (const KFileItemModel::ItemValues& values, itemValues) {
+        const KFileItem item = values.item.isNull() ? m_model->fileItem(values.index) : values.item;
+        if (item.isNull()) {
+            continue;
+        }
+
+        KFileItemModel::ItemValues& pendingValues = m_pendingItemValues[item.url()];
+        for (QHash<QByteArray, QVariant>::const_iterator it = values.values.constBegin(); it != values.values.constEnd(); ++it) {
+            pendingValues.values.insert(it.key(), it.value());
+        }
+        if (!values.item.isNull()) {
+            pendingValues.item = values.item;
+        }
+    }
+
+    if (!m_pendingItemValues.isEmpty() && !m_pendingItemValuesTimer->isActive()) {
+        m_pendingItemValuesTimer->start();
+    }
+}
+
+void KFileItemModelRolesUpdater::applyPendingItemValues()
+{
+    // The items are looked up by their URL, as they might have been
+    // moved or removed since their values have been resolved.
+    QVector<KFileItemModel::ItemValues> itemValues;
+    itemValues.reserve(m_pendingItemValues.count());
+    for (QHash<QUrl, KFileItemModel::ItemValues>::const_iterator it = m_pendingItemValues.constBegin(); it != m_pendingItemValues.constEnd(); ++it) {
+        const int index = m_model->index(it.key());
+        if (index >= 0) {
+            KFileItemModel::ItemValues values = it.value();
+            values.index = index;
+            itemValues.append(values);
+        }
+    }
+    m_pendingItemValues.clear();
+
+    if (itemValues.isEmpty()) {
+        return;
+    }
+
+    // The changes have been done by KFileItemModelRolesUpdater and
+    // must not be resolved again by slotItemsChanged().
+    disconnect(m_model, &KFileItemModel::itemsChanged,
+               this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+    m_model->setItemsData(itemValues);
+    connect(m_model, &KFileItemModel::itemsChanged,
+            this,    &KFileItemModelRolesUpdater::slotItemsChanged);
+}
+
 bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
+{
+    QHash<QByteArray, QVariant> data;
+    if (!resolveRoles(index, hint, data)) {
+        return false;
+    }
+
+    applyData(index, data);
+    return true;
+}
+
+bool KFileItemModelRolesUpdater::resolveRoles(int index, ResolveHint hint, QHash<QByteArray, QVariant>& data)
 {
     const KFileItem item = m_model->fileItem(index);
     const bool resolveAll = (hint == ResolveAll);
@@ -1034,7 +1564,6 @@ bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
             return false;
         }
 
-        QHash<QByteArray, QVariant> data;
         if (resolveAll) {
             data = rolesData(item);
         }
@@ -1045,17 +1574,13 @@ bool KFileItemModelRolesUpdater::applyResolvedRoles(int index, ResolveHint hint)
             data.insert("iconPixmap", QPixmap());
         }
 
-        disconnect(m_model, &KFileItemModel::itemsChanged,
-                   this,    &KFileItemModelRolesUpdater::slotItemsChanged);
-        m_model->setData(index, data);
-        connect(m_model, &KFileItemModel::itemsChanged,
-                this,    &KFileItemModelRolesUpdater::slotItemsChanged);
         return true;
     }
 
     return false;
 }
 
+
 QHash<QByteArray, QVariant> KFileItemModelRolesUpdater::rolesData(const KFileItem& item)
 {
     QHash<QByteArray, QVariant> data;
@@ -1066,9 +1591,17 @@ QHash<QByteArray, QVariant> KFileItemModelRolesUpdater::rolesData(const KFileIte
     if ((getSizeRole || getIsExpandableRole) && item.isDir()) {
         if (item.isLocalFile()) {
             // Tell m_directoryContentsCounter that we want to count the items
-            // inside the directory. The result will be received in slotDirectoryContentsCountReceived.
-            const QString path = item.localPath();
-            m_directoryContentsCounter->addDirectory(path);
+            // inside the directory. If the number is not cached yet, the result
+            // will be received in slotDirectoryContentsCountReceived.
+            const KDirectoryContentsCounterWorker::CountResult result = m_directoryContentsCounter->addDirectory(item);
+            if (result.count >= 0) {
+                if (getSizeRole) {
+                    insertDirectorySize(data, result.count, result.size);
+                }
+                if (getIsExpandableRole) {
+                    data.insert("isExpandable", result.count > 0);
+                }
+            }
         } else if (getSizeRole) {
             data.insert("size", -1); // -1 indicates an unknown number of items
         }
@@ -1106,7 +1639,7 @@ void KFileItemModelRolesUpdater::slotOverlaysChanged(const QUrl& url, const QStr
         overlays.append(it->getOverlays(url));
     }
     data.insert("iconOverlays", overlays);
-    m_model->setData(index, data);
+    applyData(index, data);
 }
 
 void KFileItemModelRolesUpdater::updateAllPreviews()
@@ -1114,24 +1647,72 @@ void KFileItemModelRolesUpdater::updateAllPreviews()
     if (m_state == Paused) {
         m_previewChangedDuringPausing = true;
     } else {
-        m_finishedItems.clear();
+        // The previews of the running preview jobs would be outdated.
+        killPreviewJobs();
+        m_model->resetItemFlag(KFileItemModel::FinishedFlag);
         startUpdating();
     }
 }
 
-void KFileItemModelRolesUpdater::killPreviewJob()
+void KFileItemModelRolesUpdater::killPreviewJobs()
 {
-    if (m_previewJob) {
-        disconnect(m_previewJob,  &KIO::PreviewJob::gotPreview,
-                   this, &KFileItemModelRolesUpdater::slotGotPreview);
-        disconnect(m_previewJob,  &KIO::PreviewJob::failed,
-                   this, &KFileItemModelRolesUpdater::slotPreviewFailed);
-        disconnect(m_previewJob,  &KIO::PreviewJob::finished,
-                   this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
-        m_previewJob->kill();
-        m_previewJob = nullptr;
+    if (!m_previewJobs.isEmpty()) {
+        foreach (KJob* job, m_previewJobs.keys()) {
+            killPreviewJob(job);
+        }
         m_pendingPreviewItems.clear();
     }
+
+    // Previews that are being framed are dropped by slotPreviewsFramed().
+    m_previewItemsToFrame.clear();
+    m_previewsToFrame.clear();
+    m_previewItemsBeingFramed.clear();
+}
+
+void KFileItemModelRolesUpdater::killPreviewJob(KJob* job)
+{
+    KIO::PreviewJob* previewJob = static_cast<KIO::PreviewJob*>(job);
+    disconnect(previewJob,  &KIO::PreviewJob::gotPreview,
+               this, &KFileItemModelRolesUpdater::slotGotPreview);
+    disconnect(previewJob,  &KIO::PreviewJob::failed,
+               this, &KFileItemModelRolesUpdater::slotPreviewFailed);
+    disconnect(previewJob,  &KIO::PreviewJob::finished,
+               this, &KFileItemModelRolesUpdater::slotPreviewJobFinished);
+    previewJob->kill();
+    m_previewJobs.remove(job);
+}
+
+void KFileItemModelRolesUpdater::killInvisiblePreviewJobs()
+{
+    foreach (KJob* job, m_previewJobs.keys()) {
+        bool hasVisibleItems = false;
+        foreach (const KFileItem& item, m_previewJobs.value(job)) {
+            const int index = m_model->index(item);
+            if (index >= m_firstVisibleIndex && index <= m_lastVisibleIndex && !m_model->itemFlag(index, KFileItemModel::FinishedFlag)) {
+                hasVisibleItems = true;
+                break;
+            }
+        }
+
+        if (!hasVisibleItems) {
+            killPreviewJob(job);
+        }
+    }
+}
+
+void KFileItemModelRolesUpdater::updateVisibleRangeLatency()
+{
+    if (m_visibleRangeLatency >= 0 || !m_visibleRangeTimer.isValid()) {
+        return;
+    }
+
+    for (int index = m_firstVisibleIndex; index <= m_lastVisibleIndex; ++index) {
+        if (!m_model->itemFlag(index, KFileItemModel::FinishedFlag)) {
+            return;
+        }
+    }
+
+    m_visibleRangeLatency = m_visibleRangeTimer.elapsed();
 }
 
 QList<int> KFileItemModelRolesUpdater::indexesToResolve() const
@@ -21,21 +21,30 @@
 #define KFILEITEMMODELROLESUPDATER_H
 
 #include "dolphin_export.h"
+#include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/kitemmodelbase.h"
 
 #include <KFileItem>
 #include <config-baloo.h>
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
 #include <QObject>
 #include <QSet>
 #include <QSize>
 #include <QStringList>
+#include <QUrl>
+#include <QVector>
 
 class KDirectoryContentsCounter;
-class KFileItemModel;
+class KJob;
 class QPixmap;
 class QTimer;
+template <typename T> class QFutureWatcher;
+class KMimeTypeResolver;
 class KOverlayIconPlugin;
+class KPreviewCache;
 
 namespace KIO {
     class PreviewJob;
@@ -78,12 +87,15 @@ namespace KIO {
  *          asynchronously for the interesting items. This is done by the
  *          function \a resolveNextPendingRoles().
  *
- *      (b) If previews are enabled, a \a KIO::PreviewJob is started that loads
- *          the previews for the interesting items. At the same time, the icons
+ *      (b) If previews are enabled, several \a KIO::PreviewJob instances are
+ *          started that load the previews for the interesting items, starting
+ *          with the visible items. At the same time, the icons
  *          for these items are determined asynchronously as fast as possible
  *          by \a resolveNextPendingRoles(). This minimizes the risk that the
  *          user sees "unknown" icons when scrolling before the previews have
- *          arrived.
+ *          arrived. If the visible area changes, the preview jobs for items
+ *          that are not visible anymore are killed, and the remaining items
+ *          are prioritized again.
  *
  * 3.   Finally, the entire process is repeated for any items that might have
  *      changed in the mean time.
@@ -101,7 +113,8 @@ public:
 
     /**
      * Sets the range of items that are visible currently. The roles
-     * of visible items are resolved first.
+     * of visible items are resolved first. Preview jobs that only
+     * create previews for items that are not visible anymore are killed.
      */
     void setVisibleIndexRange(int index, int count);
 
@@ -123,6 +136,15 @@ public:
     void setEnlargeSmallPreviews(bool enlarge);
     bool enlargeSmallPreviews() const;
 
+    /**
+     * If enabled, the size of the contents of the directories is determined
+     * and set as role "contentsSize" in addition to the number of items,
+     * which is the role "size". Per default only the number of items is
+     * determined.
+     */
+    void setDirectoryContentsSizeShown(bool show);
+    bool directoryContentsSizeShown() const;
+
     /**
      * If \a paused is set to true the asynchronous resolving of roles will be paused.
      * State changes during pauses like changing the icon size or the preview-shown
@@ -154,6 +176,19 @@ public:
      */
     QStringList enabledPlugins() const;
 
+    /**
+     * @return The number of items whose previews are being created or
+     *         are waiting to be created.
+     */
+    int pendingPreviewCount() const;
+
+    /**
+     * @return The time in ms between the last change of the visible index
+     *         range and the moment when all visible items had been resolved,
+     *         or -1 if some visible items are still being resolved.
+     */
+    qint64 visibleRangeLatency() const;
+
 private slots:
     void slotItemsInserted(const KItemRangeList& itemRanges);
     void slotItemsRemoved(const KItemRangeList& itemRanges);
@@ -165,23 +200,29 @@ private slots:
 
     /**
      * Is invoked after a preview has been received successfully.
-     * @see startPreviewJob()
+     * @see startPreviewJobs()
      */
     void slotGotPreview(const KFileItem& item, const QPixmap& pixmap);
 
     /**
      * Is invoked after generating a preview has failed.
-     * @see startPreviewJob()
+     * @see startPreviewJobs()
      */
     void slotPreviewFailed(const KFileItem& item);
 
     /**
-     * Is invoked when the preview job has been finished. Starts a new preview
+     * Is invoked when a preview job has been finished. Starts a new preview
      * job if there are any interesting items without previews left, or updates
-     * the changed items otherwise.     *
-     * @see startPreviewJob()
+     * the changed items if all preview jobs have been finished.
+     * @see startPreviewJobs()
      */
-    void slotPreviewJobFinished();
+    void slotPreviewJobFinished(KJob* job);
+
+    /**
+     * Is invoked when the previews started by startFramingPreviews() have
+     * been framed. Applies them to the model at once.
+     */
+    void slotPreviewsFramed();
 
     /**
      * Is invoked when one of the KOverlayIconPlugin emit the signal that an overlay has changed
@@ -189,7 +230,7 @@ private slots:
     void slotOverlaysChanged(const QUrl& url, const QStringList&);
 
     /**
-     * Resolves the sort role of the next item in m_pendingSortRole, applies it
+     * Resolves the sort role of the next items in m_pendingSortRole, applies it
      * to the model, and invokes itself if there are any pending items left. If
      * that is not the case, \a startUpdating() is called.
      */
@@ -197,22 +238,43 @@ private slots:
 
     /**
      * Resolves the icon name and (if previews are disabled) all other roles
-     * for the next interesting item. If there are no pending items left, any
+     * for the next interesting items. If there are no pending items left, any
      * changed items are updated.
      */
     void resolveNextPendingRoles();
 
+    /**
+     * Is invoked when m_mimeTypeResolver has determined the MIME types of a
+     * batch of items. Applies the resolved items and their roles to the model,
+     * and continues resolving the next items if no batches are left.
+     */
+    void slotMimeTypesResolved(const QHash<QUrl, KFileItem>& items);
+
     /**
      * Resolves items that have not been resolved yet after the change has been
-     * notified by slotItemsChanged(). Is invoked if the m_changedItemsTimer
+     * notified by slotItemsChanged(). Is invoked if the m_recentlyChangedItemsTimer
      * expires.
      */
     void resolveRecentlyChangedItems();
 
+    /**
+     * Applies the values that have been collected by applyData() and
+     * applyItemsData() to the model with a single setItemsData() call.
+     * Is invoked once per frame if the m_pendingItemValuesTimer expires.
+     */
+    void applyPendingItemValues();
+
     void applyChangedBalooRoles(const QString& file);
     void applyChangedBalooRolesForItem(const KFileItem& file);
 
-    void slotDirectoryContentsCountReceived(const QString& path, int count);
+    void slotDirectoryContentsCountReceived(const QString& path, int count, qint64 size);
+
+    /**
+     * Applies the size of the part of the contents of the directory \a path
+     * that has been walked so far, so that the size grows while the
+     * directory is walked.
+     */
+    void slotDirectorySizeProgress(const QString& path, qint64 size);
 
 private:
     /**
@@ -231,12 +293,66 @@ private:
 
     /**
      * Creates previews for the items starting from the first item in
-     * m_pendingPreviewItems.
+     * m_pendingPreviewItems. Up to m_maximumPreviewJobs preview jobs run
+     * concurrently, each of them for a small chunk of items, so that the
+     * order of m_pendingPreviewItems is respected even if it is changed
+     * while the jobs are running.
      * @see slotGotPreview()
      * @see slotPreviewFailed()
      * @see slotPreviewJobFinished()
      */
-    void startPreviewJob();
+    void startPreviewJobs();
+
+    /**
+     * Starts a preview job for the next chunk of items in m_pendingPreviewItems.
+     * The MIME types of the chunk are determined for at most \a mimeTypeTimeout ms
+     * before the job is started.
+     */
+    void startPreviewJob(int mimeTypeTimeout);
+
+    /**
+     * Applies the cached previews of the items in m_pendingPreviewItems to
+     * the model, and removes these items from m_pendingPreviewItems. Stops
+     * after MaxBlockTimeout ms, so that the remaining items are handled
+     * by the preview job.
+     * @see KPreviewCache
+     */
+    void applyCachedPreviews();
+
+    /**
+     * Scales the previews in m_previewsToFrame to the icon size and applies
+     * a frame to previews without alpha channel in worker threads.
+     * @see slotPreviewsFramed()
+     */
+    void startFramingPreviews();
+
+    /**
+     * @return True if received previews have not been applied to the model yet.
+     */
+    bool isFramingPreviews() const;
+
+    /**
+     * @return The data of \a item with the preview \a pixmap, on which the
+     *         overlays of the item have been drawn.
+     */
+    QHash<QByteArray, QVariant> previewData(const KFileItem& item, const QPixmap& pixmap);
+
+    /**
+     * @return A key for all settings that affect the look of the previews,
+     *         which are stored by m_previewCache.
+     */
+    QByteArray previewCacheConfiguration() const;
+
+    /**
+     * Remembers the resolved \a data of the item at \a index. The values of
+     * all items are applied to the model once per frame by
+     * applyPendingItemValues(), so the view only receives a few itemsChanged()
+     * signals with coalesced ranges instead of one signal per item. Changes
+     * of the model that are not done by KFileItemModelRolesUpdater are not
+     * delayed.
+     */
+    void applyData(int index, const QHash<QByteArray, QVariant>& data);
+    void applyItemsData(const QVector<KFileItemModel::ItemValues>& itemValues);
 
     /**
      * Ensures that icons, previews, and other roles are determined for any
@@ -245,9 +361,9 @@ private:
     void updateChangedItems();
 
     /**
-     * Resolves the sort role of the item and applies it to the model.
+     * @return The resolved sort role of the item with the index \a index.
      */
-    void applySortRole(int index);
+    QHash<QByteArray, QVariant> sortRoleData(int index);
 
     void applySortProgressToModel();
 
@@ -256,6 +372,13 @@ private:
         ResolveAll
     };
     bool applyResolvedRoles(int index, ResolveHint hint);
+
+    /**
+     * Resolves the roles of the item with the index \a index and stores them
+     * in \a data. Returns false if the model need not be updated.
+     */
+    bool resolveRoles(int index, ResolveHint hint, QHash<QByteArray, QVariant>& data);
+
     QHash<QByteArray, QVariant> rolesData(const KFileItem& item);
 
     /**
@@ -269,7 +392,20 @@ private:
      */
     void updateAllPreviews();
 
-    void killPreviewJob();
+    void killPreviewJobs();
+    void killPreviewJob(KJob* job);
+
+    /**
+     * Kills the preview jobs that do not create a preview for any visible item.
+     * Their items are added to m_pendingPreviewItems again by startUpdating()
+     * if they are still interesting.
+     */
+    void killInvisiblePreviewJobs();
+
+    /**
+     * Sets m_visibleRangeLatency if all visible items have been resolved.
+     */
+    void updateVisibleRangeLatency();
 
     QList<int> indexesToResolve() const;
 
@@ -301,9 +437,10 @@ private:
     // during the roles-updater has been paused by setPaused().
     bool m_clearPreviews;
 
-    // Remembers which items have been handled already, to prevent that
-    // previews and other expensive roles are determined again.
-    QSet<KFileItem> m_finishedItems;
+    // Which items have been handled already, which items have been changed
+    // and for which items the sort role is pending is stored in per-item flags
+    // of the model, see KFileItemModel::ItemFlag. The flags move together with
+    // the items and are unset by the model if the items get removed.
 
     KFileItemModel* m_model;
     QSize m_iconSize;
@@ -314,18 +451,37 @@ private:
     QSet<QByteArray> m_resolvableRoles;
     QStringList m_enabledPlugins;
 
-    // Items for which the sort role still has to be determined.
-    QSet<KFileItem> m_pendingSortRoleItems;
+    // Index from which resolveNextSortRole() continues searching the items
+    // whose sort role still has to be determined.
+    int m_sortRoleResolveIndex;
 
     // Indexes of items which still have to be handled by
     // resolveNextPendingRoles().
     QList<int> m_pendingIndexes;
 
-    // Items which have been left over from the last call of startPreviewJob().
-    // A new preview job will be started from them once the first one finishes.
+    // Items for which no preview job has been started yet, ordered by their
+    // priority. New preview jobs are started from them once a job finishes.
     KFileItemList m_pendingPreviewItems;
 
-    KIO::PreviewJob* m_previewJob;
+    // Running preview jobs and the items for which they create previews.
+    QHash<KJob*, KFileItemList> m_previewJobs;
+    int m_maximumPreviewJobs;
+
+    // Measures the time until all items of the visible range have been
+    // resolved, see visibleRangeLatency().
+    QElapsedTimer m_visibleRangeTimer;
+    qint64 m_visibleRangeLatency;
+
+    // Stores the framed previews of the current directory on disk, so that
+    // they need not be created again when the directory is opened again.
+    KPreviewCache* m_previewCache;
+
+    // Previews that have been received by slotGotPreview(), and previews
+    // which are being framed in worker threads by m_framingWatcher.
+    KFileItemList m_previewItemsToFrame;
+    QList<QImage> m_previewsToFrame;
+    KFileItemList m_previewItemsBeingFramed;
+    QFutureWatcher<QImage>* m_framingWatcher;
 
     // When downloading or copying large files, the slot slotItemsChanged()
     // will be called periodically within a quite short delay. To prevent
@@ -333,13 +489,19 @@ private:
     // will be postponed until no file change has been done within a longer period
     // of time.
     QTimer* m_recentlyChangedItemsTimer;
-    QSet<KFileItem> m_recentlyChangedItems;
 
-    // Items which have not been changed repeatedly recently.
-    QSet<KFileItem> m_changedItems;
+    // Values that have been resolved by applyData() and applyItemsData(),
+    // but not applied to the model yet, see applyPendingItemValues().
+    QHash<QUrl, KFileItemModel::ItemValues> m_pendingItemValues;
+    QTimer* m_pendingItemValuesTimer;
 
     KDirectoryContentsCounter* m_directoryContentsCounter;
 
+    // Determines the MIME types of local files in worker threads.
+    // m_resolvingHint specifies which roles are applied to the model afterwards.
+    KMimeTypeResolver* m_mimeTypeResolver;
+    ResolveHint m_resolvingHint;
+
     QList<KOverlayIconPlugin*> m_overlayIconsPlugin;
 
 #ifdef HAVE_BALOO
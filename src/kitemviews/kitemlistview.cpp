@@ -472,6 +472,11 @@ void KItemListView::calculateItemSizeHints(QVector<qreal>& logicalHeightHints, q
     widgetCreator()->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, this);
 }
 
+bool KItemListView::estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint) const
+{
+    return widgetCreator()->estimateItemSizeHints(logicalHeightHints, logicalWidthHint, this);
+}
+
 void KItemListView::setSupportsItemExpanding(bool supportsExpanding)
 {
     if (m_supportsItemExpanding != supportsExpanding) {
@@ -1010,7 +1015,8 @@ void KItemListView::slotItemsInserted(const KItemRangeList& itemRanges)
         beginTransaction();
     }
 
-    m_layouter->markAsDirty();
+    // The ranges are sorted, so the items before the first range are not affected.
+    m_layouter->markAsDirty(itemRanges.first().index);
 
     m_sizeHintResolver->itemsInserted(itemRanges);
 
@@ -1121,7 +1127,7 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
         beginTransaction();
     }
 
-    m_layouter->markAsDirty();
+    m_layouter->markAsDirty(itemRanges.first().index);
 
     m_sizeHintResolver->itemsRemoved(itemRanges);
 
@@ -1226,7 +1232,7 @@ void KItemListView::slotItemsRemoved(const KItemRangeList& itemRanges)
 void KItemListView::slotItemsMoved(const KItemRange& itemRange, const QList<int>& movedToIndexes)
 {
     m_sizeHintResolver->itemsMoved(itemRange, movedToIndexes);
-    m_layouter->markAsDirty();
+    m_layouter->markAsDirty(itemRange.index);
 
     if (m_controller) {
         m_controller->selectionManager()->itemsMoved(itemRange, movedToIndexes);
@@ -1261,7 +1267,7 @@ void KItemListView::slotItemsChanged(const KItemRangeList& itemRanges,
 
         if (updateSizeHints) {
             m_sizeHintResolver->itemsChanged(index, count, roles);
-            m_layouter->markAsDirty();
+            m_layouter->markSizesAsDirty(index, count);
 
             if (!m_layoutTimer->isActive()) {
                 m_layoutTimer->start();
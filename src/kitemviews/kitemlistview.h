@@ -208,6 +208,13 @@ public:
      */
     void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint) const;
 
+    /**
+     * Estimates the size hints of the items cheaply, see
+     * KItemListWidgetInformant::estimateItemSizeHints().
+     * @return False if the widgets do not support estimating size hints.
+     */
+    bool estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint) const;
+
     /**
      * If set to true, items having child-items can be expanded to show the child-items as
      * part of the view. Per default the expanding of items is is disabled. If expanding of
@@ -811,6 +818,8 @@ public:
 
     virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
 
+    virtual bool estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
+
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const = 0;
@@ -830,6 +839,8 @@ public:
 
     void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
 
+    bool estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
+
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const override;
@@ -866,6 +877,12 @@ void KItemListWidgetCreator<T>::calculateItemSizeHints(QVector<qreal>& logicalHe
     return m_informant->calculateItemSizeHints(logicalHeightHints, logicalWidthHint, view);
 }
 
+template<class T>
+bool KItemListWidgetCreator<T>::estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    return m_informant->estimateItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+}
+
 template<class T>
 qreal KItemListWidgetCreator<T>::preferredRoleColumnWidth(const QByteArray& role,
                                                           int index,
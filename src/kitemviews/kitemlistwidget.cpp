@@ -38,6 +38,14 @@ KItemListWidgetInformant::~KItemListWidgetInformant()
 {
 }
 
+bool KItemListWidgetInformant::estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    Q_UNUSED(logicalHeightHints);
+    Q_UNUSED(logicalWidthHint);
+    Q_UNUSED(view);
+    return false;
+}
+
 KItemListWidget::KItemListWidget(KItemListWidgetInformant* informant, QGraphicsItem* parent) :
     QGraphicsWidget(parent, nullptr),
     m_informant(informant),
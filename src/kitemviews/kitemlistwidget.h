@@ -48,8 +48,24 @@ public:
     KItemListWidgetInformant();
     virtual ~KItemListWidgetInformant();
 
+    /**
+     * Calculates the exact logical height hints of all items whose hint
+     * is 0.0 in \a logicalHeightHints, and the logical width hint.
+     */
     virtual void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const = 0;
 
+    /**
+     * Estimates the logical height hints of all items whose hint is 0.0
+     * in \a logicalHeightHints without the (possibly expensive) exact
+     * calculation, e.g. without laying out the texts. The estimated
+     * hints are stored as negative values. KItemListSizeHintResolver
+     * replaces them by exact hints only for the items that are visible.
+     * @return False if estimating the hints is not supported. In this
+     *         case, nothing is changed. The default implementation
+     *         returns false.
+     */
+    virtual bool estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
+
     virtual qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const = 0;
@@ -23,6 +23,7 @@
 #include "kfileitemmodel.h"
 #include "private/kfileitemclipboard.h"
 #include "private/kitemlistroleeditor.h"
+#include "private/kitemlisttextcache.h"
 #include "private/kpixmapmodifier.h"
 
 #include <KIconEffect>
@@ -36,9 +37,79 @@
 #include <QGuiApplication>
 #include <QPixmapCache>
 #include <QStyleOption>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtMath>
 
 // #define KSTANDARDITEMLISTWIDGET_DEBUG
 
+namespace {
+    // Minimum number of items whose size hints are calculated at once, before
+    // the text of the items is measured on all CPU cores.
+    const int ParallelTextShapingThreshold = 1000;
+
+    struct TextShapingJob
+    {
+        int index;
+        QStringList texts;
+        bool isLink;
+        qreal result;
+    };
+
+    /**
+     * @return A copy of \a font that does not share its data with \a font.
+     *         QFont caches the font engine in its implicitly shared data,
+     *         so a font may not be used by several threads at the same time,
+     *         even if each thread has its own copy.
+     */
+    QFont detachedFont(const QFont& font)
+    {
+        // Changing a property detaches the copy, afterwards the original
+        // property and the resolve mask are restored.
+        QFont copy(font);
+        copy.setKerning(!font.kerning());
+        copy.setKerning(font.kerning());
+        copy.resolve(font.resolve());
+        return copy;
+    }
+
+    /**
+     * Measures the texts of the jobs by \a shape, which gets the job and the font
+     * to be used for it: \a linkFont for links, otherwise \a font. Reading the texts
+     * from the model must be done in the GUI thread before, but laying out the
+     * texts with QTextLayout and QFontMetrics is possible in any thread. Many
+     * jobs are split into one chunk per thread, and each chunk uses its own
+     * detached copies of the fonts.
+     */
+    template <typename ShapeFunction>
+    void shapeTexts(QVector<TextShapingJob>& jobs, const QFont& font, const QFont& linkFont, ShapeFunction shape)
+    {
+        if (jobs.count() <= ParallelTextShapingThreshold) {
+            for (TextShapingJob& job : jobs) {
+                shape(job, job.isLink ? linkFont : font);
+            }
+            return;
+        }
+
+        const int chunkCount = qMax(1, QThread::idealThreadCount());
+        const int chunkSize = (jobs.count() + chunkCount - 1) / chunkCount;
+        QVector<QPair<int, int> > chunks;
+        for (int begin = 0; begin < jobs.count(); begin += chunkSize) {
+            chunks.append(qMakePair(begin, qMin(begin + chunkSize, jobs.count())));
+        }
+
+        // QVector::operator[]() may not be used by several threads.
+        TextShapingJob* data = jobs.data();
+        QtConcurrent::blockingMap(chunks, [&](const QPair<int, int>& chunk) {
+            const QFont chunkFont = detachedFont(font);
+            const QFont chunkLinkFont = detachedFont(linkFont);
+            for (int i = chunk.first; i < chunk.second; ++i) {
+                shape(data[i], data[i].isLink ? chunkLinkFont : chunkFont);
+            }
+        });
+    }
+}
+
 KStandardItemListWidgetInformant::KStandardItemListWidgetInformant() :
     KItemListWidgetInformant()
 {
@@ -69,6 +140,16 @@ void KStandardItemListWidgetInformant::calculateItemSizeHints(QVector<qreal>& lo
     }
 }
 
+bool KStandardItemListWidgetInformant::estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    if (static_cast<const KStandardItemListView*>(view)->itemLayout() != KStandardItemListView::IconsLayout) {
+        return false;
+    }
+
+    estimateIconsLayoutItemSizeHints(logicalHeightHints, logicalWidthHint, view);
+    return true;
+}
+
 qreal KStandardItemListWidgetInformant::preferredRoleColumnWidth(const QByteArray& role,
                                                                  int index,
                                                                  const KItemListView* view) const
@@ -149,19 +230,20 @@ void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector
     QTextOption textOption(Qt::AlignHCenter);
     textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
 
+    QVector<TextShapingJob> jobs;
     for (int index = 0; index < logicalHeightHints.count(); ++index) {
-        if (logicalHeightHints.at(index) > 0.0) {
-            continue;
+        if (logicalHeightHints.at(index) == 0.0) {
+            const TextShapingJob job = {index, QStringList(KStringHandler::preProcessWrap(itemText(index, view))), itemIsLink(index, view), 0.0};
+            jobs.append(job);
         }
+    }
 
-        // If the current item is a link, we use the customized link font instead of the normal font.
-        const QFont& font = itemIsLink(index, view) ? linkFont : normalFont;
-
-        const QString& text = KStringHandler::preProcessWrap(itemText(index, view));
-
+    // If the current item is a link, we use the customized link font instead of the normal font.
+    const int maxTextLines = option.maxTextLines;
+    shapeTexts(jobs, normalFont, linkFont, [&](TextShapingJob& job, const QFont& font) {
         // Calculate the number of lines required for wrapping the name
         qreal textHeight = 0;
-        QTextLayout layout(text, font);
+        QTextLayout layout(job.texts.first(), font);
         layout.setTextOption(textOption);
         layout.beginLayout();
         QTextLine line;
@@ -172,16 +254,64 @@ void KStandardItemListWidgetInformant::calculateIconsLayoutItemSizeHints(QVector
             textHeight += line.height();
 
             ++lineCount;
-            if (lineCount == option.maxTextLines) {
+            if (lineCount == maxTextLines) {
                 break;
             }
         }
         layout.endLayout();
 
+        job.result = textHeight;
+    });
+
+    foreach (const TextShapingJob& job, jobs) {
         // Add one line for each additional information
-        textHeight += additionalRolesSpacing;
+        logicalHeightHints[job.index] = job.result + additionalRolesSpacing + spacingAndIconHeight;
+    }
 
-        logicalHeightHints[index] = textHeight + spacingAndIconHeight;
+    logicalWidthHint = itemWidth;
+}
+
+void KStandardItemListWidgetInformant::estimateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const
+{
+    const KItemListStyleOption& option = view->styleOption();
+    const int additionalRolesCount = qMax(view->visibleRoles().count() - 1, 0);
+
+    const qreal itemWidth = view->itemSize().width();
+    const qreal maxWidth = qMax(qreal(1), itemWidth - 2 * option.padding);
+    const qreal additionalRolesSpacing = additionalRolesCount * option.fontMetrics.lineSpacing();
+    const qreal spacingAndIconHeight = option.iconSize + option.padding * 3;
+    const qreal lineHeight = option.fontMetrics.height();
+
+    // Looking up the widths of the Latin-1 characters in a table is much
+    // cheaper than asking the font for each character. The average width
+    // is used for all other characters.
+    const QFontMetricsF fontMetrics(option.font);
+    qreal glyphWidths[256];
+    for (int i = 0; i < 256; ++i) {
+        glyphWidths[i] = fontMetrics.width(QChar(i));
+    }
+    const qreal averageGlyphWidth = fontMetrics.averageCharWidth();
+
+    for (int index = 0; index < logicalHeightHints.count(); ++index) {
+        if (logicalHeightHints.at(index) != 0.0) {
+            continue;
+        }
+
+        const QString text = itemText(index, view);
+        qreal textWidth = 0;
+        foreach (const QChar& c, text) {
+            textWidth += (c.unicode() < 256) ? glyphWidths[c.unicode()] : averageGlyphWidth;
+        }
+
+        int lineCount = qMax(1, qCeil(textWidth / maxWidth));
+        if (option.maxTextLines > 0) {
+            lineCount = qMin(lineCount, option.maxTextLines);
+        }
+
+        const qreal textHeight = lineCount * lineHeight + additionalRolesSpacing;
+
+        // Estimated hints are stored as negative values.
+        logicalHeightHints[index] = -(textHeight + spacingAndIconHeight);
     }
 
     logicalWidthHint = itemWidth;
@@ -199,37 +329,48 @@ void KStandardItemListWidgetInformant::calculateCompactLayoutItemSizeHints(QVect
     const qreal paddingAndIconWidth = option.padding * 4 + option.iconSize;
     const qreal height = option.padding * 2 + qMax(option.iconSize, (1 + additionalRolesCount) * normalFontMetrics.lineSpacing());
 
-    const QFontMetrics linkFontMetrics(customizedFontForLinks(option.font));
+    const QFont linkFont = customizedFontForLinks(option.font);
 
+    QVector<TextShapingJob> jobs;
     for (int index = 0; index < logicalHeightHints.count(); ++index) {
-        if (logicalHeightHints.at(index) > 0.0) {
+        if (logicalHeightHints.at(index) != 0.0) {
             continue;
         }
 
-        // If the current item is a link, we use the customized link font metrics instead of the normal font metrics.
-        const QFontMetrics& fontMetrics = itemIsLink(index, view) ? linkFontMetrics : normalFontMetrics;
-
-        // For each row exactly one role is shown. Calculate the maximum required width that is necessary
-        // to show all roles without horizontal clipping.
-        qreal maximumRequiredWidth = 0.0;
-
+        TextShapingJob job = {index, QStringList(), itemIsLink(index, view), 0.0};
         if (showOnlyTextRole) {
-            maximumRequiredWidth = fontMetrics.width(itemText(index, view));
+            job.texts.append(itemText(index, view));
         } else {
             const QHash<QByteArray, QVariant>& values = view->model()->data(index);
             foreach (const QByteArray& role, visibleRoles) {
-                const QString& text = roleText(role, values);
-                const qreal requiredWidth = fontMetrics.width(text);
-                maximumRequiredWidth = qMax(maximumRequiredWidth, requiredWidth);
+                job.texts.append(roleText(role, values));
             }
         }
+        jobs.append(job);
+    }
+
+    // If the current item is a link, we use the customized link font instead of the normal font.
+    shapeTexts(jobs, option.font, linkFont, [&](TextShapingJob& job, const QFont& font) {
+        const QFontMetrics fontMetrics(font);
+
+        // For each row exactly one role is shown. Calculate the maximum required width that is necessary
+        // to show all roles without horizontal clipping.
+        qreal maximumRequiredWidth = 0.0;
+        foreach (const QString& text, job.texts) {
+            const qreal requiredWidth = fontMetrics.width(text);
+            maximumRequiredWidth = qMax(maximumRequiredWidth, requiredWidth);
+        }
+
+        job.result = maximumRequiredWidth;
+    });
 
-        qreal width = paddingAndIconWidth + maximumRequiredWidth;
+    foreach (const TextShapingJob& job, jobs) {
+        qreal width = paddingAndIconWidth + job.result;
         if (maxWidth > 0 && width > maxWidth) {
             width = maxWidth;
         }
 
-        logicalHeightHints[index] = width;
+        logicalHeightHints[job.index] = width;
     }
 
     logicalWidthHint = height;
@@ -1079,13 +1220,8 @@ void KStandardItemListWidget::updateTextsCache()
         m_textInfo.insert(m_sortedVisibleRoles[i], textInfo);
     }
 
-    switch (m_layout) {
-    case IconsLayout:   updateIconsLayoutTextCache(); break;
-    case CompactLayout: updateCompactLayoutTextCache(); break;
-    case DetailsLayout: updateDetailsLayoutTextCache(); break;
-    default: Q_ASSERT(false); break;
-    }
-
+    // The rating pixmap is created before the texts are laid out, as the
+    // Icons layout uses its width for the text rectangle.
     const TextInfo* ratingTextInfo = m_textInfo.value("rating");
     if (ratingTextInfo) {
         // The text of the rating-role has been set to empty to get
@@ -1111,6 +1247,13 @@ void KStandardItemListWidget::updateTextsCache()
     } else if (!m_rating.isNull()) {
         m_rating = QPixmap();
     }
+
+    switch (m_layout) {
+    case IconsLayout:   updateIconsLayoutTextCache(); break;
+    case CompactLayout: updateCompactLayoutTextCache(); break;
+    case DetailsLayout: updateDetailsLayoutTextCache(); break;
+    default: Q_ASSERT(false); break;
+    }
 }
 
 void KStandardItemListWidget::updateIconsLayoutTextCache()
@@ -1137,57 +1280,71 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
     // for initializing the position of the other roles.
     TextInfo* nameTextInfo = m_textInfo.value("text");
     const QString nameText = KStringHandler::preProcessWrap(values["text"].toString());
-    nameTextInfo->staticText.setText(nameText);
+
+    KItemListTextCache* textCache = KItemListTextCache::instance();
+    const KItemListTextCache::Key nameKey = {nameText, m_customizedFont, maxWidth, KItemListTextCache::IconsNameText, option.maxTextLines};
+    const KItemListTextCache::Entry* nameEntry = textCache->entry(nameKey);
 
     // Calculate the number of lines required for the name and the required width
     qreal nameWidth = 0;
     qreal nameHeight = 0;
-    QTextLine line;
-
-    QTextLayout layout(nameTextInfo->staticText.text(), m_customizedFont);
-    layout.setTextOption(nameTextInfo->staticText.textOption());
-    layout.beginLayout();
-    int nameLineIndex = 0;
-    while ((line = layout.createLine()).isValid()) {
-        line.setLineWidth(maxWidth);
-        nameWidth = qMax(nameWidth, line.naturalTextWidth());
-        nameHeight += line.height();
-
-        ++nameLineIndex;
-        if (nameLineIndex == option.maxTextLines) {
-            // The maximum number of textlines has been reached. If this is
-            // the case provide an elided text if necessary.
-            const int textLength = line.textStart() + line.textLength();
-            if (textLength < nameText.length()) {
-                // Elide the last line of the text
-                qreal elidingWidth = maxWidth;
-                qreal lastLineWidth;
-                do {
-                    QString lastTextLine = nameText.mid(line.textStart());
-                    lastTextLine = m_customizedFontMetrics.elidedText(lastTextLine,
-                                                                      Qt::ElideRight,
-                                                                      elidingWidth);
-                    const QString elidedText = nameText.left(line.textStart()) + lastTextLine;
-                    nameTextInfo->staticText.setText(elidedText);
-
-                    lastLineWidth = m_customizedFontMetrics.boundingRect(lastTextLine).width();
-
-                    // We do the text eliding in a loop with decreasing width (1 px / iteration)
-                    // to avoid problems related to different width calculation code paths
-                    // within Qt. (see bug 337104)
-                    elidingWidth -= 1.0;
-                } while (lastLineWidth > maxWidth);
-
-                nameWidth = qMax(nameWidth, lastLineWidth);
+    if (nameEntry) {
+        nameTextInfo->staticText = nameEntry->staticText;
+        nameWidth = nameEntry->width;
+        nameHeight = nameEntry->height;
+    } else {
+        nameTextInfo->staticText.setText(nameText);
+
+        QTextLine line;
+
+        QTextLayout layout(nameTextInfo->staticText.text(), m_customizedFont);
+        layout.setTextOption(nameTextInfo->staticText.textOption());
+        layout.beginLayout();
+        int nameLineIndex = 0;
+        while ((line = layout.createLine()).isValid()) {
+            line.setLineWidth(maxWidth);
+            nameWidth = qMax(nameWidth, line.naturalTextWidth());
+            nameHeight += line.height();
+
+            ++nameLineIndex;
+            if (nameLineIndex == option.maxTextLines) {
+                // The maximum number of textlines has been reached. If this is
+                // the case provide an elided text if necessary.
+                const int textLength = line.textStart() + line.textLength();
+                if (textLength < nameText.length()) {
+                    // Elide the last line of the text
+                    qreal elidingWidth = maxWidth;
+                    qreal lastLineWidth;
+                    do {
+                        QString lastTextLine = nameText.mid(line.textStart());
+                        lastTextLine = m_customizedFontMetrics.elidedText(lastTextLine,
+                                                                          Qt::ElideRight,
+                                                                          elidingWidth);
+                        const QString elidedText = nameText.left(line.textStart()) + lastTextLine;
+                        nameTextInfo->staticText.setText(elidedText);
+
+                        lastLineWidth = m_customizedFontMetrics.boundingRect(lastTextLine).width();
+
+                        // We do the text eliding in a loop with decreasing width (1 px / iteration)
+                        // to avoid problems related to different width calculation code paths
+                        // within Qt. (see bug 337104)
+                        elidingWidth -= 1.0;
+                    } while (lastLineWidth > maxWidth);
+
+                    nameWidth = qMax(nameWidth, lastLineWidth);
+                }
+                break;
             }
-            break;
         }
+        layout.endLayout();
+
+        nameTextInfo->staticText.setTextWidth(maxWidth);
+        const KItemListTextCache::Entry entry = {nameTextInfo->staticText, nameWidth, nameHeight};
+        textCache->insert(nameKey, entry);
     }
-    layout.endLayout();
 
     // Use one line for each additional information
     const int additionalRolesCount = qMax(visibleRoles().count() - 1, 0);
-    nameTextInfo->staticText.setTextWidth(maxWidth);
     nameTextInfo->pos = QPointF(padding, widgetHeight -
                                          nameHeight -
                                          additionalRolesCount * lineSpacing -
@@ -1206,33 +1363,47 @@ void KStandardItemListWidget::updateIconsLayoutTextCache()
 
         const QString text = roleText(role, values);
         TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
 
         qreal requiredWidth = 0;
 
-        QTextLayout layout(text, m_customizedFont);
-        QTextOption textOption;
-        textOption.setWrapMode(QTextOption::NoWrap);
-        layout.setTextOption(textOption);
-
-        layout.beginLayout();
-        QTextLine textLine = layout.createLine();
-        if (textLine.isValid()) {
-            textLine.setLineWidth(maxWidth);
-            requiredWidth = textLine.naturalTextWidth();
-            if (requiredWidth > maxWidth) {
-                const QString elidedText = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, maxWidth);
-                textInfo->staticText.setText(elidedText);
-                requiredWidth = m_customizedFontMetrics.width(elidedText);
-            } else if (role == "rating") {
-		// Use the width of the rating pixmap, because the rating text is empty.
-                requiredWidth = m_rating.width();
+        const KItemListTextCache::Key key = {text, m_customizedFont, maxWidth, KItemListTextCache::IconsRoleText, 1};
+        const KItemListTextCache::Entry* entry = textCache->entry(key);
+        if (entry) {
+            textInfo->staticText = entry->staticText;
+            requiredWidth = entry->width;
+        } else {
+            textInfo->staticText.setText(text);
+
+            QTextLayout layout(text, m_customizedFont);
+            QTextOption textOption;
+            textOption.setWrapMode(QTextOption::NoWrap);
+            layout.setTextOption(textOption);
+
+            layout.beginLayout();
+            QTextLine textLine = layout.createLine();
+            if (textLine.isValid()) {
+                textLine.setLineWidth(maxWidth);
+                requiredWidth = textLine.naturalTextWidth();
+                if (requiredWidth > maxWidth) {
+                    const QString elidedText = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, maxWidth);
+                    textInfo->staticText.setText(elidedText);
+                    requiredWidth = m_customizedFontMetrics.width(elidedText);
+                }
             }
+            layout.endLayout();
+
+            textInfo->staticText.setTextWidth(maxWidth);
+            const KItemListTextCache::Entry newEntry = {textInfo->staticText, requiredWidth, lineSpacing};
+            textCache->insert(key, newEntry);
+        }
+
+        if (role == "rating" && textInfo->staticText.text() == text) {
+            // Use the width of the rating pixmap, because the rating text is empty.
+            // A text that had to be elided keeps its width.
+            requiredWidth = m_rating.width();
         }
-        layout.endLayout();
 
         textInfo->pos = QPointF(padding, y);
-        textInfo->staticText.setTextWidth(maxWidth);
 
         const QRectF textRect(padding + (maxWidth - requiredWidth) / 2, y, requiredWidth, lineSpacing);
         m_textRect |= textRect;
@@ -1262,20 +1433,33 @@ void KStandardItemListWidget::updateCompactLayoutTextCache()
     const qreal x = option.padding * 3 + scaledIconSize;
     qreal y = qRound((widgetHeight - textLinesHeight) / 2);
     const qreal maxWidth = size().width() - x - option.padding;
+    KItemListTextCache* textCache = KItemListTextCache::instance();
     foreach (const QByteArray& role, m_sortedVisibleRoles) {
         const QString text = roleText(role, values);
         TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
 
-        qreal requiredWidth = m_customizedFontMetrics.width(text);
-        if (requiredWidth > maxWidth) {
-            requiredWidth = maxWidth;
-            const QString elidedText = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, maxWidth);
-            textInfo->staticText.setText(elidedText);
+        qreal requiredWidth;
+        const KItemListTextCache::Key key = {text, m_customizedFont, maxWidth, KItemListTextCache::CompactText, 1};
+        const KItemListTextCache::Entry* entry = textCache->entry(key);
+        if (entry) {
+            textInfo->staticText = entry->staticText;
+            requiredWidth = entry->width;
+        } else {
+            textInfo->staticText.setText(text);
+
+            requiredWidth = m_customizedFontMetrics.width(text);
+            if (requiredWidth > maxWidth) {
+                requiredWidth = maxWidth;
+                const QString elidedText = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, maxWidth);
+                textInfo->staticText.setText(elidedText);
+            }
+
+            textInfo->staticText.setTextWidth(maxWidth);
+            const KItemListTextCache::Entry newEntry = {textInfo->staticText, requiredWidth, lineSpacing};
+            textCache->insert(key, newEntry);
         }
 
         textInfo->pos = QPointF(x, y);
-        textInfo->staticText.setTextWidth(maxWidth);
 
         maximumRequiredTextWidth = qMax(maximumRequiredTextWidth, requiredWidth);
 
@@ -1313,11 +1497,10 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
     qreal x = firstColumnInc;
     const qreal y = qMax(qreal(option.padding), (widgetHeight - fontHeight) / 2);
 
+    KItemListTextCache* textCache = KItemListTextCache::instance();
     foreach (const QByteArray& role, m_sortedVisibleRoles) {
         QString text = roleText(role, values);
 
-        // Elide the text in case it does not fit into the available column-width
-        qreal requiredWidth = m_customizedFontMetrics.width(text);
         const qreal roleWidth = columnWidth(role);
         qreal availableTextWidth = roleWidth - columnWidthInc;
 
@@ -1326,13 +1509,27 @@ void KStandardItemListWidget::updateDetailsLayoutTextCache()
             availableTextWidth -= firstColumnInc;
         }
 
-        if (requiredWidth > availableTextWidth) {
-            text = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, availableTextWidth);
+        TextInfo* textInfo = m_textInfo.value(role);
+
+        qreal requiredWidth;
+        const KItemListTextCache::Key key = {text, m_customizedFont, availableTextWidth, KItemListTextCache::DetailsText, 1};
+        const KItemListTextCache::Entry* entry = textCache->entry(key);
+        if (entry) {
+            textInfo->staticText = entry->staticText;
+            requiredWidth = entry->width;
+        } else {
+            // Elide the text in case it does not fit into the available column-width
             requiredWidth = m_customizedFontMetrics.width(text);
+            if (requiredWidth > availableTextWidth) {
+                text = m_customizedFontMetrics.elidedText(text, Qt::ElideRight, availableTextWidth);
+                requiredWidth = m_customizedFontMetrics.width(text);
+            }
+
+            textInfo->staticText.setText(text);
+            const KItemListTextCache::Entry newEntry = {textInfo->staticText, requiredWidth, qreal(fontHeight)};
+            textCache->insert(key, newEntry);
         }
 
-        TextInfo* textInfo = m_textInfo.value(role);
-        textInfo->staticText.setText(text);
         textInfo->pos = QPointF(x + columnWidthInc / 2, y);
         x += roleWidth;
 
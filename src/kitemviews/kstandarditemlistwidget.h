@@ -39,6 +39,15 @@ public:
 
     void calculateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
 
+    /**
+     * Estimates the size hints for the Icons layout, where the height of an
+     * item depends on the number of lines of its wrapped name. The number
+     * of lines is estimated from the widths of the characters instead of
+     * laying out the text. The other layouts are not estimated, as the
+     * heights of their items do not depend on the text.
+     */
+    bool estimateItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const override;
+
     qreal preferredRoleColumnWidth(const QByteArray& role,
                                            int index,
                                            const KItemListView* view) const override;
@@ -73,6 +82,7 @@ protected:
     virtual QFont customizedFontForLinks(const QFont& baseFont) const;
 
     void calculateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
+    void estimateIconsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
     void calculateCompactLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
     void calculateDetailsLayoutItemSizeHints(QVector<qreal>& logicalHeightHints, qreal& logicalWidthHint, const KItemListView* view) const;
 
@@ -274,6 +284,7 @@ private:
 
     friend class KStandardItemListWidgetInformant; // Accesses private static methods to be able to
                                                    // share a common layout calculation
+    friend class KStandardItemListWidgetTest; // For unit testing
 };
 
 #endif
@@ -23,33 +23,26 @@
 
 #include <KDirWatch>
 
-#include <QThread>
-
 KDirectoryContentsCounter::KDirectoryContentsCounter(KFileItemModel* model, QObject* parent) :
     QObject(parent),
     m_model(model),
-    m_queue(),
-    m_worker(nullptr),
-    m_workerIsBusy(false),
+    m_countRecursiveSize(false),
+    m_pendingDirs(),
     m_dirWatcher(nullptr),
     m_watchedDirs()
 {
     connect(m_model, &KFileItemModel::itemsRemoved,
             this,    &KDirectoryContentsCounter::slotItemsRemoved);
 
-    if (!m_workerThread) {
-        m_workerThread = new QThread();
-        m_workerThread->start();
+    if (!m_worker) {
+        m_worker = new KDirectoryContentsCounterWorker();
     }
-
-    m_worker = new KDirectoryContentsCounterWorker();
-    m_worker->moveToThread(m_workerThread);
     ++m_workersCount;
 
-    connect(this,     &KDirectoryContentsCounter::requestDirectoryContentsCount,
-            m_worker, &KDirectoryContentsCounterWorker::countDirectoryContents);
     connect(m_worker, &KDirectoryContentsCounterWorker::result,
             this,     &KDirectoryContentsCounter::slotResult);
+    connect(m_worker, &KDirectoryContentsCounterWorker::sizeProgress,
+            this,     &KDirectoryContentsCounter::slotSizeProgress);
 
     m_dirWatcher = new KDirWatch(this);
     connect(m_dirWatcher, &KDirWatch::dirty, this, &KDirectoryContentsCounter::slotDirWatchDirty);
@@ -59,78 +52,87 @@ KDirectoryContentsCounter::~KDirectoryContentsCounter()
 {
     --m_workersCount;
 
-    if (m_workersCount > 0) {
-        // The worker thread will continue running. It could even be running
-        // a method of m_worker at the moment, so we delete it using
-        // deleteLater() to prevent a crash.
-        m_worker->deleteLater();
-    } else {
-        // There are no remaining workers -> stop the worker thread.
-        m_workerThread->quit();
-        m_workerThread->wait();
-        delete m_workerThread;
-        m_workerThread = nullptr;
-
-        // The worker thread has finished running now, so it's safe to delete
-        // m_worker. deleteLater() would not work at all because the event loop
-        // which would deliver the event to m_worker is not running any more.
+    if (m_workersCount == 0) {
+        // There are no remaining counters -> stop the worker threads
+        // and drop the cached results.
         delete m_worker;
+        m_worker = nullptr;
     }
 }
 
-void KDirectoryContentsCounter::addDirectory(const QString& path)
+KDirectoryContentsCounterWorker::CountResult KDirectoryContentsCounter::addDirectory(const KFileItem& item)
 {
-    startWorker(path);
+    const QString path = item.localPath();
+    const QDateTime modificationTime = item.time(KFileItem::ModificationTime);
+
+    const KDirectoryContentsCounterWorker::CountResult result = m_worker->cachedResult(path, options(), modificationTime);
+    if (result.count >= 0) {
+        watchDirectory(path);
+        return result;
+    }
+
+    startWorker(path, modificationTime);
+    return KDirectoryContentsCounterWorker::CountResult();
 }
 
-int KDirectoryContentsCounter::countDirectoryContentsSynchronously(const QString& path)
+void KDirectoryContentsCounter::setCountRecursiveSize(bool count)
 {
-    if (!m_dirWatcher->contains(path)) {
-        m_dirWatcher->addDir(path);
-        m_watchedDirs.insert(path);
-    }
+    m_countRecursiveSize = count;
+}
 
-    KDirectoryContentsCounterWorker::Options options;
+bool KDirectoryContentsCounter::countsRecursiveSize() const
+{
+    return m_countRecursiveSize;
+}
 
-    if (m_model->showHiddenFiles()) {
-        options |= KDirectoryContentsCounterWorker::CountHiddenFiles;
+void KDirectoryContentsCounter::slotResult(const QString& path, KDirectoryContentsCounterWorker::Options options, int count, qint64 size)
+{
+    // The worker announces the results for all counters.
+    if (options != this->options() || !m_pendingDirs.contains(path)) {
+        return;
     }
 
-    if (m_model->showDirectoriesOnly()) {
-        options |= KDirectoryContentsCounterWorker::CountDirectoriesOnly;
-    }
+    m_pendingDirs.remove(path);
+    watchDirectory(path);
 
-    return KDirectoryContentsCounterWorker::subItemsCount(path, options);
+    emit result(path, count, size);
 }
 
-void KDirectoryContentsCounter::slotResult(const QString& path, int count)
+void KDirectoryContentsCounter::slotSizeProgress(const QString& path, KDirectoryContentsCounterWorker::Options options, qint64 size)
 {
-    m_workerIsBusy = false;
-
-    if (!m_dirWatcher->contains(path)) {
-        m_dirWatcher->addDir(path);
-        m_watchedDirs.insert(path);
+    if (options == this->options() && m_pendingDirs.contains(path)) {
+        emit sizeProgress(path, size);
     }
-
-    if (!m_queue.isEmpty()) {
-        startWorker(m_queue.dequeue());
-    }
-
-    emit result(path, count);
 }
 
 void KDirectoryContentsCounter::slotDirWatchDirty(const QString& path)
 {
     const int index = m_model->index(QUrl::fromLocalFile(path));
     if (index >= 0) {
-        if (!m_model->fileItem(index).isDir()) {
+        const KFileItem item = m_model->fileItem(index);
+        if (!item.isDir()) {
             // If INotify is used, KDirWatch issues the dirty() signal
             // also for changed files inside the directory, even if we
             // don't enable this behavior explicitly (see bug 309740).
             return;
         }
 
-        startWorker(path);
+        m_worker->invalidate(path);
+        startWorker(path, item.time(KFileItem::ModificationTime));
+
+        if (countsRecursiveSize()) {
+            // The sizes of the contents of the expanded parent
+            // directories contain the changed directory.
+            QUrl parentUrl = item.url().adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+            int parentIndex = m_model->index(parentUrl);
+            while (parentIndex >= 0) {
+                const KFileItem parentItem = m_model->fileItem(parentIndex);
+                startWorker(parentItem.localPath(), parentItem.time(KFileItem::ModificationTime));
+
+                parentUrl = parentUrl.adjusted(QUrl::RemoveFilename | QUrl::StripTrailingSlash);
+                parentIndex = m_model->index(parentUrl);
+            }
+        }
     }
 }
 
@@ -138,6 +140,10 @@ void KDirectoryContentsCounter::slotItemsRemoved()
 {
     const bool allItemsRemoved = (m_model->count() == 0);
 
+    if (allItemsRemoved) {
+        m_pendingDirs.clear();
+    }
+
     if (!m_watchedDirs.isEmpty()) {
         // Don't let KDirWatch watch for removed items
         if (allItemsRemoved) {
@@ -145,7 +151,6 @@ void KDirectoryContentsCounter::slotItemsRemoved()
                 m_dirWatcher->removeDir(path);
             }
             m_watchedDirs.clear();
-            m_queue.clear();
         } else {
             QMutableSetIterator<QString> it(m_watchedDirs);
             while (it.hasNext()) {
@@ -159,25 +164,38 @@ void KDirectoryContentsCounter::slotItemsRemoved()
     }
 }
 
-void KDirectoryContentsCounter::startWorker(const QString& path)
+void KDirectoryContentsCounter::startWorker(const QString& path, const QDateTime& modificationTime)
 {
-    if (m_workerIsBusy) {
-        m_queue.enqueue(path);
-    } else {
-        KDirectoryContentsCounterWorker::Options options;
+    m_pendingDirs.insert(path);
+    m_worker->countDirectoryContents(path, options(), modificationTime);
+}
 
-        if (m_model->showHiddenFiles()) {
-            options |= KDirectoryContentsCounterWorker::CountHiddenFiles;
-        }
+void KDirectoryContentsCounter::watchDirectory(const QString& path)
+{
+    if (!m_dirWatcher->contains(path)) {
+        m_dirWatcher->addDir(path);
+        m_watchedDirs.insert(path);
+    }
+}
 
-        if (m_model->showDirectoriesOnly()) {
-            options |= KDirectoryContentsCounterWorker::CountDirectoriesOnly;
-        }
+KDirectoryContentsCounterWorker::Options KDirectoryContentsCounter::options() const
+{
+    KDirectoryContentsCounterWorker::Options options;
 
-        emit requestDirectoryContentsCount(path, options);
-        m_workerIsBusy = true;
+    if (m_model->showHiddenFiles()) {
+        options |= KDirectoryContentsCounterWorker::CountHiddenFiles;
     }
+
+    if (m_model->showDirectoriesOnly()) {
+        options |= KDirectoryContentsCounterWorker::CountDirectoriesOnly;
+    }
+
+    if (m_countRecursiveSize) {
+        options |= KDirectoryContentsCounterWorker::CountRecursiveSize;
+    }
+
+    return options;
 }
 
-QThread* KDirectoryContentsCounter::m_workerThread = nullptr;
+KDirectoryContentsCounterWorker* KDirectoryContentsCounter::m_worker = nullptr;
 int KDirectoryContentsCounter::m_workersCount = 0;
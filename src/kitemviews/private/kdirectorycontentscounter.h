@@ -21,16 +21,17 @@
 #ifndef KDIRECTORYCONTENTSCOUNTER_H
 #define KDIRECTORYCONTENTSCOUNTER_H
 
+#include "dolphin_export.h"
 #include "kdirectorycontentscounterworker.h"
 
-#include <QQueue>
 #include <QSet>
 
 class KDirWatch;
+class KFileItem;
 class KFileItemModel;
 class QString;
 
-class KDirectoryContentsCounter : public QObject
+class DOLPHIN_EXPORT KDirectoryContentsCounter : public QObject
 {
     Q_OBJECT
 
@@ -39,51 +40,61 @@ public:
     ~KDirectoryContentsCounter() override;
 
     /**
-     * Requests the number of items inside the directory \a path. The actual
-     * counting is done asynchronously, and the result is announced via the
-     * signal \a result.
+     * Requests the number of items inside the local directory \a item and, if
+     * countsRecursiveSize() is true, the size of all files inside it. If the result is cached already, and the directory has not
+     * been modified since it has been counted, the result is returned.
+     * Otherwise, the count of the returned result is -1, the actual counting
+     * is done asynchronously, and the result is announced via the signal
+     * \a result.
      *
-     * The directory \a path is watched for changes, and the signal is emitted
+     * The directory is watched for changes, and the signal is emitted
      * again if a change occurs.
      */
-    void addDirectory(const QString& path);
+    KDirectoryContentsCounterWorker::CountResult addDirectory(const KFileItem& item);
 
     /**
-     * In contrast to \a addDirectory, this function counts the items inside
-     * the directory \a path synchronously and returns the result.
-     *
-     * The directory is watched for changes, and the signal \a result is
-     * emitted if a change occurs.
+     * If enabled, the size of the contents of the directories is determined
+     * in addition to the number of items. Per default only the number of
+     * items is determined.
      */
-    int countDirectoryContentsSynchronously(const QString& path);
+    void setCountRecursiveSize(bool count);
+    bool countsRecursiveSize() const;
 
 signals:
     /**
-     * Signals that the directory \a path contains \a count items.
+     * Signals that the directory \a path contains \a count items, and that
+     * the size of its contents is \a size bytes (-1 if not determined).
      */
-    void result(const QString& path, int count);
+    void result(const QString& path, int count, qint64 size);
 
-    void requestDirectoryContentsCount(const QString& path, KDirectoryContentsCounterWorker::Options options);
+    /**
+     * Signals that the size of the part of the contents of the directory
+     * \a path that has been walked so far is \a size bytes.
+     */
+    void sizeProgress(const QString& path, qint64 size);
 
 private slots:
-    void slotResult(const QString& path, int count);
+    void slotResult(const QString& path, KDirectoryContentsCounterWorker::Options options, int count, qint64 size);
+    void slotSizeProgress(const QString& path, KDirectoryContentsCounterWorker::Options options, qint64 size);
     void slotDirWatchDirty(const QString& path);
     void slotItemsRemoved();
 
 private:
-    void startWorker(const QString& path);
+    void startWorker(const QString& path, const QDateTime& modificationTime);
+    void watchDirectory(const QString& path);
+    KDirectoryContentsCounterWorker::Options options() const;
 
 private:
     KFileItemModel* m_model;
+    bool m_countRecursiveSize;
 
-    QQueue<QString> m_queue;
+    // Directories for which this counter waits for a result
+    QSet<QString> m_pendingDirs;
 
-    static QThread* m_workerThread;
+    // The worker and its cache are shared by all counters
+    static KDirectoryContentsCounterWorker* m_worker;
     static int m_workersCount;
 
-    KDirectoryContentsCounterWorker* m_worker;
-    bool m_workerIsBusy;
-
     KDirWatch* m_dirWatcher;
     QSet<QString> m_watchedDirs;    // Required as sadly KDirWatch does not offer a getter method
                                     // to get all watched directories.
@@ -20,18 +20,91 @@
 
 #include "kdirectorycontentscounterworker.h"
 
-// Required includes for subItemsCount():
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrentRun>
+
+// Required includes for subItemsCount() and walkDirectory():
 #ifdef Q_OS_WIN
     #include <QDir>
+    #include <QDirIterator>
 #else
-    #include <QFile>
     #include <qplatformdefs.h>
+
+    #include <fcntl.h>
+    #include <sys/stat.h>
 #endif
 
+namespace {
+    // Maximum number of directories that are counted in parallel. Counting
+    // is mostly waiting for I/O, so more threads than cores may be used.
+    const int MaxWorkerThreads = 4;
+
+    // Maximum number of cached results
+    const int MaxCachedCounts = 50000;
+
+    // Maximum number of cached sizes of walked sub directories
+    const int MaxCachedSubtreeSizes = 200000;
+
+    // Time in milliseconds after which the size of the contents of a directory
+    // is determined again. Changes deep inside a directory don't change its
+    // modification time, and only watched directories are invalidated.
+    const qint64 MaxCachedSizeAge = 5 * 60 * 1000;
+
+    // Interval in milliseconds for announcing the size of the
+    // contents that has been walked so far
+    const int ProgressInterval = 300;
+}
+
+struct KDirectoryContentsCounterWorker::WalkState
+{
+    // Directory that has been requested by countDirectory()
+    QString path;
+    Options options;
+
+    // File system of the requested directory
+    quint64 device;
+
+    // Size of the contents that have been walked so far
+    qint64 size;
+
+    // Device and inode numbers of the walked files that have several hard links
+    QSet<QPair<quint64, quint64> > hardLinks;
+
+    QElapsedTimer progressTimer;
+};
+
 KDirectoryContentsCounterWorker::KDirectoryContentsCounterWorker(QObject* parent) :
-    QObject(parent)
+    QObject(parent),
+    m_threadPool(nullptr),
+    m_pendingCounts(),
+    m_cache(MaxCachedCounts),
+    m_subtreeSizes(MaxCachedSubtreeSizes),
+    m_subtreeSizesMutex(),
+    m_cacheClock(),
+    m_abort(0)
 {
     qRegisterMetaType<KDirectoryContentsCounterWorker::Options>();
+
+    m_cacheClock.start();
+
+    m_threadPool = new QThreadPool(this);
+    m_threadPool->setMaxThreadCount(MaxWorkerThreads);
+
+    connect(this, &KDirectoryContentsCounterWorker::countFinished,
+            this, &KDirectoryContentsCounterWorker::slotCountFinished,
+            Qt::QueuedConnection);
+}
+
+KDirectoryContentsCounterWorker::~KDirectoryContentsCounterWorker()
+{
+    // The worker threads emit countFinished(), so they must be
+    // finished before this object is destroyed.
+    m_abort.storeRelease(1);
+    m_threadPool->clear();
+    m_threadPool->waitForDone();
 }
 
 int KDirectoryContentsCounterWorker::subItemsCount(const QString& path, Options options)
@@ -89,7 +162,267 @@ int KDirectoryContentsCounterWorker::subItemsCount(const QString& path, Options
 #endif
 }
 
-void KDirectoryContentsCounterWorker::countDirectoryContents(const QString& path, Options options)
+KDirectoryContentsCounterWorker::CountResult KDirectoryContentsCounterWorker::countDirectory(const QString& path, Options options)
+{
+    CountResult result(subItemsCount(path, options));
+    if (!(options & CountRecursiveSize) || result.count < 0) {
+        return result;
+    }
+
+#ifdef Q_OS_WIN
+    qint64 size = 0;
+    QDirIterator it(path, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (m_abort.loadAcquire()) {
+            return result;
+        }
+
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (!info.isDir()) {
+            size += info.size();
+        }
+    }
+    result.size = size;
+#else
+    const QByteArray encodedPath = QFile::encodeName(path);
+
+    struct stat buf;
+    if (::stat(encodedPath.constData(), &buf) != 0) {
+        return result;
+    }
+
+    SubtreeEntry entry;
+    entry.device = buf.st_dev;
+    entry.inode = buf.st_ino;
+    entry.modificationTime = buf.st_mtime;
+    entry.size = cachedSubtreeSize(encodedPath, entry);
+
+    if (entry.size < 0) {
+        WalkState state;
+        state.path = path;
+        state.options = options;
+        state.device = buf.st_dev;
+        state.size = 0;
+        state.progressTimer.start();
+
+        entry.size = walkDirectory(encodedPath, state);
+        if (entry.size >= 0) {
+            cacheSubtreeSize(encodedPath, entry);
+        }
+    }
+    result.size = entry.size;
+#endif
+
+    return result;
+}
+
+void KDirectoryContentsCounterWorker::countDirectoryContents(const QString& path, Options options,
+                                                             const QDateTime& modificationTime)
+{
+    const Key key(path, int(options));
+    if (m_pendingCounts.contains(key)) {
+        return;
+    }
+
+    m_pendingCounts.insert(key, modificationTime);
+    startCounting(path, options);
+}
+
+KDirectoryContentsCounterWorker::CountResult KDirectoryContentsCounterWorker::cachedResult(const QString& path, Options options,
+                                                                                          const QDateTime& modificationTime)
+{
+    const CacheEntry* entry = m_cache.object(Key(path, int(options)));
+    if (!entry || !modificationTime.isValid() || entry->modificationTime != modificationTime) {
+        return CountResult();
+    }
+
+    if ((options & CountRecursiveSize) && m_cacheClock.elapsed() - entry->cacheTime >= MaxCachedSizeAge) {
+        return CountResult();
+    }
+
+    return CountResult(entry->count, entry->size);
+}
+
+void KDirectoryContentsCounterWorker::invalidate(const QString& path)
 {
-    emit result(path, subItemsCount(path, options));
+    const int allOptions = CountHiddenFiles | CountDirectoriesOnly | CountRecursiveSize;
+
+    QString dirPath = path;
+    while (true) {
+        for (int options = NoOptions; options <= allOptions; ++options) {
+            if (dirPath != path && !(options & CountRecursiveSize)) {
+                // Only the size of the contents of a parent directory is affected
+                continue;
+            }
+
+            const Key key(dirPath, options);
+            m_cache.remove(key);
+
+            // A worker thread might have read the directory before it was changed
+            if (m_pendingCounts.contains(key)) {
+                m_outdatedCounts.insert(key);
+            }
+        }
+
+        m_subtreeSizesMutex.lock();
+        m_subtreeSizes.remove(QFile::encodeName(dirPath));
+        m_subtreeSizesMutex.unlock();
+
+        const int slashIndex = dirPath.lastIndexOf(QLatin1Char('/'));
+        if (slashIndex <= 0) {
+            break;
+        }
+        dirPath.truncate(slashIndex);
+    }
+}
+
+void KDirectoryContentsCounterWorker::slotCountFinished(const QString& path, Options options, int count, qint64 size)
+{
+    const Key key(path, int(options));
+    if (m_outdatedCounts.remove(key)) {
+        startCounting(path, options);
+        return;
+    }
+
+    const QDateTime modificationTime = m_pendingCounts.take(key);
+
+    const bool sizeKnown = (size >= 0 || !(options & CountRecursiveSize));
+    if (count >= 0 && sizeKnown && modificationTime.isValid()) {
+        CacheEntry* entry = new CacheEntry;
+        entry->count = count;
+        entry->size = size;
+        entry->modificationTime = modificationTime;
+        entry->cacheTime = m_cacheClock.elapsed();
+        m_cache.insert(key, entry);
+    }
+
+    emit result(path, options, count, size);
+}
+
+void KDirectoryContentsCounterWorker::startCounting(const QString& path, Options options)
+{
+    QtConcurrent::run(m_threadPool, [this, path, options]() {
+        const CountResult result = countDirectory(path, options);
+        emit countFinished(path, options, result.count, result.size);
+    });
+}
+
+#ifndef Q_OS_WIN
+qint64 KDirectoryContentsCounterWorker::walkDirectory(const QByteArray& path, WalkState& state)
+{
+    struct SubDirectory
+    {
+        QByteArray path;
+        SubtreeEntry entry;
+    };
+    QVector<SubDirectory> subDirectories;
+
+    qint64 size = 0;
+
+    // All entries are read before descending into the sub directories, so
+    // that only one directory is open at a time, even for deep hierarchies.
+    auto dir = QT_OPENDIR(path.constData());
+    if (!dir) {
+        return 0;
+    }
+
+    const QByteArray pathPrefix = path.endsWith('/') ? path : path + '/';
+    const int fd = dirfd(dir);
+
+    QT_DIRENT *dirEntry = nullptr;
+    while ((dirEntry = QT_READDIR(dir))) {
+        const char* name = dirEntry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            // Skip "." and ".."
+            continue;
+        }
+
+        struct stat buf;
+        if (::fstatat(fd, name, &buf, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(buf.st_mode)) {
+            // Like "du -x", don't descend into directories on other file systems
+            if (quint64(buf.st_dev) == state.device) {
+                SubDirectory subDirectory;
+                subDirectory.path = pathPrefix + name;
+                subDirectory.entry.device = buf.st_dev;
+                subDirectory.entry.inode = buf.st_ino;
+                subDirectory.entry.modificationTime = buf.st_mtime;
+                subDirectory.entry.size = -1;
+                subDirectories.append(subDirectory);
+            }
+        } else {
+            if (buf.st_nlink > 1) {
+                // Count files with several hard links only once
+                const QPair<quint64, quint64> id(buf.st_dev, buf.st_ino);
+                if (state.hardLinks.contains(id)) {
+                    continue;
+                }
+                state.hardLinks.insert(id);
+            }
+            size += buf.st_size;
+        }
+    }
+    QT_CLOSEDIR(dir);
+
+    state.size += size;
+
+    foreach (const SubDirectory& subDirectory, subDirectories) {
+        if (m_abort.loadAcquire()) {
+            return -1;
+        }
+
+        SubtreeEntry entry = subDirectory.entry;
+        entry.size = cachedSubtreeSize(subDirectory.path, entry);
+        if (entry.size >= 0) {
+            state.size += entry.size;
+        } else {
+            entry.size = walkDirectory(subDirectory.path, state);
+            if (entry.size < 0) {
+                return -1;
+            }
+            cacheSubtreeSize(subDirectory.path, entry);
+        }
+        size += entry.size;
+
+        if (state.progressTimer.elapsed() >= ProgressInterval) {
+            emit sizeProgress(state.path, state.options, state.size);
+            state.progressTimer.restart();
+        }
+    }
+
+    return size;
+}
+#endif
+
+qint64 KDirectoryContentsCounterWorker::cachedSubtreeSize(const QByteArray& path, const SubtreeEntry& entry)
+{
+    QMutexLocker locker(&m_subtreeSizesMutex);
+
+    // The modification time of a directory changes if entries are added,
+    // removed or renamed. Changes of files deeper inside are noticed by the
+    // KDirWatch of KDirectoryContentsCounter, which invokes invalidate(), but
+    // only for watched directories. Hence the cached sizes expire as well.
+    const SubtreeEntry* cachedEntry = m_subtreeSizes.object(path);
+    if (cachedEntry
+        && cachedEntry->device == entry.device
+        && cachedEntry->inode == entry.inode
+        && cachedEntry->modificationTime == entry.modificationTime
+        && m_cacheClock.elapsed() - cachedEntry->cacheTime < MaxCachedSizeAge) {
+        return cachedEntry->size;
+    }
+    return -1;
+}
+
+void KDirectoryContentsCounterWorker::cacheSubtreeSize(const QByteArray& path, const SubtreeEntry& entry)
+{
+    SubtreeEntry* cachedEntry = new SubtreeEntry(entry);
+    cachedEntry->cacheTime = m_cacheClock.elapsed();
+
+    QMutexLocker locker(&m_subtreeSizesMutex);
+    m_subtreeSizes.insert(path, cachedEntry);
 }
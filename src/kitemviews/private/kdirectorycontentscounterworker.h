@@ -20,11 +20,42 @@
 #ifndef KDIRECTORYCONTENTSCOUNTERWORKER_H
 #define KDIRECTORYCONTENTSCOUNTERWORKER_H
 
+#include <QAtomicInt>
+#include <QCache>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMetaType>
+#include <QMutex>
 #include <QObject>
+#include <QPair>
+#include <QSet>
 
 class QString;
+class QThreadPool;
 
+/**
+ * @brief Counts the items inside directories for all KDirectoryContentsCounter instances.
+ *
+ * The counting is done in a bounded thread pool, so that several directories
+ * can be counted in parallel, which is much faster than counting them one
+ * after the other on network file systems. A directory that is being counted
+ * already is not counted again if it is requested by another view.
+ *
+ * The results are stored in a cache, together with the modification time of
+ * the directory. A cached result is only valid as long as the modification
+ * time is unchanged. The least recently used results are removed from the
+ * cache if it is full.
+ *
+ * If the option CountRecursiveSize is used, the size of all files inside the
+ * directory and its sub directories is determined too. Sub directories on
+ * other file systems are skipped. The sizes of all walked sub directories are
+ * cached as well, so that the size of a parent directory can be determined
+ * from the cached sizes of its children. As changes deep inside a directory
+ * are not reflected by its modification time, the cached sizes expire after
+ * a few minutes. While a directory is walked, the signal sizeProgress()
+ * announces the size that has been determined so far.
+ */
 class KDirectoryContentsCounterWorker : public QObject
 {
     Q_OBJECT
@@ -33,11 +64,23 @@ public:
     enum Option {
         NoOptions = 0x0,
         CountHiddenFiles = 0x1,
-        CountDirectoriesOnly = 0x2
+        CountDirectoriesOnly = 0x2,
+        CountRecursiveSize = 0x4
     };
     Q_DECLARE_FLAGS(Options, Option)
 
+    struct CountResult
+    {
+        CountResult(int count = -1, qint64 size = -1) : count(count), size(size) {}
+
+        /** Number of items inside the directory or -1 if unknown. */
+        int count;
+        /** Size of the contents in bytes or -1 if unknown or not requested. */
+        qint64 size;
+    };
+
     explicit KDirectoryContentsCounterWorker(QObject* parent = nullptr);
+    ~KDirectoryContentsCounterWorker() override;
 
     /**
      * Counts the items inside the directory \a path using the options
@@ -47,21 +90,123 @@ public:
      */
     static int subItemsCount(const QString& path, Options options);
 
-signals:
     /**
-     * Signals that the directory \a path contains \a count items.
+     * Counts the items inside the directory \a path using the options
+     * \a options, and determines the size of its contents if the option
+     * CountRecursiveSize is used. Can be invoked from any thread.
      */
-    void result(const QString& path, int count);
+    CountResult countDirectory(const QString& path, Options options);
 
-public slots:
     /**
      * Requests the number of items inside the directory \a path using the
-     * options \a options. The result is announced via the signal \a result.
+     * options \a options. The counting is done in a worker thread, and the
+     * result is announced via the signal \a result. If the directory is being
+     * counted already, only one signal is emitted.
+     *
+     * The result is cached for the modification time \a modificationTime
+     * of the directory.
+     */
+    void countDirectoryContents(const QString& path, Options options, const QDateTime& modificationTime);
+
+    /**
+     * @return The cached result for the directory \a path and the options
+     *         \a options. The count is -1 if the result is unknown, or if
+     *         the directory has been modified since it has been counted.
+     */
+    CountResult cachedResult(const QString& path, Options options, const QDateTime& modificationTime);
+
+    /**
+     * Removes the cached results for the directory \a path. As the size
+     * of the contents of the parent directories has been changed too,
+     * their cached sizes are removed as well.
+     */
+    void invalidate(const QString& path);
+
+signals:
+    /**
+     * Signals that the directory \a path contains \a count items, and that
+     * the size of its contents is \a size bytes (-1 if the option
+     * CountRecursiveSize is not used).
      */
     // Note that the full type name KDirectoryContentsCounterWorker::Options
     // is needed here. Just using 'Options' is OK for the compiler, but
     // confuses moc.
-    void countDirectoryContents(const QString& path, KDirectoryContentsCounterWorker::Options options);
+    void result(const QString& path, KDirectoryContentsCounterWorker::Options options, int count, qint64 size);
+
+    /**
+     * Is emitted periodically by the worker threads while the size of the
+     * contents of the directory \a path is determined. \a size is the size of
+     * the part of the contents that has been walked so far.
+     */
+    void sizeProgress(const QString& path, KDirectoryContentsCounterWorker::Options options, qint64 size);
+
+    /**
+     * Is emitted by the worker threads. Only for internal use.
+     */
+    void countFinished(const QString& path, KDirectoryContentsCounterWorker::Options options, int count, qint64 size);
+
+private slots:
+    void slotCountFinished(const QString& path, KDirectoryContentsCounterWorker::Options options, int count, qint64 size);
+
+private:
+    struct WalkState;
+
+    struct SubtreeEntry
+    {
+        quint64 device;
+        quint64 inode;
+        qint64 modificationTime;
+        qint64 size;
+        qint64 cacheTime;   // Value of m_cacheClock when the size has been cached
+    };
+
+    void startCounting(const QString& path, Options options);
+
+    /**
+     * @return The size of the contents of the directory \a path
+     *         or -1 if the walk has been aborted.
+     */
+    qint64 walkDirectory(const QByteArray& path, WalkState& state);
+
+    /**
+     * @return The cached size of the contents of the directory \a path or -1 if
+     *         the device, inode or modification time of \a entry do not match,
+     *         or if the size has expired. Can be invoked from any thread.
+     */
+    qint64 cachedSubtreeSize(const QByteArray& path, const SubtreeEntry& entry);
+    void cacheSubtreeSize(const QByteArray& path, const SubtreeEntry& entry);
+
+private:
+    typedef QPair<QString, int> Key;
+
+    struct CacheEntry
+    {
+        int count;
+        qint64 size;
+        QDateTime modificationTime;
+        qint64 cacheTime;   // Value of m_cacheClock when the result has been cached
+    };
+
+    QThreadPool* m_threadPool;
+
+    // Directories which are being counted, and their modification times
+    QHash<Key, QDateTime> m_pendingCounts;
+
+    // Directories which have been changed while being counted
+    QSet<Key> m_outdatedCounts;
+
+    QCache<Key, CacheEntry> m_cache;
+
+    // Sizes of all walked directories, keyed by the encoded path. Used by the
+    // worker threads and hence protected by m_subtreeSizesMutex.
+    QCache<QByteArray, SubtreeEntry> m_subtreeSizes;
+    QMutex m_subtreeSizesMutex;
+
+    // Determines the age of the cached sizes. Only read by the worker threads.
+    QElapsedTimer m_cacheClock;
+
+    // Set if the worker threads should stop walking directories
+    QAtomicInt m_abort;
 };
 
 Q_DECLARE_METATYPE(KDirectoryContentsCounterWorker::Options)
@@ -0,0 +1,223 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kdirectoryprefetcher.h"
+
+#include "kmimetyperesolver.h"
+
+#include <KCoreDirLister>
+
+namespace {
+    // Maximum number of directories that are prefetched at the same time
+    const int MaximumDirectoryCount = 3;
+
+    // Maximum number of items that are kept for all prefetched directories.
+    // The listing of a directory is stopped if the budget is exceeded.
+    const int MaximumItemCount = 20000;
+
+    // Number of items per directory whose MIME types are determined. This
+    // covers the items that are visible after entering the directory.
+    const int ResolvedItemCount = 200;
+}
+
+KDirectoryPrefetcher::KDirectoryPrefetcher(QObject* parent) :
+    QObject(parent),
+    m_directories(),
+    m_itemCount(0)
+{
+}
+
+KDirectoryPrefetcher::~KDirectoryPrefetcher()
+{
+    while (!m_directories.isEmpty()) {
+        removeDirectory(m_directories.first());
+    }
+}
+
+void KDirectoryPrefetcher::prefetch(const QUrl& url)
+{
+    const QUrl directoryUrl = url.adjusted(QUrl::StripTrailingSlash);
+    for (int i = 0; i < m_directories.count(); ++i) {
+        if (m_directories.at(i)->url == directoryUrl) {
+            m_directories.move(i, 0);
+            return;
+        }
+    }
+
+    while (m_directories.count() >= MaximumDirectoryCount) {
+        removeDirectory(m_directories.last());
+    }
+
+    Directory* directory = new Directory();
+    directory->url = directoryUrl;
+    directory->lister = new KCoreDirLister(this);
+    directory->lister->setDelayedMimeTypes(true);
+    directory->resolver = new KMimeTypeResolver(this);
+    directory->itemCount = 0;
+    directory->listingFinished = false;
+    m_directories.prepend(directory);
+
+    connect(directory->lister, &KCoreDirLister::itemsAdded, this, &KDirectoryPrefetcher::slotItemsAdded);
+    connect(directory->lister, static_cast<void(KCoreDirLister::*)()>(&KCoreDirLister::completed), this, &KDirectoryPrefetcher::slotListingFinished);
+    connect(directory->lister, static_cast<void(KCoreDirLister::*)()>(&KCoreDirLister::canceled), this, &KDirectoryPrefetcher::slotListingFinished);
+    connect(directory->resolver, &KMimeTypeResolver::mimeTypesResolved, this, &KDirectoryPrefetcher::slotMimeTypesResolved);
+
+    directory->lister->openUrl(directoryUrl);
+}
+
+QHash<QUrl, KFileItem> KDirectoryPrefetcher::takeItems(const QUrl& url)
+{
+    const QUrl directoryUrl = url.adjusted(QUrl::StripTrailingSlash);
+    QHash<QUrl, KFileItem> items;
+
+    foreach (Directory* directory, m_directories) {
+        if (directory->url == directoryUrl) {
+            QHashIterator<QUrl, KFileItem> it(directory->items);
+            while (it.hasNext()) {
+                it.next();
+                if (it.value().isMimeTypeKnown()) {
+                    items.insert(it.key(), it.value());
+                }
+            }
+            removeDirectory(directory);
+            break;
+        }
+    }
+
+    return items;
+}
+
+bool KDirectoryPrefetcher::isPrefetched(const QUrl& url) const
+{
+    const QUrl directoryUrl = url.adjusted(QUrl::StripTrailingSlash);
+    foreach (const Directory* directory, m_directories) {
+        if (directory->url == directoryUrl) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int KDirectoryPrefetcher::itemCount() const
+{
+    return m_itemCount;
+}
+
+void KDirectoryPrefetcher::slotItemsAdded(const QUrl& directoryUrl, const KFileItemList& items)
+{
+    Q_UNUSED(directoryUrl);
+
+    Directory* directory = directoryForLister(sender());
+    if (!directory) {
+        return;
+    }
+
+    directory->itemCount += items.count();
+    m_itemCount += items.count();
+
+    const int resolvableCount = ResolvedItemCount - directory->items.count();
+    if (resolvableCount > 0) {
+        const KFileItemList firstItems = items.mid(0, resolvableCount);
+        foreach (const KFileItem& item, firstItems) {
+            directory->items.insert(item.url(), item);
+        }
+        directory->resolver->resolve(firstItems);
+    }
+
+    if (m_itemCount > MaximumItemCount) {
+        // Drop the least recently requested directories first. If the
+        // directory itself exceeds the budget, its listing is stopped,
+        // but the first items are kept.
+        while (m_itemCount > MaximumItemCount && m_directories.last() != directory) {
+            removeDirectory(m_directories.last());
+        }
+        if (m_itemCount > MaximumItemCount && !directory->listingFinished) {
+            directory->listingFinished = true;
+            directory->lister->stop();
+            checkCompleted(directory);
+        }
+    }
+}
+
+void KDirectoryPrefetcher::slotListingFinished()
+{
+    Directory* directory = directoryForLister(sender());
+    if (directory && !directory->listingFinished) {
+        directory->listingFinished = true;
+        checkCompleted(directory);
+    }
+}
+
+void KDirectoryPrefetcher::slotMimeTypesResolved(const QHash<QUrl, KFileItem>& items)
+{
+    Directory* directory = directoryForResolver(sender());
+    if (!directory) {
+        return;
+    }
+
+    QHashIterator<QUrl, KFileItem> it(items);
+    while (it.hasNext()) {
+        it.next();
+        directory->items.insert(it.key(), it.value());
+    }
+
+    checkCompleted(directory);
+}
+
+KDirectoryPrefetcher::Directory* KDirectoryPrefetcher::directoryForLister(const QObject* lister) const
+{
+    foreach (Directory* directory, m_directories) {
+        if (directory->lister == lister) {
+            return directory;
+        }
+    }
+    return nullptr;
+}
+
+KDirectoryPrefetcher::Directory* KDirectoryPrefetcher::directoryForResolver(const QObject* resolver) const
+{
+    foreach (Directory* directory, m_directories) {
+        if (directory->resolver == resolver) {
+            return directory;
+        }
+    }
+    return nullptr;
+}
+
+void KDirectoryPrefetcher::checkCompleted(Directory* directory)
+{
+    if (directory->listingFinished && !directory->resolver->isResolving()) {
+        emit prefetchingCompleted(directory->url);
+    }
+}
+
+void KDirectoryPrefetcher::removeDirectory(Directory* directory)
+{
+    m_directories.removeOne(directory);
+    m_itemCount -= directory->itemCount;
+
+    // The lister is deleted later: If the directory is entered, the lister
+    // of the view opens the same URL first and gets the items from the
+    // KIO dir lister cache instead of listing the directory again.
+    directory->lister->disconnect(this);
+    directory->lister->deleteLater();
+    directory->resolver->disconnect(this);
+    directory->resolver->deleteLater();
+    delete directory;
+}
@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef KDIRECTORYPREFETCHER_H
+#define KDIRECTORYPREFETCHER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QUrl>
+
+class KCoreDirLister;
+class KMimeTypeResolver;
+
+/**
+ * @brief Lists directories that are likely to be entered next in the background.
+ *
+ * When the user hovers a folder or makes it the current item, it is quite
+ * likely that the folder is entered soon. KDirectoryPrefetcher lists such a
+ * folder with its own dir lister, which also fills the KIO dir lister cache,
+ * and determines the MIME types of the first items. When the folder is
+ * entered, takeItems() hands the resolved items over to the KFileItemModel
+ * (see KFileItemModel::setPrefetchedItems()), which can show the items with
+ * their final icons immediately.
+ *
+ * To limit the memory usage, only a few directories with a limited number of
+ * items are kept. The least recently requested directory is dropped first.
+ */
+class DOLPHIN_EXPORT KDirectoryPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KDirectoryPrefetcher(QObject* parent = nullptr);
+    ~KDirectoryPrefetcher() override;
+
+    /**
+     * Starts listing the directory \a url in the background, unless it is
+     * being prefetched already. Directories that contain more items than the
+     * memory budget allows are not prefetched completely.
+     */
+    void prefetch(const QUrl& url);
+
+    /**
+     * @return The prefetched items of the directory \a url whose MIME types
+     *         are known, with their URLs as keys. The directory is removed
+     *         from the prefetcher.
+     */
+    QHash<QUrl, KFileItem> takeItems(const QUrl& url);
+
+    /**
+     * @return True if the directory \a url is being prefetched or has been
+     *         prefetched already.
+     */
+    bool isPrefetched(const QUrl& url) const;
+
+    /**
+     * @return Number of items that are kept for all prefetched directories.
+     */
+    int itemCount() const;
+
+signals:
+    /**
+     * Is emitted when the directory \a url has been listed and the MIME
+     * types of its first items have been determined.
+     */
+    void prefetchingCompleted(const QUrl& url);
+
+private slots:
+    void slotItemsAdded(const QUrl& directoryUrl, const KFileItemList& items);
+    void slotListingFinished();
+    void slotMimeTypesResolved(const QHash<QUrl, KFileItem>& items);
+
+private:
+    struct Directory
+    {
+        QUrl url;
+        KCoreDirLister* lister;
+        KMimeTypeResolver* resolver;
+        QHash<QUrl, KFileItem> items;
+        int itemCount;
+        bool listingFinished;
+    };
+
+    Directory* directoryForLister(const QObject* lister) const;
+    Directory* directoryForResolver(const QObject* resolver) const;
+    void checkCompleted(Directory* directory);
+    void removeDirectory(Directory* directory);
+
+private:
+    // Most recently requested directory first
+    QList<Directory*> m_directories;
+    int m_itemCount;
+};
+
+#endif
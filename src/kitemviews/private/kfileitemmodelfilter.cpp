@@ -22,13 +22,26 @@
 
 #include <KFileItem>
 
+#include <QRegExp>
+
+#include <algorithm>
+
+namespace {
+    // Bit i of a state in matchesWildcard() is set if the first i tokens
+    // match the text that has been processed so far. The last bit is
+    // reserved for the state "all tokens matched".
+    const int MaxWildcardTokens = 63;
+}
 
 KFileItemModelFilter::KFileItemModelFilter() :
-    m_useRegExp(false),
+    m_patternType(NoPattern),
     m_regExp(nullptr),
-    m_lowerCasePattern(),
+    m_matcher(),
+    m_wildcardTokens(),
+    m_anyStringMask(0),
     m_pattern()
 {
+    std::fill(m_asciiMasks, m_asciiMasks + 128, 0);
 }
 
 KFileItemModelFilter::~KFileItemModelFilter()
@@ -40,9 +53,15 @@ KFileItemModelFilter::~KFileItemModelFilter()
 void KFileItemModelFilter::setPattern(const QString& filter)
 {
     m_pattern = filter;
-    m_lowerCasePattern = filter.toLower();
+    m_wildcardTokens.clear();
 
-    if (filter.contains('*') || filter.contains('?') || filter.contains('[')) {
+    if (filter.isEmpty()) {
+        m_patternType = NoPattern;
+    } else if (!filter.contains('*') && !filter.contains('?') && !filter.contains('[')) {
+        m_patternType = SubStringPattern;
+    } else if (compileWildcard(filter)) {
+        m_patternType = WildcardPattern;
+    } else {
         if (!m_regExp) {
             m_regExp = new QRegExp();
             m_regExp->setCaseSensitivity(Qt::CaseInsensitive);
@@ -50,9 +69,12 @@ void KFileItemModelFilter::setPattern(const QString& filter)
             m_regExp->setPatternSyntax(QRegExp::WildcardUnix);
         }
         m_regExp->setPattern(filter);
-        m_useRegExp = m_regExp->isValid();
-    } else {
-        m_useRegExp = false;
+        m_patternType = m_regExp->isValid() ? RegExpPattern : SubStringPattern;
+    }
+
+    if (m_patternType == SubStringPattern) {
+        m_matcher.setPattern(filter);
+        m_matcher.setCaseSensitivity(Qt::CaseInsensitive);
     }
 }
 
@@ -61,6 +83,22 @@ QString KFileItemModelFilter::pattern() const
     return m_pattern;
 }
 
+bool KFileItemModelFilter::narrows(const QString& previousPattern) const
+{
+    if (previousPattern.isEmpty()) {
+        return true;
+    }
+
+    if (m_patternType != SubStringPattern
+        || previousPattern.contains('*') || previousPattern.contains('?') || previousPattern.contains('[')) {
+        return false;
+    }
+
+    // Every text that contains the current sub-string also contains
+    // all sub-strings of it.
+    return m_pattern.contains(previousPattern, Qt::CaseInsensitive);
+}
+
 void KFileItemModelFilter::setMimeTypes(const QStringList& types)
 {
     m_mimeTypes = types;
@@ -102,10 +140,17 @@ bool KFileItemModelFilter::matches(const KFileItem& item) const
 
 bool KFileItemModelFilter::matchesPattern(const KFileItem& item) const
 {
-    if (m_useRegExp) {
+    switch (m_patternType) {
+    case SubStringPattern:
+        // QStringMatcher compares case folded characters and does not
+        // need to create a lower case copy of the text.
+        return m_matcher.indexIn(item.text()) >= 0;
+    case WildcardPattern:
+        return matchesWildcard(item.text());
+    case RegExpPattern:
         return m_regExp->exactMatch(item.text());
-    } else {
-        return item.text().toLower().contains(m_lowerCasePattern);
+    default:
+        return true;
     }
 }
 
@@ -119,3 +164,146 @@ bool KFileItemModelFilter::matchesType(const KFileItem& item) const
 
     return m_mimeTypes.isEmpty();
 }
+
+bool KFileItemModelFilter::compileWildcard(const QString& pattern)
+{
+    m_wildcardTokens.clear();
+    m_anyStringMask = 0;
+
+    const int length = pattern.length();
+    int i = 0;
+    while (i < length) {
+        WildcardToken token;
+        token.type = WildcardToken::Character;
+        token.negated = false;
+
+        const QChar c = pattern.at(i);
+        if (c == QLatin1Char('*')) {
+            ++i;
+            if (!m_wildcardTokens.isEmpty() && m_wildcardTokens.last().type == WildcardToken::AnyString) {
+                // "**" is equivalent to "*"
+                continue;
+            }
+            token.type = WildcardToken::AnyString;
+        } else if (c == QLatin1Char('?')) {
+            token.type = WildcardToken::AnyCharacter;
+            ++i;
+        } else if (c == QLatin1Char('[')) {
+            token.type = WildcardToken::Set;
+            ++i;
+            if (i < length && (pattern.at(i) == QLatin1Char('!') || pattern.at(i) == QLatin1Char('^'))) {
+                token.negated = true;
+                ++i;
+            }
+
+            // A ']' directly after the opening bracket is part of the set.
+            bool first = true;
+            while (i < length && (first || pattern.at(i) != QLatin1Char(']'))) {
+                first = false;
+                const QChar from = pattern.at(i).toCaseFolded();
+                QChar to = from;
+                if (i + 2 < length && pattern.at(i + 1) == QLatin1Char('-') && pattern.at(i + 2) != QLatin1Char(']')) {
+                    to = pattern.at(i + 2).toCaseFolded();
+                    i += 2;
+                }
+                token.ranges.append(qMakePair(from, to));
+                ++i;
+            }
+
+            if (i >= length) {
+                // The set is not closed
+                return false;
+            }
+            ++i;
+        } else {
+            if (c == QLatin1Char('\\') && i + 1 < length) {
+                ++i;
+            }
+            token.character = pattern.at(i).toCaseFolded();
+            ++i;
+        }
+
+        if (m_wildcardTokens.count() == MaxWildcardTokens) {
+            return false;
+        }
+
+        if (token.type == WildcardToken::AnyString) {
+            m_anyStringMask |= quint64(1) << m_wildcardTokens.count();
+        }
+        m_wildcardTokens.append(token);
+    }
+
+    for (ushort ascii = 0; ascii < 128; ++ascii) {
+        m_asciiMasks[ascii] = 0;
+        for (int index = 0; index < m_wildcardTokens.count(); ++index) {
+            if (m_wildcardTokens.at(index).matches(QChar(ascii).toCaseFolded())) {
+                m_asciiMasks[ascii] |= quint64(1) << index;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool KFileItemModelFilter::matchesWildcard(const QString& text) const
+{
+    const quint64 matchedAll = quint64(1) << m_wildcardTokens.count();
+
+    // A '*' may match the empty string, hence the position after it can be
+    // reached without consuming a character. Note that compileWildcard()
+    // merges subsequent '*', so one shift is sufficient.
+    quint64 state = 1;
+    state |= (state & m_anyStringMask) << 1;
+
+    const QChar* c = text.constData();
+    const QChar* end = c + text.length();
+    for (; c != end; ++c) {
+        state = ((state & characterMask(*c)) << 1) | (state & m_anyStringMask);
+        state |= (state & m_anyStringMask) << 1;
+        if (state == 0) {
+            return false;
+        }
+    }
+
+    return (state & matchedAll) != 0;
+}
+
+quint64 KFileItemModelFilter::characterMask(QChar c) const
+{
+    const ushort unicode = c.unicode();
+    if (unicode < 128) {
+        return m_asciiMasks[unicode];
+    }
+
+    const QChar folded = c.toCaseFolded();
+    quint64 mask = 0;
+    for (int index = 0; index < m_wildcardTokens.count(); ++index) {
+        if (m_wildcardTokens.at(index).matches(folded)) {
+            mask |= quint64(1) << index;
+        }
+    }
+    return mask;
+}
+
+bool KFileItemModelFilter::WildcardToken::matches(QChar c) const
+{
+    switch (type) {
+    case Character:
+        return c == character;
+    case AnyCharacter:
+        return true;
+    case Set: {
+        bool inSet = false;
+        for (const QPair<QChar, QChar>& range : ranges) {
+            if (c >= range.first && c <= range.second) {
+                inSet = true;
+                break;
+            }
+        }
+        return inSet != negated;
+    }
+    default:
+        // A '*' never consumes a character by moving to the next token.
+        return false;
+    }
+}
@@ -24,6 +24,8 @@
 #include "dolphin_export.h"
 
 #include <QStringList>
+#include <QStringMatcher>
+#include <QVector>
 
 class KFileItem;
 class QRegExp;
@@ -47,11 +49,21 @@ public:
      * Sets the pattern that is used for a comparison with the item
      * in KFileItemModelFilter::matches(). Per default the pattern
      * defines a sub-string. As soon as the pattern contains at least
-     * a '*', '?' or '[' the pattern represents a regular expression.
+     * a '*', '?' or '[' the pattern represents a wildcard expression.
+     * The comparison is case insensitive.
      */
     void setPattern(const QString& pattern);
     QString pattern() const;
 
+    /**
+     * @return True if every item that matches the current pattern also
+     *         matches \a previousPattern. In this case changing the pattern
+     *         from \a previousPattern to the current one can only hide
+     *         items, e.g. if the user has appended a character to a
+     *         sub-string pattern.
+     */
+    bool narrows(const QString& previousPattern) const;
+
     /**
      * Set the list of mimetypes that are used for comparison with the
      * item in KFileItemModelFilter::matchesMimeType.
@@ -81,11 +93,58 @@ private:
      */
     bool matchesType(const KFileItem& item) const;
 
-    bool m_useRegExp;           // If true, m_regExp is used for filtering,
-                                // otherwise m_lowerCaseFilter is used.
+    /**
+     * Translates the wildcard expression \a pattern into m_wildcardTokens
+     * and the bit masks that are used by matchesWildcard().
+     * @return False if the pattern is invalid or too long.
+     */
+    bool compileWildcard(const QString& pattern);
+
+    /**
+     * @return True if the whole \a text matches the compiled wildcard
+     *         expression. All positions in the expression that can be
+     *         reached are tracked as bits of one integer, so every character
+     *         of \a text is processed in constant time.
+     */
+    bool matchesWildcard(const QString& text) const;
+
+    /**
+     * @return Bit mask of the tokens that match the case folded character \a c.
+     */
+    quint64 characterMask(QChar c) const;
+
+    struct WildcardToken
+    {
+        enum Type {
+            Character,    // A literal character
+            AnyCharacter, // '?'
+            Set,          // '[...]'
+            AnyString     // '*'
+        };
+
+        Type type;
+        QChar character;
+        QVector<QPair<QChar, QChar> > ranges; // Ranges of a set
+        bool negated;                         // True for '[!...]' and '[^...]'
+
+        bool matches(QChar c) const;
+    };
+
+    enum PatternType {
+        NoPattern,
+        SubStringPattern,
+        WildcardPattern,
+        RegExpPattern     // Wildcard expression with more tokens than bits in m_anyStringMask
+    };
+
+    PatternType m_patternType;
     QRegExp* m_regExp;
-    QString m_lowerCasePattern; // Lowercase version of m_filter for
-                                // faster comparison in matches().
+    QStringMatcher m_matcher;   // Case insensitive sub-string search for m_pattern.
+
+    QVector<WildcardToken> m_wildcardTokens;
+    quint64 m_anyStringMask;    // Bits of the tokens with the type AnyString
+    quint64 m_asciiMasks[128];  // Result of characterMask() for ASCII characters
+
     QString m_pattern;          // Property set by setPattern().
     QStringList m_mimeTypes;    // Property set by setMimeTypes()
 };
@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kfileitemmodelrolestore.h"
+
+#include <algorithm>
+#include <limits>
+
+const qint64 KFileItemModelRoleStore::NoNumber = std::numeric_limits<qint64>::min();
+
+KFileItemModelRoleStore::KFileItemModelRoleStore() :
+    m_slotCount(0),
+    m_freeSlots(),
+    m_versions(),
+    m_flags(),
+    m_strings(),
+    m_idsForStrings()
+{
+    std::fill(m_flagCounts, m_flagCounts + MaximumFlagCount, 0);
+}
+
+KFileItemModelRoleStore::Column KFileItemModelRoleStore::columnForRole(const QByteArray& role)
+{
+    static QHash<QByteArray, Column> columns;
+    if (columns.isEmpty()) {
+        for (int i = 0; i < ColumnCount; ++i) {
+            const Column column = static_cast<Column>(i);
+            columns.insert(roleForColumn(column), column);
+        }
+    }
+
+    return columns.value(role, NoColumn);
+}
+
+QByteArray KFileItemModelRoleStore::roleForColumn(Column column)
+{
+    switch (column) {
+    case SizeColumn:             return QByteArrayLiteral("size");
+    case ContentsSizeColumn:     return QByteArrayLiteral("contentsSize");
+    case ModificationTimeColumn: return QByteArrayLiteral("modificationtime");
+    case CreationTimeColumn:     return QByteArrayLiteral("creationtime");
+    case AccessTimeColumn:       return QByteArrayLiteral("accesstime");
+    case DeletionTimeColumn:     return QByteArrayLiteral("deletiontime");
+    case TypeColumn:             return QByteArrayLiteral("type");
+    case OwnerColumn:            return QByteArrayLiteral("owner");
+    case GroupColumn:            return QByteArrayLiteral("group");
+    case PermissionsColumn:      return QByteArrayLiteral("permissions");
+    case VersionColumn:          return QByteArrayLiteral("version");
+    default:                     break;
+    }
+
+    return QByteArray();
+}
+
+int KFileItemModelRoleStore::allocateSlot()
+{
+    if (!m_freeSlots.isEmpty()) {
+        return m_freeSlots.takeLast();
+    }
+
+    for (int i = 0; i < NumberColumnCount; ++i) {
+        m_numbers[i].append(NoNumber);
+    }
+    for (int i = 0; i < StringColumnCount; ++i) {
+        m_stringIds[i].append(NoString);
+    }
+    m_versions.append(NoVersion);
+    m_flags.append(0);
+
+    return m_slotCount++;
+}
+
+void KFileItemModelRoleStore::releaseSlot(int slot)
+{
+    Q_ASSERT(slot >= 0 && slot < m_slotCount);
+    resetSlot(slot);
+    resetFlags(slot);
+    m_freeSlots.append(slot);
+}
+
+void KFileItemModelRoleStore::clear()
+{
+    m_slotCount = 0;
+    m_freeSlots.clear();
+
+    for (int i = 0; i < NumberColumnCount; ++i) {
+        m_numbers[i].clear();
+    }
+    for (int i = 0; i < StringColumnCount; ++i) {
+        m_stringIds[i].clear();
+    }
+    m_versions.clear();
+
+    m_flags.clear();
+    std::fill(m_flagCounts, m_flagCounts + MaximumFlagCount, 0);
+
+    m_strings.clear();
+    m_idsForStrings.clear();
+}
+
+bool KFileItemModelRoleStore::contains(int slot, Column column) const
+{
+    if (isNumberColumn(column)) {
+        return number(slot, column) != NoNumber;
+    } else if (isStringColumn(column)) {
+        return stringId(slot, column) != NoString;
+    } else if (column == VersionColumn) {
+        return version(slot) != NoVersion;
+    }
+
+    return false;
+}
+
+void KFileItemModelRoleStore::resetSlot(int slot)
+{
+    for (int i = 0; i < NumberColumnCount; ++i) {
+        m_numbers[i][slot] = NoNumber;
+    }
+    for (int i = 0; i < StringColumnCount; ++i) {
+        m_stringIds[i][slot] = NoString;
+    }
+    m_versions[slot] = NoVersion;
+}
+
+void KFileItemModelRoleStore::reset(int slot, Column column)
+{
+    if (isNumberColumn(column)) {
+        m_numbers[column - SizeColumn][slot] = NoNumber;
+    } else if (isStringColumn(column)) {
+        m_stringIds[column - TypeColumn][slot] = NoString;
+    } else if (column == VersionColumn) {
+        m_versions[slot] = NoVersion;
+    }
+}
+
+void KFileItemModelRoleStore::setNumber(int slot, Column column, qint64 value)
+{
+    Q_ASSERT(isNumberColumn(column));
+    m_numbers[column - SizeColumn][slot] = value;
+}
+
+void KFileItemModelRoleStore::setString(int slot, Column column, const QString& value)
+{
+    Q_ASSERT(isStringColumn(column));
+    m_stringIds[column - TypeColumn][slot] = internString(value);
+}
+
+void KFileItemModelRoleStore::setVersion(int slot, int version)
+{
+    Q_ASSERT(version >= NoVersion && version <= std::numeric_limits<qint8>::max());
+    m_versions[slot] = static_cast<qint8>(version);
+}
+
+void KFileItemModelRoleStore::setFlag(int slot, int flag, bool set)
+{
+    Q_ASSERT(flag >= 0 && flag < MaximumFlagCount);
+    const quint8 bit = 1 << flag;
+    quint8& flags = m_flags[slot];
+    if (set != bool(flags & bit)) {
+        flags ^= bit;
+        m_flagCounts[flag] += set ? 1 : -1;
+    }
+}
+
+void KFileItemModelRoleStore::resetFlag(int flag)
+{
+    Q_ASSERT(flag >= 0 && flag < MaximumFlagCount);
+    if (m_flagCounts[flag] == 0) {
+        return;
+    }
+
+    const quint8 mask = ~(1 << flag);
+    for (int slot = 0; slot < m_slotCount; ++slot) {
+        m_flags[slot] &= mask;
+    }
+    m_flagCounts[flag] = 0;
+}
+
+void KFileItemModelRoleStore::resetFlags(int slot)
+{
+    quint8& flags = m_flags[slot];
+    for (int flag = 0; flags != 0; ++flag) {
+        if (flags & (1 << flag)) {
+            --m_flagCounts[flag];
+            flags &= ~(1 << flag);
+        }
+    }
+}
+
+int KFileItemModelRoleStore::internString(const QString& value)
+{
+    const QHash<QString, int>::const_iterator it = m_idsForStrings.constFind(value);
+    if (it != m_idsForStrings.constEnd()) {
+        return it.value();
+    }
+
+    const int id = m_strings.count();
+    m_strings.append(value);
+    m_idsForStrings.insert(value, id);
+    return id;
+}
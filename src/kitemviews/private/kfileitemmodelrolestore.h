@@ -0,0 +1,228 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef KFILEITEMMODELROLESTORE_H
+#define KFILEITEMMODELROLESTORE_H
+
+#include "dolphin_export.h"
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Columnar storage for the frequently used roles of KFileItemModel.
+ *
+ * The values of the roles that are used for sorting and grouping are
+ * stored in dense typed vectors that are indexed by the slot of an item:
+ * sizes and times are stored as 64-bit integers, the version state as
+ * small integer and the strings of the roles "type", "owner", "group" and
+ * "permissions" are interned, so that each item only stores an integer ID.
+ *
+ * KFileItemModel keeps all other roles in a QHash per item and assembles the
+ * QHash of KFileItemModel::data() from both sources. The conversion between
+ * the typed values and QVariant is done by KFileItemModel, as it might
+ * depend on the item (e.g. the "size" of a directory is a number of items).
+ *
+ * A slot is obtained by allocateSlot() and must be given back by releaseSlot()
+ * if the item gets deleted. All values of a newly allocated slot are unset.
+ *
+ * Additionally, up to MaximumFlagCount boolean flags are stored as bits for
+ * each slot. The number of slots which have a flag set is counted, so that
+ * it can be checked in constant time whether any or all items have the flag.
+ * The flags are independent from the values and are not unset by resetSlot().
+ */
+class DOLPHIN_EXPORT KFileItemModelRoleStore
+{
+public:
+    enum Column {
+        NoColumn = -1,
+        // Columns of 64-bit integers:
+        SizeColumn, ContentsSizeColumn, ModificationTimeColumn, CreationTimeColumn, AccessTimeColumn, DeletionTimeColumn,
+        // Columns of interned strings:
+        TypeColumn, OwnerColumn, GroupColumn, PermissionsColumn,
+        // Column of small integers:
+        VersionColumn,
+        // Mandatory last entry:
+        ColumnCount
+    };
+
+    /** Value of an unset number in one of the number columns. */
+    static const qint64 NoNumber;
+
+    /** ID of an unset string in one of the string columns. */
+    static const int NoString = -1;
+
+    /** Value of an unset version state. */
+    static const int NoVersion = -1;
+
+    /** Number of flags that can be stored for each slot. */
+    static const int MaximumFlagCount = 8;
+
+    KFileItemModelRoleStore();
+
+    /**
+     * @return Column that stores the values of \a role or NoColumn if
+     *         the role is not stored by KFileItemModelRoleStore.
+     *         Runtime complexity is O(1).
+     */
+    static Column columnForRole(const QByteArray& role);
+    static QByteArray roleForColumn(Column column);
+
+    static bool isNumberColumn(Column column);
+    static bool isStringColumn(Column column);
+
+    /**
+     * @return A slot whose values are all unset. Slots of released
+     *         items are reused.
+     */
+    int allocateSlot();
+    void releaseSlot(int slot);
+
+    /**
+     * Releases all slots and forgets all interned strings. Must only be
+     * invoked if no item uses a slot anymore.
+     */
+    void clear();
+
+    /**
+     * @return True if the value in the column \a column is set for the slot \a slot.
+     */
+    bool contains(int slot, Column column) const;
+
+    /**
+     * Unsets all values of the slot \a slot.
+     */
+    void resetSlot(int slot);
+
+    /**
+     * Unsets the value in the column \a column for the slot \a slot.
+     */
+    void reset(int slot, Column column);
+
+    qint64 number(int slot, Column column) const;
+    void setNumber(int slot, Column column, qint64 value);
+
+    int stringId(int slot, Column column) const;
+    QString string(int slot, Column column) const;
+    void setString(int slot, Column column, const QString& value);
+
+    /**
+     * @return The string with the ID \a id or a null-string if the ID is NoString.
+     */
+    QString stringForId(int id) const;
+
+    int version(int slot) const;
+    void setVersion(int slot, int version);
+
+    /**
+     * @return True if the flag \a flag (0 <= flag < MaximumFlagCount) is set
+     *         for the slot \a slot.
+     */
+    bool flag(int slot, int flag) const;
+    void setFlag(int slot, int flag, bool set);
+
+    /**
+     * @return Number of slots for which the flag \a flag is set.
+     */
+    int flagCount(int flag) const;
+
+    /**
+     * Unsets the flag \a flag for all slots.
+     */
+    void resetFlag(int flag);
+
+    /**
+     * Unsets all flags of the slot \a slot.
+     */
+    void resetFlags(int slot);
+
+private:
+    int internString(const QString& value);
+
+private:
+    enum {
+        NumberColumnCount = DeletionTimeColumn - SizeColumn + 1,
+        StringColumnCount = PermissionsColumn - TypeColumn + 1
+    };
+
+    int m_slotCount;
+    QVector<int> m_freeSlots;
+
+    QVector<qint64> m_numbers[NumberColumnCount];
+    QVector<int> m_stringIds[StringColumnCount];
+    QVector<qint8> m_versions;
+
+    QVector<quint8> m_flags;
+    int m_flagCounts[MaximumFlagCount];
+
+    QVector<QString> m_strings;
+    QHash<QString, int> m_idsForStrings;
+};
+
+inline bool KFileItemModelRoleStore::isNumberColumn(Column column)
+{
+    return column >= SizeColumn && column <= DeletionTimeColumn;
+}
+
+inline bool KFileItemModelRoleStore::isStringColumn(Column column)
+{
+    return column >= TypeColumn && column <= PermissionsColumn;
+}
+
+inline qint64 KFileItemModelRoleStore::number(int slot, Column column) const
+{
+    Q_ASSERT(isNumberColumn(column));
+    return m_numbers[column - SizeColumn].at(slot);
+}
+
+inline int KFileItemModelRoleStore::stringId(int slot, Column column) const
+{
+    Q_ASSERT(isStringColumn(column));
+    return m_stringIds[column - TypeColumn].at(slot);
+}
+
+inline QString KFileItemModelRoleStore::stringForId(int id) const
+{
+    return id == NoString ? QString() : m_strings.at(id);
+}
+
+inline QString KFileItemModelRoleStore::string(int slot, Column column) const
+{
+    return stringForId(stringId(slot, column));
+}
+
+inline int KFileItemModelRoleStore::version(int slot) const
+{
+    return m_versions.at(slot);
+}
+
+inline bool KFileItemModelRoleStore::flag(int slot, int flag) const
+{
+    Q_ASSERT(flag >= 0 && flag < MaximumFlagCount);
+    return m_flags.at(slot) & (1 << flag);
+}
+
+inline int KFileItemModelRoleStore::flagCount(int flag) const
+{
+    Q_ASSERT(flag >= 0 && flag < MaximumFlagCount);
+    return m_flagCounts[flag];
+}
+
+#endif
@@ -22,9 +22,26 @@
 #ifndef KFILEITEMMODELSORTALGORITHM_H
 #define KFILEITEMMODELSORTALGORITHM_H
 
+#include <QAtomicInt>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QtConcurrentRun>
 
 #include <algorithm>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+template <typename RandomAccessIterator, typename LessThan>
+static void merge(RandomAccessIterator begin,
+                  RandomAccessIterator pivot,
+                  RandomAccessIterator end,
+                  const LessThan& lessThan);
 
 /**
  * Sorts the items using the merge sort algorithm is used to assure a
@@ -141,5 +158,337 @@ static void merge(RandomAccessIterator begin,
     merge(newPivot, secondCut, end, lessThan);
 }
 
-#endif
+/**
+ * @brief Fork-join scheduler with work stealing for KFileItemModel's sort engine.
+ *
+ * Each participating thread owns a deque of tasks. invoke() pushes one of two
+ * functions to the deque of the calling thread and executes the other one
+ * directly. Idle threads steal the oldest tasks from the deques of the other
+ * threads, and a thread that waits for a stolen task executes other tasks in
+ * the meantime. Hence no thread waits as long as there is any work left, and
+ * splitting as well as merging can be done in parallel. If there is nothing
+ * to steal, threads block until a task has been pushed or finished, so that
+ * they don't take CPU time from other jobs of the thread pool.
+ *
+ * The thread that calls run() participates as thread 0, the additional threads
+ * are taken from QThreadPool::globalInstance(). If the global thread pool is
+ * busy, the work is done by the threads that are available.
+ */
+class KSortTaskScheduler
+{
+public:
+    typedef std::function<void(int thread)> Function;
+
+    explicit KSortTaskScheduler(int numberOfThreads) :
+        m_state(new State(qMax(1, numberOfThreads)))
+    {
+    }
+
+    ~KSortTaskScheduler()
+    {
+        // Workers that have not been started yet only access the
+        // shared state and return immediately.
+        m_state->done.storeRelease(1);
+        m_state->notify();
+    }
+
+    /**
+     * Executes \a function in the calling thread and returns after all tasks
+     * that have been invoked by \a function have been finished.
+     */
+    void run(const Function& function)
+    {
+        const int workerCount = static_cast<int>(m_state->queues.size()) - 1;
+        for (int thread = 1; thread <= workerCount; ++thread) {
+            QThreadPool::globalInstance()->start(new Worker(m_state, thread));
+        }
+
+        function(0);
+        m_state->done.storeRelease(1);
+        m_state->notify();
+    }
+
+    /**
+     * Executes \a function1 and \a function2, possibly in parallel, and returns
+     * after both have been finished. \a thread is the index of the calling thread
+     * that is passed to all functions by the scheduler.
+     */
+    void invoke(int thread, const Function& function1, const Function& function2)
+    {
+        Task task(function2);
+        m_state->push(thread, &task);
+
+        function1(thread);
+
+        if (m_state->popIfLast(thread, &task)) {
+            function2(thread);
+            return;
+        }
+
+        // The task has been stolen. Help the other threads until it has been finished.
+        while (!task.finished.loadAcquire()) {
+            const int generation = m_state->generation();
+            if (!m_state->executeAnyTask(thread) && !task.finished.loadAcquire()) {
+                m_state->waitForChange(generation);
+            }
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(KSortTaskScheduler)
+
+    struct Task
+    {
+        explicit Task(const Function& function) : function(function), finished(0) {}
+        Function function;
+        QAtomicInt finished;
+    };
+
+    struct TaskQueue
+    {
+        QMutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    struct State
+    {
+        explicit State(int numberOfThreads) : queues(numberOfThreads), done(0), changeCount(0) {}
+
+        void push(int thread, Task* task)
+        {
+            {
+                TaskQueue& queue = queues[thread];
+                QMutexLocker locker(&queue.mutex);
+                queue.tasks.push_back(task);
+            }
+            notify();
+        }
+
+        /**
+         * Wakes up all threads that wait in waitForChange(). Is called
+         * whenever a task has been pushed or finished.
+         */
+        void notify()
+        {
+            QMutexLocker locker(&changeMutex);
+            ++changeCount;
+            changed.wakeAll();
+        }
+
+        int generation()
+        {
+            QMutexLocker locker(&changeMutex);
+            return changeCount;
+        }
+
+        /**
+         * Blocks until notify() has been called after generation() returned
+         * \a generation, or until all work has been done.
+         */
+        void waitForChange(int generation)
+        {
+            QMutexLocker locker(&changeMutex);
+            while (changeCount == generation && !done.loadAcquire()) {
+                changed.wait(&changeMutex);
+            }
+        }
+
+        bool popIfLast(int thread, Task* task)
+        {
+            TaskQueue& queue = queues[thread];
+            QMutexLocker locker(&queue.mutex);
+            if (!queue.tasks.empty() && queue.tasks.back() == task) {
+                queue.tasks.pop_back();
+                return true;
+            }
+            return false;
+        }
+
+        Task* steal(int thread)
+        {
+            const int count = static_cast<int>(queues.size());
+            for (int i = 0; i < count; ++i) {
+                TaskQueue& queue = queues[(thread + i) % count];
+                QMutexLocker locker(&queue.mutex);
+                if (!queue.tasks.empty()) {
+                    Task* task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                    return task;
+                }
+            }
+            return nullptr;
+        }
+
+        bool executeAnyTask(int thread)
+        {
+            Task* task = steal(thread);
+            if (!task) {
+                return false;
+            }
+
+            task->function(thread);
+            task->finished.storeRelease(1);
+            notify();
+            return true;
+        }
+
+        std::vector<TaskQueue> queues;
+        QAtomicInt done;
+
+        QMutex changeMutex;
+        QWaitCondition changed;
+        int changeCount;
+    };
 
+    class Worker : public QRunnable
+    {
+    public:
+        Worker(const QSharedPointer<State>& state, int thread) : m_state(state), m_thread(thread) {}
+
+        void run() override
+        {
+            while (!m_state->done.loadAcquire()) {
+                const int generation = m_state->generation();
+                if (!m_state->executeAnyTask(m_thread)) {
+                    m_state->waitForChange(generation);
+                }
+            }
+        }
+
+    private:
+        QSharedPointer<State> m_state;
+        int m_thread;
+    };
+
+    QSharedPointer<State> m_state;
+};
+
+/**
+ * Merges the sorted ranges [\a first1, \a last1) and [\a first2, \a last2)
+ * into \a result. The range that gets merged is split recursively and the
+ * parts are merged in parallel by \a scheduler. The merge is stable: equal
+ * items of the first range are placed before the items of the second range.
+ * No further parts are merged after \a canceled has been set.
+ */
+template <typename InputIterator, typename OutputIterator, typename LessThan>
+static void parallelMerge(InputIterator first1, InputIterator last1,
+                          InputIterator first2, InputIterator last2,
+                          OutputIterator result,
+                          const LessThan& lessThan,
+                          KSortTaskScheduler& scheduler,
+                          int thread,
+                          int threshold,
+                          const QAtomicInt* canceled)
+{
+    if (canceled && canceled->loadAcquire()) {
+        return;
+    }
+
+    const int len1 = last1 - first1;
+    const int len2 = last2 - first2;
+    if (len1 + len2 <= threshold) {
+        std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1),
+                   std::make_move_iterator(first2), std::make_move_iterator(last2),
+                   result, lessThan);
+        return;
+    }
+
+    InputIterator cut1;
+    InputIterator cut2;
+    if (len1 >= len2) {
+        cut1 = first1 + len1 / 2;
+        cut2 = std::lower_bound(first2, last2, *cut1, lessThan);
+    } else {
+        cut2 = first2 + len2 / 2;
+        cut1 = std::upper_bound(first1, last1, *cut2, lessThan);
+    }
+
+    const OutputIterator secondResult = result + (cut1 - first1) + (cut2 - first2);
+    scheduler.invoke(thread,
+        [&](int t) { parallelMerge(first1, cut1, first2, cut2, result, lessThan, scheduler, t, threshold, canceled); },
+        [&](int t) { parallelMerge(cut1, last1, cut2, last2, secondResult, lessThan, scheduler, t, threshold, canceled); });
+}
+
+/**
+ * Helper function for workStealingMergeSort(): Sorts \a count items starting at
+ * \a data. If \a resultInBuffer is true, the sorted items are moved to \a buffer,
+ * otherwise they are stored in \a data again. \a buffer is used as temporary
+ * storage in both cases. Returns without finishing the sorting as soon as
+ * \a canceled has been set.
+ */
+template <typename DataIterator, typename BufferIterator, typename LessThan>
+static void workStealingMergeSortHelper(DataIterator data,
+                                        BufferIterator buffer,
+                                        int count,
+                                        bool resultInBuffer,
+                                        const LessThan& lessThan,
+                                        KSortTaskScheduler& scheduler,
+                                        int thread,
+                                        int threshold,
+                                        const QAtomicInt* canceled)
+{
+    if (canceled && canceled->loadAcquire()) {
+        return;
+    }
+
+    if (count <= threshold) {
+        std::stable_sort(data, data + count, lessThan);
+        if (resultInBuffer) {
+            std::move(data, data + count, buffer);
+        }
+        return;
+    }
+
+    // Sort both halves into the other storage and merge them into the requested one.
+    const int half = count / 2;
+    scheduler.invoke(thread,
+        [&](int t) { workStealingMergeSortHelper(data, buffer, half, !resultInBuffer, lessThan, scheduler, t, threshold, canceled); },
+        [&](int t) { workStealingMergeSortHelper(data + half, buffer + half, count - half, !resultInBuffer, lessThan, scheduler, t, threshold, canceled); });
+
+    if (resultInBuffer) {
+        parallelMerge(data, data + half, data + half, data + count, buffer, lessThan, scheduler, thread, threshold, canceled);
+    } else {
+        parallelMerge(buffer, buffer + half, buffer + half, buffer + count, data, lessThan, scheduler, thread, threshold, canceled);
+    }
+}
+
+/**
+ * Sorts the items between \a begin and \a end with a stable merge sort.
+ * Both the splitting and the merging is done in parallel by up to
+ * \a numberOfThreads threads that steal work from each other, see
+ * KSortTaskScheduler. Ranges with up to \a threshold items are sorted
+ * and merged by a single thread.
+ *
+ * The comparison function \a lessThan must be reentrant. It is recommended to
+ * sort plain keys that have been extracted from the items beforehand.
+ *
+ * If \a canceled is set by another thread, the sorting is aborted after the
+ * chunks that are being sorted or merged have been finished. The order of
+ * the items is undefined in this case, and values that have been moved to
+ * the temporary buffer are lost.
+ */
+template <typename RandomAccessIterator, typename LessThan>
+static void workStealingMergeSort(RandomAccessIterator begin,
+                                  RandomAccessIterator end,
+                                  const LessThan& lessThan,
+                                  int numberOfThreads,
+                                  int threshold = 2048,
+                                  const QAtomicInt* canceled = nullptr)
+{
+    typedef typename std::iterator_traits<RandomAccessIterator>::value_type ValueType;
+
+    // A single thread only uses the chunks if the sorting can be canceled.
+    const int count = end - begin;
+    if ((numberOfThreads <= 1 && !canceled) || count <= threshold) {
+        std::stable_sort(begin, end, lessThan);
+        return;
+    }
+
+    std::vector<ValueType> buffer(count);
+    KSortTaskScheduler scheduler(numberOfThreads);
+    scheduler.run([&](int thread) {
+        workStealingMergeSortHelper(begin, buffer.begin(), count, false, lessThan, scheduler, thread, threshold, canceled);
+    });
+}
+
+#endif
@@ -0,0 +1,189 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef KITEMDATAPOOL_H
+#define KITEMDATAPOOL_H
+
+#include <QVector>
+
+#include <new>
+#include <type_traits>
+
+/**
+ * @brief Slab allocator for the per-item data of a model.
+ *
+ * Creating and deleting the data for thousands of items one by one results
+ * in many small heap allocations that fragment the heap when navigating
+ * between large folders. KItemDataPool allocates the memory for
+ * \a ItemsPerSlab items at once and keeps the memory of destroyed items in
+ * a free-list, so that items which are added later reuse it.
+ *
+ * clear() destroys all items and releases the memory of all slabs at once.
+ */
+template <typename T, int ItemsPerSlab = 512>
+class KItemDataPool
+{
+public:
+    KItemDataPool();
+    ~KItemDataPool();
+
+    /**
+     * @return A value-initialized item. It must be destroyed by
+     *         destroy() or clear().
+     */
+    T* create();
+
+    /**
+     * Destroys the item \a item, which must have been created by create().
+     * The memory is kept for the next item.
+     */
+    void destroy(T* item);
+
+    /**
+     * Destroys all items and releases the memory of all slabs.
+     */
+    void clear();
+
+    /**
+     * @return Number of items that have been created and not destroyed yet.
+     */
+    int count() const;
+
+    /**
+     * @return Number of items that fit into the currently allocated slabs.
+     */
+    int capacity() const;
+
+private:
+    Q_DISABLE_COPY(KItemDataPool)
+
+    struct Chunk
+    {
+        union {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+            Chunk* nextFree;
+        };
+        bool isUsed;
+    };
+
+    void allocateSlab();
+
+    QVector<Chunk*> m_slabs;
+    Chunk* m_freeList;
+    int m_count;
+};
+
+template <typename T, int ItemsPerSlab>
+KItemDataPool<T, ItemsPerSlab>::KItemDataPool() :
+    m_slabs(),
+    m_freeList(nullptr),
+    m_count(0)
+{
+}
+
+template <typename T, int ItemsPerSlab>
+KItemDataPool<T, ItemsPerSlab>::~KItemDataPool()
+{
+    clear();
+}
+
+template <typename T, int ItemsPerSlab>
+T* KItemDataPool<T, ItemsPerSlab>::create()
+{
+    if (!m_freeList) {
+        allocateSlab();
+    }
+
+    Chunk* chunk = m_freeList;
+    m_freeList = chunk->nextFree;
+
+    T* item = new (&chunk->storage) T();
+    chunk->isUsed = true;
+    ++m_count;
+    return item;
+}
+
+template <typename T, int ItemsPerSlab>
+void KItemDataPool<T, ItemsPerSlab>::destroy(T* item)
+{
+    if (!item) {
+        return;
+    }
+
+    // The storage is the first member of Chunk, hence the item
+    // and its chunk share the same address.
+    Chunk* chunk = reinterpret_cast<Chunk*>(item);
+    Q_ASSERT(chunk->isUsed);
+
+    item->~T();
+    chunk->isUsed = false;
+    chunk->nextFree = m_freeList;
+    m_freeList = chunk;
+    --m_count;
+}
+
+template <typename T, int ItemsPerSlab>
+void KItemDataPool<T, ItemsPerSlab>::clear()
+{
+    foreach (Chunk* slab, m_slabs) {
+        for (int i = 0; i < ItemsPerSlab && m_count > 0; ++i) {
+            Chunk& chunk = slab[i];
+            if (chunk.isUsed) {
+                reinterpret_cast<T*>(&chunk.storage)->~T();
+                --m_count;
+            }
+        }
+        ::operator delete(slab);
+    }
+
+    Q_ASSERT(m_count == 0);
+    m_slabs.clear();
+    m_freeList = nullptr;
+    m_count = 0;
+}
+
+template <typename T, int ItemsPerSlab>
+int KItemDataPool<T, ItemsPerSlab>::count() const
+{
+    return m_count;
+}
+
+template <typename T, int ItemsPerSlab>
+int KItemDataPool<T, ItemsPerSlab>::capacity() const
+{
+    return m_slabs.count() * ItemsPerSlab;
+}
+
+template <typename T, int ItemsPerSlab>
+void KItemDataPool<T, ItemsPerSlab>::allocateSlab()
+{
+    Chunk* slab = static_cast<Chunk*>(::operator new(sizeof(Chunk) * ItemsPerSlab));
+    m_slabs.append(slab);
+
+    // Link the chunks in reverse order, so that the items of
+    // a slab are handed out in the order of their addresses.
+    for (int i = ItemsPerSlab - 1; i >= 0; --i) {
+        Chunk& chunk = slab[i];
+        chunk.isUsed = false;
+        chunk.nextFree = m_freeList;
+        m_freeList = &chunk;
+    }
+}
+
+#endif
@@ -20,13 +20,16 @@
 #include "kitemlistsizehintresolver.h"
 #include "kitemviews/kitemlistview.h"
 
+#include <limits>
+
 KItemListSizeHintResolver::KItemListSizeHintResolver(const KItemListView* itemListView) :
     m_itemListView(itemListView),
     m_logicalHeightHintCache(),
     m_logicalWidthHint(0.0),
     m_logicalHeightHint(0.0),
     m_minHeightHint(0.0),
-    m_needsResolving(false)
+    m_needsResolving(false),
+    m_hasEstimatedHints(false)
 {
 }
 
@@ -49,7 +52,20 @@ QSizeF KItemListSizeHintResolver::minSizeHint()
 QSizeF KItemListSizeHintResolver::sizeHint(int index)
 {
     updateCache();
-    return QSizeF(m_logicalWidthHint, m_logicalHeightHintCache.at(index));
+    return QSizeF(m_logicalWidthHint, qAbs(m_logicalHeightHintCache.at(index)));
+}
+
+bool KItemListSizeHintResolver::hasUniformSizeHints()
+{
+    updateCache();
+    if (m_logicalHeightHintCache.isEmpty()) {
+        return true;
+    }
+
+    // Note that m_minHeightHint and m_logicalHeightHint are not updated
+    // when items are removed, but the remaining hints are still equal
+    // if they have been equal before.
+    return !m_hasEstimatedHints && m_minHeightHint == m_logicalHeightHint;
 }
 
 void KItemListSizeHintResolver::itemsInserted(const KItemRangeList& itemRanges)
@@ -161,14 +177,69 @@ void KItemListSizeHintResolver::clearCache()
 void KItemListSizeHintResolver::updateCache()
 {
     if (m_needsResolving) {
-        m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint);
+        // Estimating the size hints is much cheaper than calculating them for
+        // huge directories. The exact size hints of the visible items are
+        // requested by KItemListViewLayouter, see resolveExactSizeHints().
+        m_hasEstimatedHints = m_itemListView->estimateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint);
+        if (!m_hasEstimatedHints) {
+            m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, m_logicalWidthHint);
+        }
+
         // Set logical height as the max cached height (if the cache is not empty).
         if (m_logicalHeightHintCache.isEmpty()) {
             m_logicalHeightHint = 0.0;
         } else {
-            m_logicalHeightHint = *std::max_element(m_logicalHeightHintCache.begin(), m_logicalHeightHintCache.end());
-            m_minHeightHint = *std::min_element(m_logicalHeightHintCache.begin(), m_logicalHeightHintCache.end());
+            m_logicalHeightHint = 0.0;
+            m_minHeightHint = std::numeric_limits<qreal>::max();
+            foreach (qreal height, m_logicalHeightHintCache) {
+                height = qAbs(height);
+                m_logicalHeightHint = qMax(m_logicalHeightHint, height);
+                m_minHeightHint = qMin(m_minHeightHint, height);
+            }
         }
         m_needsResolving = false;
     }
 }
+
+QHash<int, qreal> KItemListSizeHintResolver::resolveExactSizeHints(int firstIndex, int lastIndex)
+{
+    updateCache();
+
+    QHash<int, qreal> previousHeights;
+    if (!m_hasEstimatedHints) {
+        return previousHeights;
+    }
+
+    firstIndex = qMax(firstIndex, 0);
+    lastIndex = qMin(lastIndex, m_logicalHeightHintCache.count() - 1);
+    for (int index = firstIndex; index <= lastIndex; ++index) {
+        const qreal height = m_logicalHeightHintCache.at(index);
+        if (height < 0.0) {
+            // calculateItemSizeHints() only calculates the hints that are 0.0.
+            previousHeights.insert(index, -height);
+            m_logicalHeightHintCache[index] = 0.0;
+        }
+    }
+
+    if (previousHeights.isEmpty()) {
+        return previousHeights;
+    }
+
+    qreal logicalWidthHint = m_logicalWidthHint;
+    m_itemListView->calculateItemSizeHints(m_logicalHeightHintCache, logicalWidthHint);
+
+    QHash<int, qreal>::iterator it = previousHeights.begin();
+    while (it != previousHeights.end()) {
+        const qreal height = m_logicalHeightHintCache.at(it.key());
+        m_logicalHeightHint = qMax(m_logicalHeightHint, height);
+        m_minHeightHint = qMin(m_minHeightHint, height);
+
+        if (height == it.value()) {
+            it = previousHeights.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return previousHeights;
+}
@@ -23,6 +23,7 @@
 #include "dolphin_export.h"
 #include "kitemviews/kitemmodelbase.h"
 
+#include <QHash>
 #include <QSizeF>
 #include <QVector>
 
@@ -30,6 +31,13 @@ class KItemListView;
 
 /**
  * @brief Calculates and caches the sizehints of items in KItemListView.
+ *
+ * If the widgets support it, the size hints are only estimated cheaply
+ * at first (see KItemListWidgetInformant::estimateItemSizeHints()), and
+ * KItemListViewLayouter requests the exact size hints of the visible
+ * items by resolveExactSizeHints(). In the cache, exact heights are stored
+ * as positive values, estimated heights as negative values, and 0.0 marks
+ * a height that has not been determined yet.
  */
 class DOLPHIN_EXPORT KItemListSizeHintResolver
 {
@@ -40,6 +48,11 @@ public:
     QSizeF minSizeHint();
     QSizeF sizeHint(int index);
 
+    /**
+     * @return True if the exact size hints of all items are known and equal.
+     */
+    bool hasUniformSizeHints();
+
     void itemsInserted(const KItemRangeList& itemRanges);
     void itemsRemoved(const KItemRangeList& itemRanges);
     void itemsMoved(const KItemRange& range, const QList<int>& movedToIndexes);
@@ -48,6 +61,14 @@ public:
     void clearCache();
     void updateCache();
 
+    /**
+     * Replaces the estimated size hints of the items in the range
+     * [\a firstIndex, \a lastIndex] by their exact size hints.
+     * @return The previous logical heights of the items whose height has
+     *         been changed, with the item indexes as keys.
+     */
+    QHash<int, qreal> resolveExactSizeHints(int firstIndex, int lastIndex);
+
 private:
     const KItemListView* m_itemListView;
     mutable QVector<qreal> m_logicalHeightHintCache;
@@ -55,6 +76,7 @@ private:
     mutable qreal m_logicalHeightHint;
     mutable qreal m_minHeightHint;
     bool m_needsResolving;
+    bool m_hasEstimatedHints;
 };
 
 #endif
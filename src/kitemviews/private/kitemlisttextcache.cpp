@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#include "kitemlisttextcache.h"
+
+namespace {
+    // Maximum estimated memory usage of all entries in bytes. Is more than
+    // enough for the visible items of several views and the items in one
+    // page before and after them.
+    const int MaximumCost = 4 * 1024 * 1024;
+
+    // Estimated memory usage of an entry without its texts, and of each
+    // glyph that is cached by QStaticText::AggressiveCaching.
+    const int EntryCost = 512;
+    const int GlyphCost = 32;
+
+    int entryCost(const KItemListTextCache::Key& key, const KItemListTextCache::Entry& entry)
+    {
+        const int textLength = entry.staticText.text().length();
+        return EntryCost
+             + (key.text.length() + textLength) * static_cast<int>(sizeof(QChar))
+             + textLength * GlyphCost;
+    }
+}
+
+class KItemListTextCacheSingleton
+{
+public:
+    KItemListTextCache instance;
+};
+Q_GLOBAL_STATIC(KItemListTextCacheSingleton, s_KItemListTextCache)
+
+KItemListTextCache* KItemListTextCache::instance()
+{
+    return &s_KItemListTextCache->instance;
+}
+
+KItemListTextCache::KItemListTextCache() :
+    m_entries(MaximumCost),
+    m_hitCount(0),
+    m_missCount(0)
+{
+}
+
+KItemListTextCache::~KItemListTextCache()
+{
+}
+
+const KItemListTextCache::Entry* KItemListTextCache::entry(const Key& key)
+{
+    const Entry* entry = m_entries.object(key);
+    if (entry) {
+        ++m_hitCount;
+    } else {
+        ++m_missCount;
+    }
+    return entry;
+}
+
+void KItemListTextCache::insert(const Key& key, const Entry& entry)
+{
+    m_entries.insert(key, new Entry(entry), entryCost(key, entry));
+}
+
+void KItemListTextCache::clear()
+{
+    m_entries.clear();
+    m_hitCount = 0;
+    m_missCount = 0;
+}
+
+int KItemListTextCache::hitCount() const
+{
+    return m_hitCount;
+}
+
+int KItemListTextCache::missCount() const
+{
+    return m_missCount;
+}
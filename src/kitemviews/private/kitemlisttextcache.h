@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#ifndef KITEMLISTTEXTCACHE_H
+#define KITEMLISTTEXTCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QCache>
+#include <QFont>
+#include <QStaticText>
+
+/**
+ * @brief Process-wide cache for the elided and laid out texts of
+ *        KStandardItemListWidget.
+ *
+ * Widgets get recycled while scrolling, and eliding and laying out the
+ * same texts again when scrolling back is expensive. All widgets of all
+ * views share this cache, so that e.g. both views of a split view profit
+ * from each other.
+ *
+ * The number of entries is limited by their estimated memory usage, as
+ * long texts need much more memory than short ones.
+ *
+ * The cache may only be used from the GUI thread.
+ */
+class DOLPHIN_EXPORT KItemListTextCache
+{
+public:
+    /**
+     * Describes how a text has been elided and laid out.
+     */
+    enum TextType
+    {
+        IconsNameText,
+        IconsRoleText,
+        CompactText,
+        DetailsText
+    };
+
+    struct Key
+    {
+        QString text;
+        QFont font;
+        qreal width;
+        TextType type;
+        int maxTextLines;
+
+        bool operator==(const Key& other) const
+        {
+            return width == other.width
+                && type == other.type
+                && maxTextLines == other.maxTextLines
+                && text == other.text
+                && font == other.font;
+        }
+    };
+
+    struct Entry
+    {
+        // Contains the elided text with the text width and text option.
+        QStaticText staticText;
+        // Required width and height of the laid out text.
+        qreal width;
+        qreal height;
+    };
+
+    static KItemListTextCache* instance();
+
+    /**
+     * @return The cached entry for \a key or 0 if the text has not been
+     *         cached yet. The entry is only valid until insert() is called.
+     */
+    const Entry* entry(const Key& key);
+
+    void insert(const Key& key, const Entry& entry);
+
+    /**
+     * Removes all entries and resets the hit and miss counters.
+     */
+    void clear();
+
+    /**
+     * @return Number of calls of entry() that returned a cached entry.
+     */
+    int hitCount() const;
+
+    /**
+     * @return Number of calls of entry() that did not return a cached entry.
+     */
+    int missCount() const;
+
+private:
+    KItemListTextCache();
+    ~KItemListTextCache();
+
+    QCache<Key, Entry> m_entries;
+    int m_hitCount;
+    int m_missCount;
+
+    friend class KItemListTextCacheSingleton;
+};
+
+inline uint qHash(const KItemListTextCache::Key& key, uint seed = 0)
+{
+    return qHash(key.text, seed) ^ qHash(key.font, seed) ^ qHash(key.width, seed) ^ uint(key.type << 8) ^ uint(key.maxTextLines);
+}
+
+#endif
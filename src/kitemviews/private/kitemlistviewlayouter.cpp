@@ -22,12 +22,25 @@
 #include "kitemlistsizehintresolver.h"
 #include "kitemviews/kitemmodelbase.h"
 
+#include <QtMath>
+
+#include <algorithm>
+
 // #define KITEMLISTVIEWLAYOUTER_DEBUG
 
+namespace {
+    // Maximum number of passes in resolveExactSizeHints(). Each pass might
+    // change the visible indexes, which requires resolving the size hints
+    // of further items.
+    const int MaximumResolvePasses = 3;
+}
+
 KItemListViewLayouter::KItemListViewLayouter(KItemListSizeHintResolver* sizeHintResolver, QObject* parent) :
     QObject(parent),
     m_dirty(true),
     m_visibleIndexesDirty(true),
+    m_firstDirtyIndex(0),
+    m_dirtySizeRanges(),
     m_scrollOrientation(Qt::Vertical),
     m_size(),
     m_itemSize(128, 128),
@@ -45,11 +58,21 @@ KItemListViewLayouter::KItemListViewLayouter(KItemListSizeHintResolver* sizeHint
     m_xPosInc(0),
     m_columnCount(0),
     m_rowOffsets(),
+    m_rowHeights(),
+    m_rowShifts(),
+    m_hasRowShifts(false),
     m_columnOffsets(),
     m_groupItemIndexes(),
     m_groupHeaderHeight(0),
     m_groupHeaderMargin(0),
-    m_itemInfos()
+    m_itemInfos(),
+    m_itemCount(0),
+    m_uniformLayout(false),
+    m_uniformRowHeight(0),
+    m_uniformRowMargin(0),
+    m_firstRowOffset(0),
+    m_groupStartIndexes(),
+    m_groupStartOffset(0)
 {
     Q_ASSERT(m_sizeHintResolver);
 }
@@ -62,7 +85,7 @@ void KItemListViewLayouter::setScrollOrientation(Qt::Orientation orientation)
 {
     if (m_scrollOrientation != orientation) {
         m_scrollOrientation = orientation;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -76,10 +99,10 @@ void KItemListViewLayouter::setSize(const QSizeF& size)
     if (m_size != size) {
         if (m_scrollOrientation == Qt::Vertical) {
             if (m_size.width() != size.width()) {
-                m_dirty = true;
+                markAsDirty();
             }
         } else if (m_size.height() != size.height()) {
-            m_dirty = true;
+            markAsDirty();
         }
 
         m_size = size;
@@ -96,7 +119,7 @@ void KItemListViewLayouter::setItemSize(const QSizeF& size)
 {
     if (m_itemSize != size) {
         m_itemSize = size;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -109,7 +132,7 @@ void KItemListViewLayouter::setItemMargin(const QSizeF& margin)
 {
     if (m_itemMargin != margin) {
         m_itemMargin = margin;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -122,7 +145,7 @@ void KItemListViewLayouter::setHeaderHeight(qreal height)
 {
     if (m_headerHeight != height) {
         m_headerHeight = height;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -135,7 +158,7 @@ void KItemListViewLayouter::setGroupHeaderHeight(qreal height)
 {
     if (m_groupHeaderHeight != height) {
         m_groupHeaderHeight = height;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -148,7 +171,7 @@ void KItemListViewLayouter::setGroupHeaderMargin(qreal margin)
 {
     if (m_groupHeaderMargin != margin) {
         m_groupHeaderMargin = margin;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -199,7 +222,7 @@ void KItemListViewLayouter::setModel(const KItemModelBase* model)
 {
     if (m_model != model) {
         m_model = model;
-        m_dirty = true;
+        markAsDirty();
     }
 }
 
@@ -223,14 +246,14 @@ int KItemListViewLayouter::lastVisibleIndex() const
 QRectF KItemListViewLayouter::itemRect(int index) const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
-    if (index < 0 || index >= m_itemInfos.count()) {
+    if (index < 0 || index >= m_itemCount) {
         return QRectF();
     }
 
     QSizeF sizeHint = m_sizeHintResolver->sizeHint(index);
 
-    const qreal x = m_columnOffsets.at(m_itemInfos.at(index).column);
-    const qreal y = m_rowOffsets.at(m_itemInfos.at(index).row);
+    const qreal x = m_columnOffsets.at(columnOfItem(index));
+    const qreal y = rowOffset(rowOfItem(index));
 
     if (m_scrollOrientation == Qt::Horizontal) {
         // Rotate the logical direction which is always vertical by 90°
@@ -274,10 +297,10 @@ QRectF KItemListViewLayouter::groupHeaderRect(int index) const
         // directly, the logical height represents the visual width, and
         // the logical row represents the column.
         qreal headerWidth = minimumGroupHeaderWidth();
-        const int row = m_itemInfos[index].row;
-        const int maxIndex = m_itemInfos.count() - 1;
+        const int row = rowOfItem(index);
+        const int maxIndex = m_itemCount - 1;
         while (index <= maxIndex) {
-            if (m_itemInfos[index].row != row) {
+            if (rowOfItem(index) != row) {
                 break;
             }
 
@@ -300,25 +323,25 @@ QRectF KItemListViewLayouter::groupHeaderRect(int index) const
 int KItemListViewLayouter::itemColumn(int index) const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
-    if (index < 0 || index >= m_itemInfos.count()) {
+    if (index < 0 || index >= m_itemCount) {
         return -1;
     }
 
     return (m_scrollOrientation == Qt::Vertical)
-            ? m_itemInfos[index].column
-            : m_itemInfos[index].row;
+            ? columnOfItem(index)
+            : rowOfItem(index);
 }
 
 int KItemListViewLayouter::itemRow(int index) const
 {
     const_cast<KItemListViewLayouter*>(this)->doLayout();
-    if (index < 0 || index >= m_itemInfos.count()) {
+    if (index < 0 || index >= m_itemCount) {
         return -1;
     }
 
     return (m_scrollOrientation == Qt::Vertical)
-            ? m_itemInfos[index].row
-            : m_itemInfos[index].column;
+            ? rowOfItem(index)
+            : columnOfItem(index);
 }
 
 int KItemListViewLayouter::maximumVisibleItems() const
@@ -344,6 +367,26 @@ bool KItemListViewLayouter::isFirstGroupItem(int itemIndex) const
 void KItemListViewLayouter::markAsDirty()
 {
     m_dirty = true;
+    m_firstDirtyIndex = 0;
+    m_dirtySizeRanges.clear();
+}
+
+void KItemListViewLayouter::markAsDirty(int index)
+{
+    m_firstDirtyIndex = m_dirty ? qMin(m_firstDirtyIndex, index) : index;
+    m_dirty = true;
+}
+
+void KItemListViewLayouter::markSizesAsDirty(int index, int count)
+{
+    if (m_uniformLayout) {
+        // Laying out uniform rows is cheap, and the rows might not be
+        // uniform anymore.
+        markAsDirty();
+        return;
+    }
+
+    m_dirtySizeRanges.append(KItemRange(index, count));
 }
 
 
@@ -385,6 +428,9 @@ void KItemListViewLayouter::doLayout()
             }
         }
 
+        const int previousColumnCount = m_columnCount;
+        const qreal previousColumnWidth = m_columnWidth;
+
         m_columnWidth = itemSize.width() + itemMargin.width();
         const qreal widthForColumns = size.width() - itemMargin.width();
         m_columnCount = qMax(1, int(widthForColumns / m_columnWidth));
@@ -401,7 +447,12 @@ void KItemListViewLayouter::doLayout()
             }
         }
 
-        m_itemInfos.resize(itemCount);
+        // If the columns stay the same, the rows before the row of the
+        // first dirty item don't need to be laid out again.
+        int firstDirtyIndex = qMin(m_firstDirtyIndex, qMin(m_itemInfos.count(), itemCount));
+        if (m_columnCount != previousColumnCount || m_columnWidth != previousColumnWidth) {
+            firstDirtyIndex = 0;
+        }
 
         // Calculate the offset of each column, i.e., the x-coordinate where the column starts.
         m_columnOffsets.resize(m_columnCount);
@@ -418,95 +469,170 @@ void KItemListViewLayouter::doLayout()
             currentOffset += m_columnWidth;
         }
 
-        // Prepare the QVector which stores the y-coordinate for each new row.
-        int numberOfRows = (itemCount + m_columnCount - 1) / m_columnCount;
-        if (grouped && m_columnCount > 1) {
-            // In the worst case, a new row will be started for every group.
-            // We could calculate the exact number of rows now to prevent that we reserve
-            // too much memory, but the code required to do that might need much more
-            // memory than it would save in the average case.
-            numberOfRows += m_groupItemIndexes.count();
-        }
-        m_rowOffsets.resize(numberOfRows);
-
-        qreal y = m_headerHeight + itemMargin.height();
-        int row = 0;
-
-        int index = 0;
-        while (index < itemCount) {
-            qreal maxItemHeight = itemSize.height();
+        m_itemCount = itemCount;
+        m_uniformLayout = (!grouped || m_columnCount == 1) && m_sizeHintResolver->hasUniformSizeHints();
+
+        qreal maximumScrollOffset = 0;
+        if (m_uniformLayout) {
+            // All rows have the same height, so the position of each item can be
+            // calculated from its index without storing anything per item.
+            m_itemInfos.clear();
+            m_itemInfos.squeeze();
+            m_rowOffsets.clear();
+            m_rowOffsets.squeeze();
+            m_rowHeights.clear();
+            m_rowHeights.squeeze();
+            m_rowShifts.reset(0);
+            m_hasRowShifts = false;
+            m_dirtySizeRanges.clear();
+
+            m_uniformRowHeight = qMax(itemSize.height(), m_sizeHintResolver->maxSizeHint().height());
+            if (grouped && horizontalScrolling) {
+                m_uniformRowHeight = qMax(m_uniformRowHeight, minimumGroupHeaderWidth());
+            }
+            m_uniformRowMargin = itemMargin.height();
+            m_firstRowOffset = m_headerHeight + itemMargin.height();
 
+            // Grouped uniform layouts only have one column, so the index of an item is also its row.
+            m_groupStartIndexes.clear();
             if (grouped) {
-                if (m_groupItemIndexes.contains(index)) {
-                    // The item is the first item of a group.
-                    // Increase the y-position to provide space
-                    // for the group header.
+                foreach (int index, m_groupItemIndexes) {
                     if (index > 0) {
-                        // Only add a margin if there has been added another
-                        // group already before
-                        y += m_groupHeaderMargin;
-                    } else if (!horizontalScrolling) {
-                        // The first group header should be aligned on top
-                        y -= itemMargin.height();
+                        m_groupStartIndexes.append(index);
                     }
+                }
+                std::sort(m_groupStartIndexes.begin(), m_groupStartIndexes.end());
 
-                    if (!horizontalScrolling) {
-                        y += m_groupHeaderHeight;
-                    }
+                if (m_groupItemIndexes.contains(0) && !horizontalScrolling) {
+                    // The first group header should be aligned on top
+                    m_firstRowOffset += m_groupHeaderHeight - itemMargin.height();
                 }
+                m_groupStartOffset = m_groupHeaderMargin + (horizontalScrolling ? 0 : m_groupHeaderHeight);
             }
 
-            m_rowOffsets[row] = y;
+            const int rowCount = (itemCount + m_columnCount - 1) / m_columnCount;
+            if (rowCount > 0) {
+                maximumScrollOffset = rowOffset(rowCount - 1) + m_uniformRowHeight + m_uniformRowMargin;
+            }
+        } else {
+            m_itemInfos.resize(itemCount);
+
+            // Prepare the QVector which stores the y-coordinate for each new row.
+            int numberOfRows = (itemCount + m_columnCount - 1) / m_columnCount;
+            if (grouped && m_columnCount > 1) {
+                // In the worst case, a new row will be started for every group.
+                // We could calculate the exact number of rows now to prevent that we reserve
+                // too much memory, but the code required to do that might need much more
+                // memory than it would save in the average case.
+                numberOfRows += m_groupItemIndexes.count();
+            }
+            const int firstDirtyRow = (firstDirtyIndex > 0) ? m_itemInfos.at(firstDirtyIndex - 1).row : 0;
+            if (firstDirtyRow > 0) {
+                applyRowShifts();
+            }
+
+            m_rowOffsets.resize(numberOfRows);
+            m_rowHeights.resize(numberOfRows);
+
+            qreal y = m_headerHeight + itemMargin.height();
+            int row = 0;
 
-            int column = 0;
-            while (index < itemCount && column < m_columnCount) {
-                qreal requiredItemHeight = itemSize.height();
-                const QSizeF sizeHint = m_sizeHintResolver->sizeHint(index);
-                const qreal sizeHintHeight = sizeHint.height();
-                if (sizeHintHeight > requiredItemHeight) {
-                    requiredItemHeight = sizeHintHeight;
+            int index = 0;
+            if (firstDirtyRow > 0) {
+                // Start with the row of the last unchanged item, as
+                // further items might have been added to this row.
+                row = firstDirtyRow;
+                y = m_rowOffsets.at(row - 1) + m_rowHeights.at(row - 1) + itemMargin.height();
+
+                index = firstDirtyIndex - 1;
+                while (index > 0 && m_itemInfos.at(index - 1).row == row) {
+                    --index;
                 }
+            }
 
-                ItemInfo& itemInfo = m_itemInfos[index];
-                itemInfo.column = column;
-                itemInfo.row = row;
-
-                if (grouped && horizontalScrolling) {
-                    // When grouping is enabled in the horizontal mode, the header alignment
-                    // looks like this:
-                    //   Header-1 Header-2 Header-3
-                    //   Item 1   Item 4   Item 7
-                    //   Item 2   Item 5   Item 8
-                    //   Item 3   Item 6   Item 9
-                    // In this case 'requiredItemHeight' represents the column-width. We don't
-                    // check the content of the header in the layouter to determine the required
-                    // width, hence assure that at least a minimal width of 15 characters is given
-                    // (in average a character requires the halve width of the font height).
-                    //
-                    // TODO: Let the group headers provide a minimum width and respect this width here
-                    const qreal headerWidth = minimumGroupHeaderWidth();
-                    if (requiredItemHeight < headerWidth) {
-                        requiredItemHeight = headerWidth;
+            while (index < itemCount) {
+                qreal maxItemHeight = itemSize.height();
+
+                if (grouped) {
+                    if (m_groupItemIndexes.contains(index)) {
+                        // The item is the first item of a group.
+                        // Increase the y-position to provide space
+                        // for the group header.
+                        if (index > 0) {
+                            // Only add a margin if there has been added another
+                            // group already before
+                            y += m_groupHeaderMargin;
+                        } else if (!horizontalScrolling) {
+                            // The first group header should be aligned on top
+                            y -= itemMargin.height();
+                        }
+
+                        if (!horizontalScrolling) {
+                            y += m_groupHeaderHeight;
+                        }
                     }
                 }
 
-                maxItemHeight = qMax(maxItemHeight, requiredItemHeight);
-                ++index;
-                ++column;
+                m_rowOffsets[row] = y;
+
+                int column = 0;
+                while (index < itemCount && column < m_columnCount) {
+                    qreal requiredItemHeight = itemSize.height();
+                    const QSizeF sizeHint = m_sizeHintResolver->sizeHint(index);
+                    const qreal sizeHintHeight = sizeHint.height();
+                    if (sizeHintHeight > requiredItemHeight) {
+                        requiredItemHeight = sizeHintHeight;
+                    }
+
+                    ItemInfo& itemInfo = m_itemInfos[index];
+                    itemInfo.column = column;
+                    itemInfo.row = row;
+
+                    if (grouped && horizontalScrolling) {
+                        // When grouping is enabled in the horizontal mode, the header alignment
+                        // looks like this:
+                        //   Header-1 Header-2 Header-3
+                        //   Item 1   Item 4   Item 7
+                        //   Item 2   Item 5   Item 8
+                        //   Item 3   Item 6   Item 9
+                        // In this case 'requiredItemHeight' represents the column-width. We don't
+                        // check the content of the header in the layouter to determine the required
+                        // width, hence assure that at least a minimal width of 15 characters is given
+                        // (in average a character requires the halve width of the font height).
+                        //
+                        // TODO: Let the group headers provide a minimum width and respect this width here
+                        const qreal headerWidth = minimumGroupHeaderWidth();
+                        if (requiredItemHeight < headerWidth) {
+                            requiredItemHeight = headerWidth;
+                        }
+                    }
 
-                if (grouped && m_groupItemIndexes.contains(index)) {
-                    // The item represents the first index of a group
-                    // and must aligned in the first column
-                    break;
+                    maxItemHeight = qMax(maxItemHeight, requiredItemHeight);
+                    ++index;
+                    ++column;
+
+                    if (grouped && m_groupItemIndexes.contains(index)) {
+                        // The item represents the first index of a group
+                        // and must aligned in the first column
+                        break;
+                    }
                 }
+
+                m_rowHeights[row] = maxItemHeight;
+                y += maxItemHeight + itemMargin.height();
+                ++row;
             }
 
-            y += maxItemHeight + itemMargin.height();
-            ++row;
+            m_rowOffsets.resize(row);
+            m_rowHeights.resize(row);
+            m_rowShifts.reset(row);
+            m_hasRowShifts = false;
+
+            maximumScrollOffset = y;
         }
 
         if (itemCount > 0) {
-            m_maximumScrollOffset = y;
+            m_maximumScrollOffset = maximumScrollOffset;
             m_maximumItemOffset = m_columnCount * m_columnWidth;
         } else {
             m_maximumScrollOffset = 0;
@@ -519,7 +645,22 @@ void KItemListViewLayouter::doLayout()
         m_dirty = false;
     }
 
+    if (!m_dirtySizeRanges.isEmpty()) {
+        const int itemCount = m_itemInfos.count();
+        foreach (const KItemRange& range, m_dirtySizeRanges) {
+            const int lastIndex = qMin(range.index + range.count, itemCount) - 1;
+            for (int index = range.index; index <= lastIndex; ++index) {
+                updateRowHeight(index);
+            }
+        }
+        m_dirtySizeRanges.clear();
+    }
+
+    const bool visibleIndexesChanged = m_visibleIndexesDirty;
     updateVisibleIndexes();
+    if (visibleIndexesChanged) {
+        resolveExactSizeHints();
+    }
 }
 
 void KItemListViewLayouter::updateVisibleIndexes()
@@ -539,13 +680,36 @@ void KItemListViewLayouter::updateVisibleIndexes()
 
     const int maxIndex = m_model->count() - 1;
 
+    const qreal rowPitch = m_uniformRowHeight + m_uniformRowMargin;
+    if (m_uniformLayout && m_groupStartIndexes.isEmpty() && rowPitch > 0) {
+        // The rows are equidistant, hence the visible rows can be calculated directly.
+        const int lastRow = maxIndex / m_columnCount;
+
+        // Include the row before the first fully visible row, as it might
+        // be partly visible
+        const int firstVisibleRow = qBound(0, qCeil((m_scrollOffset - m_firstRowOffset) / rowPitch) - 1, lastRow);
+        m_firstVisibleIndex = firstVisibleRow * m_columnCount;
+
+        const int visibleHeight = (m_scrollOrientation == Qt::Horizontal) ? m_size.width() : m_size.height();
+        qreal bottom = m_scrollOffset + visibleHeight;
+        if (m_model->groupedSorting()) {
+            bottom += m_groupHeaderHeight;
+        }
+
+        const int lastVisibleRow = qBound(firstVisibleRow, qFloor((bottom - m_firstRowOffset) / rowPitch), lastRow);
+        m_lastVisibleIndex = qMin(maxIndex, (lastVisibleRow + 1) * m_columnCount - 1);
+
+        m_visibleIndexesDirty = false;
+        return;
+    }
+
     // Calculate the first visible index that is fully visible
     int min = 0;
     int max = maxIndex;
     int mid = 0;
     do {
         mid = (min + max) / 2;
-        if (m_rowOffsets.at(m_itemInfos[mid].row) < m_scrollOffset) {
+        if (rowOffset(rowOfItem(mid)) < m_scrollOffset) {
             min = mid + 1;
         } else {
             max = mid - 1;
@@ -555,13 +719,13 @@ void KItemListViewLayouter::updateVisibleIndexes()
     if (mid > 0) {
         // Include the row before the first fully visible index, as it might
         // be partly visible
-        if (m_rowOffsets.at(m_itemInfos[mid].row) >= m_scrollOffset) {
+        if (rowOffset(rowOfItem(mid)) >= m_scrollOffset) {
             --mid;
-            Q_ASSERT(m_rowOffsets.at(m_itemInfos[mid].row) < m_scrollOffset);
+            Q_ASSERT(rowOffset(rowOfItem(mid)) < m_scrollOffset);
         }
 
-        const int firstVisibleRow = m_itemInfos[mid].row;
-        while (mid > 0 && m_itemInfos[mid - 1].row == firstVisibleRow) {
+        const int firstVisibleRow = rowOfItem(mid);
+        while (mid > 0 && rowOfItem(mid - 1) == firstVisibleRow) {
             --mid;
         }
     }
@@ -578,14 +742,14 @@ void KItemListViewLayouter::updateVisibleIndexes()
     max = maxIndex;
     do {
         mid = (min + max) / 2;
-        if (m_rowOffsets.at(m_itemInfos[mid].row) <= bottom) {
+        if (rowOffset(rowOfItem(mid)) <= bottom) {
             min = mid + 1;
         } else {
             max = mid - 1;
         }
     } while (min <= max);
 
-    while (mid > 0 && m_rowOffsets.at(m_itemInfos[mid].row) > bottom) {
+    while (mid > 0 && rowOffset(rowOfItem(mid)) > bottom) {
         --mid;
     }
     m_lastVisibleIndex = mid;
@@ -593,6 +757,107 @@ void KItemListViewLayouter::updateVisibleIndexes()
     m_visibleIndexesDirty = false;
 }
 
+void KItemListViewLayouter::resolveExactSizeHints()
+{
+    for (int pass = 0; pass < MaximumResolvePasses; ++pass) {
+        if (m_firstVisibleIndex < 0) {
+            return;
+        }
+
+        const int visibleCount = m_lastVisibleIndex - m_firstVisibleIndex + 1;
+        const QHash<int, qreal> previousHeights = m_sizeHintResolver->resolveExactSizeHints(m_firstVisibleIndex - visibleCount,
+                                                                                           m_lastVisibleIndex + visibleCount);
+        if (previousHeights.isEmpty()) {
+            return;
+        }
+
+        for (QHash<int, qreal>::const_iterator it = previousHeights.constBegin(); it != previousHeights.constEnd(); ++it) {
+            updateRowHeight(it.key());
+        }
+
+        m_visibleIndexesDirty = true;
+        updateVisibleIndexes();
+    }
+}
+
+void KItemListViewLayouter::updateRowHeight(int index)
+{
+    const bool horizontalScrolling = (m_scrollOrientation == Qt::Horizontal);
+    qreal rowHeight = horizontalScrolling ? m_itemSize.width() : m_itemSize.height();
+    if (horizontalScrolling && !m_groupItemIndexes.isEmpty() && m_model->groupedSorting()) {
+        rowHeight = qMax(rowHeight, minimumGroupHeaderWidth());
+    }
+
+    const int row = m_itemInfos.at(index).row;
+    while (index > 0 && m_itemInfos.at(index - 1).row == row) {
+        --index;
+    }
+
+    const int itemCount = m_itemInfos.count();
+    for (; index < itemCount && m_itemInfos.at(index).row == row; ++index) {
+        rowHeight = qMax(rowHeight, m_sizeHintResolver->sizeHint(index).height());
+    }
+
+    const qreal delta = rowHeight - m_rowHeights.at(row);
+    if (delta == 0.0) {
+        return;
+    }
+
+    // Move all following rows lazily, see rowOffset().
+    m_rowHeights[row] = rowHeight;
+    if (row + 1 < m_rowShifts.count()) {
+        m_rowShifts.add(row + 1, delta);
+        m_hasRowShifts = true;
+    }
+    m_maximumScrollOffset += delta;
+    m_visibleIndexesDirty = true;
+}
+
+int KItemListViewLayouter::rowOfItem(int index) const
+{
+    return m_uniformLayout ? index / m_columnCount : m_itemInfos.at(index).row;
+}
+
+int KItemListViewLayouter::columnOfItem(int index) const
+{
+    return m_uniformLayout ? index % m_columnCount : m_itemInfos.at(index).column;
+}
+
+qreal KItemListViewLayouter::rowOffset(int row) const
+{
+    if (m_uniformLayout) {
+        qreal offset = m_firstRowOffset + row * (m_uniformRowHeight + m_uniformRowMargin);
+        if (!m_groupStartIndexes.isEmpty()) {
+            // Add the space for the group headers before the row. As grouped
+            // uniform layouts only have one column, rows and indexes are equal.
+            const int groupCount = std::upper_bound(m_groupStartIndexes.constBegin(), m_groupStartIndexes.constEnd(), row)
+                                   - m_groupStartIndexes.constBegin();
+            offset += groupCount * m_groupStartOffset;
+        }
+        return offset;
+    }
+
+    if (m_hasRowShifts) {
+        return m_rowOffsets.at(row) + m_rowShifts.prefixSum(row);
+    }
+    return m_rowOffsets.at(row);
+}
+
+void KItemListViewLayouter::applyRowShifts()
+{
+    if (!m_hasRowShifts) {
+        return;
+    }
+
+    const QVector<qreal> shifts = m_rowShifts.prefixSums();
+    for (int row = 0; row < shifts.count(); ++row) {
+        m_rowOffsets[row] += shifts.at(row);
+    }
+
+    m_rowShifts.reset(m_rowShifts.count());
+    m_hasRowShifts = false;
+}
+
 bool KItemListViewLayouter::createGroupHeaders()
 {
     if (!m_model->groupedSorting()) {
@@ -21,7 +21,10 @@
 #define KITEMLISTVIEWLAYOUTER_H
 
 #include "dolphin_export.h"
+#include "kitemviews/kitemrange.h"
+#include "kprefixsumtree.h"
 
+#include <QHash>
 #include <QObject>
 #include <QRectF>
 #include <QSet>
@@ -44,6 +47,15 @@ class KItemListSizeHintResolver;
  * marking the layouter as dirty (see markAsDirty()). This means that
  * changing properties of the layouter is not expensive, only the
  * first read of a property can get expensive.
+ *
+ * Inserting or removing items only lays out the rows starting with the
+ * first changed item again (see markAsDirty(int)). If only the size
+ * hints of items have been changed, the heights of their rows are updated
+ * and the following rows are moved lazily (see markSizesAsDirty()).
+ *
+ * If all items have the same size hint, e.g. in the Details layout, the
+ * geometry of the items is calculated from their index and nothing is
+ * stored per item.
  */
 class DOLPHIN_EXPORT KItemListViewLayouter : public QObject
 {
@@ -162,6 +174,21 @@ public:
      */
     void markAsDirty();
 
+    /**
+     * Marks the layout of the items starting with the index \p index as dirty,
+     * e.g. because items have been inserted, removed or moved there. The
+     * items before \p index must not have been changed. Only the rows
+     * starting with the row of the item \p index are laid out again.
+     */
+    void markAsDirty(int index);
+
+    /**
+     * Marks the size hints of the \p count items starting with the index
+     * \p index as dirty. The number of items and their groups must not have
+     * been changed. Only the heights of the rows of the items are updated.
+     */
+    void markSizesAsDirty(int index, int count);
+
     inline int columnCount() const
     {
         return m_columnCount;
@@ -181,6 +208,33 @@ private:
     void updateVisibleIndexes();
     bool createGroupHeaders();
 
+    /**
+     * Requests the exact size hints of the visible items and of the items
+     * within one page before and after them from the size hint resolver,
+     * and corrects the layout if the estimated size hints were wrong.
+     */
+    void resolveExactSizeHints();
+
+    /**
+     * Updates the height of the row of the item with the index \p index
+     * and moves all following rows by the difference.
+     */
+    void updateRowHeight(int index);
+
+    int rowOfItem(int index) const;
+    int columnOfItem(int index) const;
+
+    /**
+     * @return The y-coordinate of the row \p row, including the pending
+     *         shifts of updateRowHeight().
+     */
+    qreal rowOffset(int row) const;
+
+    /**
+     * Applies the pending shifts of updateRowHeight() to m_rowOffsets.
+     */
+    void applyRowShifts();
+
     /**
      * @return Minimum width of group headers when grouping is enabled in the horizontal
      *         alignment mode. The header alignment is done like this:
@@ -195,6 +249,11 @@ private:
     bool m_dirty;
     bool m_visibleIndexesDirty;
 
+    // Index of the first item that must be laid out again. Is only
+    // valid if m_dirty is true.
+    int m_firstDirtyIndex;
+    KItemRangeList m_dirtySizeRanges;
+
     Qt::Orientation m_scrollOrientation;
     QSizeF m_size;
 
@@ -217,7 +276,12 @@ private:
     qreal m_xPosInc;
     int m_columnCount;
 
+    // The y-coordinate of a row is the sum of its entry in m_rowOffsets and
+    // the prefix sum of m_rowShifts, see rowOffset().
     QVector<qreal> m_rowOffsets;
+    QVector<qreal> m_rowHeights;
+    KPrefixSumTree m_rowShifts;
+    bool m_hasRowShifts;
     QVector<qreal> m_columnOffsets;
 
     // Stores all item indexes that are the first item of a group.
@@ -231,6 +295,17 @@ private:
         int row;
     };
     QVector<ItemInfo> m_itemInfos;
+    int m_itemCount;
+
+    // If true, all rows have the height m_uniformRowHeight, and m_itemInfos,
+    // m_rowOffsets and m_rowHeights are empty. The first items of all groups
+    // except the first one are stored in m_groupStartIndexes.
+    bool m_uniformLayout;
+    qreal m_uniformRowHeight;
+    qreal m_uniformRowMargin;
+    qreal m_firstRowOffset;
+    QVector<int> m_groupStartIndexes;
+    qreal m_groupStartOffset;
 
     friend class KItemListControllerTest;
 };
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kmimetyperesolver.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QtConcurrentMap>
+
+namespace {
+    // Number of items that are resolved in parallel by one batch. The
+    // results are announced when all items of a batch have been resolved.
+    const int BatchSize = 200;
+
+    KFileItem resolveMimeType(const KFileItem& item)
+    {
+        const KFileItem resolvedItem(item.entry(), item.url());
+        resolvedItem.determineMimeType();
+        return resolvedItem;
+    }
+}
+
+KMimeTypeResolver::KMimeTypeResolver(QObject* parent) :
+    QObject(parent),
+    m_pendingItems(),
+    m_itemsBeingResolved(),
+    m_queuedUrls(),
+    m_watcher(nullptr)
+{
+    m_watcher = new QFutureWatcher<KFileItem>(this);
+    connect(m_watcher, &QFutureWatcher<KFileItem>::finished,
+            this,      &KMimeTypeResolver::slotBatchResolved);
+}
+
+KMimeTypeResolver::~KMimeTypeResolver()
+{
+    m_watcher->disconnect(this);
+    m_watcher->cancel();
+    m_watcher->waitForFinished();
+}
+
+void KMimeTypeResolver::resolve(const KFileItemList& items)
+{
+    foreach (const KFileItem& item, items) {
+        if (canResolve(item) && !m_queuedUrls.contains(item.url())) {
+            m_queuedUrls.insert(item.url());
+            m_pendingItems.append(item);
+        }
+    }
+
+    if (m_itemsBeingResolved.isEmpty()) {
+        startNextBatch();
+    }
+}
+
+bool KMimeTypeResolver::isResolving() const
+{
+    return !m_itemsBeingResolved.isEmpty() || !m_pendingItems.isEmpty();
+}
+
+bool KMimeTypeResolver::canResolve(const KFileItem& item)
+{
+    return !item.isNull()
+        && item.isLocalFile()
+        && !item.isDir()
+        && !item.isMimeTypeKnown()
+        && item.entry().count() > 0;
+}
+
+KFileItemList KMimeTypeResolver::determineMimeTypes(const KFileItemList& items, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // The copies in 'sequence' share their data with the passed items.
+    // Items that are reached after the timeout has been exceeded are skipped.
+    KFileItemList sequence = items;
+    QtConcurrent::blockingMap(sequence, [&timer, timeout](KFileItem& item) {
+        if (timer.elapsed() <= timeout) {
+            item.determineMimeType();
+        }
+    });
+
+    KFileItemList unresolvedItems;
+    foreach (const KFileItem& item, items) {
+        if (!item.isMimeTypeKnown()) {
+            unresolvedItems.append(item);
+        }
+    }
+    return unresolvedItems;
+}
+
+void KMimeTypeResolver::slotBatchResolved()
+{
+    const QList<KFileItem> resolvedItems = m_watcher->future().results();
+
+    QHash<QUrl, KFileItem> items;
+    items.reserve(resolvedItems.count());
+    foreach (const KFileItem& item, resolvedItems) {
+        items.insert(item.url(), item);
+    }
+
+    foreach (const KFileItem& item, m_itemsBeingResolved) {
+        m_queuedUrls.remove(item.url());
+    }
+    m_itemsBeingResolved.clear();
+
+    // Keep the worker threads busy while the receivers apply the results.
+    startNextBatch();
+
+    emit mimeTypesResolved(items);
+}
+
+void KMimeTypeResolver::startNextBatch()
+{
+    if (m_pendingItems.isEmpty()) {
+        return;
+    }
+
+    const int count = qMin(BatchSize, m_pendingItems.count());
+    m_itemsBeingResolved = m_pendingItems.mid(0, count);
+    m_pendingItems.erase(m_pendingItems.begin(), m_pendingItems.begin() + count);
+
+    m_watcher->setFuture(QtConcurrent::mapped(m_itemsBeingResolved, resolveMimeType));
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef KMIMETYPERESOLVER_H
+#define KMIMETYPERESOLVER_H
+
+#include "dolphin_export.h"
+
+#include <KFileItem>
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QUrl>
+
+template <typename T> class QFutureWatcher;
+
+/**
+ * @brief Determines the MIME types of many items in parallel.
+ *
+ * KFileItem::determineMimeType() might have to read the beginning of a file
+ * to detect its content. Doing this item by item in the GUI thread blocks the
+ * user interface for large directories. KMimeTypeResolver determines the MIME
+ * types of many items concurrently in worker threads of the global QThreadPool.
+ *
+ * The items passed to resolve() share their data with copies in the GUI
+ * thread, so they are not modified. Instead, new items are created from
+ * their UDS entries, and the resolved items are announced in batches by
+ * the signal mimeTypesResolved().
+ */
+class DOLPHIN_EXPORT KMimeTypeResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KMimeTypeResolver(QObject* parent = nullptr);
+    ~KMimeTypeResolver() override;
+
+    /**
+     * Determines the MIME types of \a items asynchronously. Items that cannot
+     * be resolved (see canResolve()) and items that are being resolved
+     * already are ignored.
+     */
+    void resolve(const KFileItemList& items);
+
+    /**
+     * @return True if items are being resolved, or if there are pending items.
+     */
+    bool isResolving() const;
+
+    /**
+     * @return True if the MIME type of \a item is unknown and can be determined
+     *         by resolve(). Only local files can be created again from their UDS
+     *         entries without accessing the network, and directories do not need
+     *         any content detection.
+     */
+    static bool canResolve(const KFileItem& item);
+
+    /**
+     * Determines the MIME types of \a items in parallel and blocks the calling
+     * thread until all MIME types are known or \a timeout ms have passed. In
+     * contrast to resolve(), the MIME types are determined for the passed items.
+     * This is only safe if no other thread accesses the items in the meantime.
+     * @return The items whose MIME types are still unknown.
+     */
+    static KFileItemList determineMimeTypes(const KFileItemList& items, int timeout);
+
+signals:
+    /**
+     * Is emitted when the MIME types of a batch of items have been determined.
+     * The resolved items are stored with their URLs as keys.
+     */
+    void mimeTypesResolved(const QHash<QUrl, KFileItem>& items);
+
+private slots:
+    void slotBatchResolved();
+
+private:
+    void startNextBatch();
+
+private:
+    KFileItemList m_pendingItems;
+    KFileItemList m_itemsBeingResolved;
+    QSet<QUrl> m_queuedUrls; // URLs of m_pendingItems and m_itemsBeingResolved
+    QFutureWatcher<KFileItem>* m_watcher;
+};
+
+#endif
@@ -22,6 +22,9 @@
 
 #include "dolphin_export.h"
 
+#include <QtGlobal>
+
+class QImage;
 class QPixmap;
 class QSize;
 
@@ -36,11 +39,17 @@ public:
     static void scale(QPixmap& pixmap, const QSize& scaledSize);
 
     /**
-     * Resize and paint a frame round an icon
+     * Scale an image to a given size. Can be used in any thread.
+     * @arg scaledSize is in device pixels
+     */
+    static void scale(QImage& image, const QSize& scaledSize);
+
+    /**
+     * Resize and paint a frame round an icon. Can be used in any thread.
      * @arg scaledSize is in device-independent pixels
-     * The returned image will be scaled by the application devicePixelRatio
+     * The returned image will be scaled by \a devicePixelRatio
      */
-    static void applyFrame(QPixmap& icon, const QSize& scaledSize);
+    static void applyFrame(QImage& icon, const QSize& scaledSize, qreal devicePixelRatio);
 
     /**
      * return and paint a frame round an icon
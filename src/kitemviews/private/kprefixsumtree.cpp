@@ -0,0 +1,77 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#include "kprefixsumtree.h"
+
+KPrefixSumTree::KPrefixSumTree() :
+    m_nodes(1, 0.0)
+{
+}
+
+void KPrefixSumTree::reset(int count)
+{
+    m_nodes.fill(0.0, count + 1);
+}
+
+int KPrefixSumTree::count() const
+{
+    return m_nodes.count() - 1;
+}
+
+void KPrefixSumTree::add(int index, qreal delta)
+{
+    Q_ASSERT(index >= 0 && index < count());
+    const int nodeCount = m_nodes.count();
+    for (int i = index + 1; i < nodeCount; i += i & -i) {
+        m_nodes[i] += delta;
+    }
+}
+
+qreal KPrefixSumTree::prefixSum(int index) const
+{
+    Q_ASSERT(index < count());
+    qreal sum = 0.0;
+    for (int i = index + 1; i > 0; i -= i & -i) {
+        sum += m_nodes.at(i);
+    }
+    return sum;
+}
+
+QVector<qreal> KPrefixSumTree::prefixSums() const
+{
+    // Recover the values by reverting the linear-time construction of
+    // the tree, and sum them up.
+    QVector<qreal> values = m_nodes;
+    const int nodeCount = values.count();
+    for (int i = nodeCount - 1; i > 0; --i) {
+        const int parent = i + (i & -i);
+        if (parent < nodeCount) {
+            values[parent] -= values.at(i);
+        }
+    }
+
+    QVector<qreal> sums(nodeCount - 1);
+    qreal sum = 0.0;
+    for (int i = 1; i < nodeCount; ++i) {
+        sum += values.at(i);
+        sums[i - 1] = sum;
+    }
+    return sums;
+}
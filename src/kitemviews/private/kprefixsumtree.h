@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#ifndef KPREFIXSUMTREE_H
+#define KPREFIXSUMTREE_H
+
+#include "dolphin_export.h"
+
+#include <QVector>
+
+/**
+ * @brief Fenwick tree of values which allows to change a value and to
+ *        get the sum of the first values in O(log n).
+ *
+ * KItemListViewLayouter uses it to move all following rows lazily if the
+ * height of a row has been changed.
+ */
+class DOLPHIN_EXPORT KPrefixSumTree
+{
+public:
+    KPrefixSumTree();
+
+    /**
+     * Resizes the tree to \a count values and sets all values to 0.
+     */
+    void reset(int count);
+
+    int count() const;
+
+    /**
+     * Adds \a delta to the value with the index \a index.
+     */
+    void add(int index, qreal delta);
+
+    /**
+     * @return Sum of the values with the indexes 0 to \a index.
+     */
+    qreal prefixSum(int index) const;
+
+    /**
+     * @return Sums of the values with the indexes 0 to i for each index i.
+     *         Is much faster than calling prefixSum() for each index.
+     */
+    QVector<qreal> prefixSums() const;
+
+private:
+    // The node with the index i contains the sum of the values in the
+    // range [i - (i & -i) + 1, i]. The index 0 is unused.
+    QVector<qreal> m_nodes;
+};
+
+#endif
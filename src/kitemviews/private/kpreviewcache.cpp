@@ -0,0 +1,388 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kpreviewcache.h"
+
+#include <KFileItem>
+#include <KIO/UDSEntry>
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QPixmap>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+namespace {
+    // Identifies the format of the cache files. Must be changed whenever
+    // the format is changed.
+    const quint32 CacheFileMagic = 0x44504301;
+    const QDataStream::Version CacheFileStreamVersion = QDataStream::Qt_5_6;
+
+    // Maximum total size of the cache files of all directories
+    const qint64 MaximumCacheSize = 100 * 1024 * 1024;
+}
+
+KPreviewCache::Stamp::Stamp() :
+    device(0),
+    inode(0),
+    modificationTime(0),
+    size(0)
+{
+}
+
+bool KPreviewCache::Stamp::operator==(const Stamp& other) const
+{
+    return device == other.device
+        && inode == other.inode
+        && modificationTime == other.modificationTime
+        && size == other.size;
+}
+
+KPreviewCache::Entry::Entry() :
+    stamp(),
+    devicePixelRatio(1),
+    offset(0),
+    length(0),
+    png(),
+    image()
+{
+}
+
+KPreviewCache::KPreviewCache(QObject* parent) :
+    QObject(parent),
+    m_filePath(),
+    m_file(),
+    m_data(nullptr),
+    m_dataSize(0),
+    m_entries(),
+    m_modified(false),
+    m_writerPool(nullptr)
+{
+    // The cache files are written one after the other, so that a cache
+    // file is never written by two threads at the same time.
+    m_writerPool = new QThreadPool(this);
+    m_writerPool->setMaxThreadCount(1);
+}
+
+KPreviewCache::~KPreviewCache()
+{
+    flush();
+    unload();
+    // Deleting m_writerPool waits until the cache files have been written.
+}
+
+void KPreviewCache::load(const QUrl& directory, const QByteArray& configuration)
+{
+    const QString filePath = directory.isLocalFile() ? cacheFilePath(directory, configuration) : QString();
+    if (filePath == m_filePath) {
+        return;
+    }
+
+    flush();
+    unload();
+
+    m_filePath = filePath;
+    if (m_filePath.isEmpty()) {
+        return;
+    }
+
+    QFile* file = new QFile(m_filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        // No previews have been cached for this directory yet
+        delete file;
+        return;
+    }
+
+    const qint64 dataSize = file->size();
+    uchar* data = file->map(0, dataSize);
+    if (!data) {
+        delete file;
+        return;
+    }
+
+    // The file stays mapped until the last writer thread that reads
+    // from it has finished, even if another directory is loaded.
+    m_file = QSharedPointer<QFile>(file, [data](QFile* file) {
+        file->unmap(data);
+        delete file;
+    });
+    m_data = data;
+    m_dataSize = dataSize;
+
+    // Read the index of the cache file. The PNG data of the previews
+    // follows the index and is only decoded on demand by preview().
+    QByteArray content = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), m_dataSize);
+    QBuffer buffer(&content);
+    buffer.open(QIODevice::ReadOnly);
+    QDataStream stream(&buffer);
+    stream.setVersion(CacheFileStreamVersion);
+
+    quint32 magic = 0;
+    qint32 count = 0;
+    stream >> magic >> count;
+    if (magic != CacheFileMagic || count < 0) {
+        return;
+    }
+
+    QHash<QString, Entry> entries;
+    entries.reserve(count);
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString path;
+        Entry entry;
+        stream >> path
+               >> entry.stamp.device >> entry.stamp.inode
+               >> entry.stamp.modificationTime >> entry.stamp.size
+               >> entry.devicePixelRatio >> entry.offset >> entry.length;
+        entries.insert(path, entry);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        return;
+    }
+
+    // The offsets are stored relative to the end of the index.
+    const qint64 dataStart = buffer.pos();
+    for (QHash<QString, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        it->offset += dataStart;
+        if (it->offset < dataStart || it->length < 0 || it->offset + it->length > m_dataSize) {
+            // The cache file is corrupt
+            return;
+        }
+    }
+
+    m_entries = entries;
+}
+
+QPixmap KPreviewCache::preview(const KFileItem& item) const
+{
+    if (m_entries.isEmpty() || !canCache(item)) {
+        return QPixmap();
+    }
+
+    const QHash<QString, Entry>::const_iterator it = m_entries.constFind(item.localPath());
+    if (it == m_entries.constEnd() || !(it->stamp == stamp(item))) {
+        return QPixmap();
+    }
+
+    QImage image = it->image;
+    if (image.isNull()) {
+        const bool loaded = it->png.isEmpty()
+            ? image.loadFromData(m_data + it->offset, static_cast<int>(it->length), "PNG")
+            : image.loadFromData(it->png, "PNG");
+        if (!loaded) {
+            return QPixmap();
+        }
+    }
+
+    QPixmap pixmap = QPixmap::fromImage(image);
+    pixmap.setDevicePixelRatio(it->devicePixelRatio);
+    return pixmap;
+}
+
+void KPreviewCache::insert(const KFileItem& item, const QImage& preview)
+{
+    if (m_filePath.isEmpty() || preview.isNull() || !canCache(item)) {
+        return;
+    }
+
+    Entry entry;
+    entry.stamp = stamp(item);
+    entry.devicePixelRatio = preview.devicePixelRatio();
+    entry.image = preview;
+    m_entries.insert(item.localPath(), entry);
+    m_modified = true;
+}
+
+void KPreviewCache::flush()
+{
+    if (!m_modified) {
+        return;
+    }
+    m_modified = false;
+
+    // Only the images that have not been written yet are encoded by the worker
+    // thread. Afterwards the images are replaced by their PNG data, so that they
+    // are not kept in memory and not encoded again by the next flush().
+    //
+    // The PNG data of the other previews is read from the mapped file by the
+    // worker thread. The connection to the watcher shares the ownership of
+    // m_file, so that the file is unmapped in this thread after the worker
+    // thread has finished, even if another directory is loaded in the meantime.
+    typedef QFutureWatcher<QHash<QString, EncodedImage> > Watcher;
+    Watcher* watcher = new Watcher(this);
+    const QString filePath = m_filePath;
+    const QSharedPointer<QFile> mappedFile = m_file;
+    connect(watcher, &Watcher::finished, this, [this, watcher, filePath, mappedFile]() {
+        replaceEncodedImages(filePath, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(m_writerPool, &KPreviewCache::writeCacheFile, m_filePath, m_entries, m_data));
+}
+
+bool KPreviewCache::canCache(const KFileItem& item)
+{
+    return !item.isNull()
+        && item.isLocalFile()
+        && !item.localPath().isEmpty()
+        && item.time(KFileItem::ModificationTime).isValid();
+}
+
+KPreviewCache::Stamp KPreviewCache::stamp(const KFileItem& item)
+{
+    const KIO::UDSEntry entry = item.entry();
+
+    Stamp stamp;
+    stamp.device = entry.numberValue(KIO::UDSEntry::UDS_DEVICE_ID, 0);
+    stamp.inode = entry.numberValue(KIO::UDSEntry::UDS_INODE, 0);
+    stamp.modificationTime = item.time(KFileItem::ModificationTime).toMSecsSinceEpoch();
+    stamp.size = item.size();
+    return stamp;
+}
+
+QString KPreviewCache::cacheFilePath(const QUrl& directory, const QByteArray& configuration)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(directory.toEncoded(QUrl::StripTrailingSlash));
+    hash.addData("\n");
+    hash.addData(configuration);
+
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+         + QLatin1String("/previews/") + QString::fromLatin1(hash.result().toHex());
+}
+
+QHash<QString, KPreviewCache::EncodedImage> KPreviewCache::writeCacheFile(const QString& filePath,
+                                                                         const QHash<QString, Entry>& entries,
+                                                                         const uchar* data)
+{
+    QHash<QString, EncodedImage> encodedImages;
+    QByteArray index;
+    QByteArray previews;
+    int count = 0;
+
+    QDataStream indexStream(&index, QIODevice::WriteOnly);
+    indexStream.setVersion(CacheFileStreamVersion);
+    for (QHash<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        // Skip the previews of files that have been deleted in the meantime
+        if (!QFileInfo::exists(it.key())) {
+            continue;
+        }
+
+        QByteArray png;
+        if (!it->image.isNull()) {
+            QBuffer buffer(&png);
+            buffer.open(QIODevice::WriteOnly);
+            // Prefer a fast encoding over a small cache file
+            it->image.save(&buffer, "PNG", 80);
+            encodedImages.insert(it.key(), {it->image.cacheKey(), png});
+        } else if (!it->png.isEmpty()) {
+            png = it->png;
+        } else if (data) {
+            png = QByteArray::fromRawData(reinterpret_cast<const char*>(data + it->offset), static_cast<int>(it->length));
+        }
+
+        if (png.isEmpty()) {
+            continue;
+        }
+
+        indexStream << it.key()
+                    << it->stamp.device << it->stamp.inode
+                    << it->stamp.modificationTime << it->stamp.size
+                    << it->devicePixelRatio << qint64(previews.size()) << qint64(png.size());
+        previews.append(png);
+        ++count;
+    }
+
+    const QString directoryPath = QFileInfo(filePath).absolutePath();
+    QDir().mkpath(directoryPath);
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return QHash<QString, EncodedImage>();
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(CacheFileStreamVersion);
+    stream << CacheFileMagic << qint32(count);
+    file.write(index);
+    file.write(previews);
+    if (!file.commit()) {
+        return QHash<QString, EncodedImage>();
+    }
+
+    removeOldCacheFiles(directoryPath, MaximumCacheSize, filePath);
+    return encodedImages;
+}
+
+void KPreviewCache::removeOldCacheFiles(const QString& directoryPath, qint64 maximumSize, const QString& keptFilePath)
+{
+    // The cache files are rewritten whenever new previews have been
+    // inserted, so the modification time tells when a file has been used.
+    // The names of the cache files are MD5 hashes, which skips the temporary
+    // files of QSaveFile instances that are being written by other processes.
+    const QStringList nameFilters(QString(32, QLatin1Char('?')));
+    const QFileInfoList files = QDir(directoryPath).entryInfoList(nameFilters, QDir::Files, QDir::Time);
+
+    qint64 totalSize = 0;
+    foreach (const QFileInfo& file, files) {
+        totalSize += file.size();
+    }
+
+    // Remove the oldest files first.
+    for (int i = files.count() - 1; i >= 0 && totalSize > maximumSize; --i) {
+        const QFileInfo& file = files.at(i);
+        if (file.absoluteFilePath() != QFileInfo(keptFilePath).absoluteFilePath() && QFile::remove(file.absoluteFilePath())) {
+            totalSize -= file.size();
+        }
+    }
+}
+
+void KPreviewCache::replaceEncodedImages(const QString& filePath, const QHash<QString, EncodedImage>& encodedImages)
+{
+    if (filePath != m_filePath) {
+        // Another directory has been loaded in the meantime
+        return;
+    }
+
+    for (QHash<QString, EncodedImage>::const_iterator it = encodedImages.constBegin(); it != encodedImages.constEnd(); ++it) {
+        const QHash<QString, Entry>::iterator entry = m_entries.find(it.key());
+        // The preview might have been replaced since flush() has been called.
+        if (entry != m_entries.end() && entry->image.cacheKey() == it->imageKey) {
+            entry->png = it->png;
+            entry->image = QImage();
+        }
+    }
+}
+
+void KPreviewCache::unload()
+{
+    // The file is unmapped when the last writer thread has finished, see flush().
+    m_file.reset();
+    m_data = nullptr;
+    m_dataSize = 0;
+    m_entries.clear();
+    m_modified = false;
+    m_filePath.clear();
+}
@@ -0,0 +1,167 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#ifndef KPREVIEWCACHE_H
+#define KPREVIEWCACHE_H
+
+#include "dolphin_export.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QSharedPointer>
+#include <QUrl>
+
+class KFileItem;
+class QFile;
+class QPixmap;
+class QThreadPool;
+
+/**
+ * @brief Persistent cache for the final previews of the items of a directory.
+ *
+ * KIO::PreviewJob caches the thumbnails with a size of 128 or 256 pixels,
+ * so when a directory is opened again, each preview must still be scaled,
+ * framed and converted into a pixmap. KPreviewCache stores the previews
+ * that are shown by the view, i.e., after the frame has been applied, in
+ * one file per directory and configuration (icon size, device pixel ratio,
+ * enabled plugins, ...).
+ *
+ * The cache file is memory-mapped by load(). Only its index is read
+ * immediately, the preview of an item is decoded when it is requested by
+ * preview(). New previews are encoded and written back in a worker thread
+ * by flush(). Afterwards only their encoded data is kept in memory.
+ *
+ * The size of all cache files is limited, the cache files that have not
+ * been written for the longest time are removed first.
+ *
+ * The previews are identified by the local path of the item. They are only
+ * valid as long as the device, inode, modification time and size of the
+ * file are unchanged. Only previews of local files are cached.
+ */
+class DOLPHIN_EXPORT KPreviewCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KPreviewCache(QObject* parent = nullptr);
+    ~KPreviewCache() override;
+
+    /**
+     * Loads the previews of the items inside \a directory. The \a configuration
+     * identifies all settings that have an influence on the look of the
+     * previews. If another directory or configuration has been loaded before,
+     * its new previews are flushed first.
+     */
+    void load(const QUrl& directory, const QByteArray& configuration);
+
+    /**
+     * @return The cached preview of \a item, or a null pixmap if no valid
+     *         preview has been cached.
+     */
+    QPixmap preview(const KFileItem& item) const;
+
+    /**
+     * Adds the \a preview of \a item to the cache. It is written to disk by
+     * the next call of flush().
+     */
+    void insert(const KFileItem& item, const QImage& preview);
+
+    /**
+     * Writes the cache file in a worker thread if previews have been
+     * inserted since the last call.
+     */
+    void flush();
+
+    /**
+     * @return True if previews of \a item can be cached.
+     */
+    static bool canCache(const KFileItem& item);
+
+private:
+    struct Stamp
+    {
+        Stamp();
+        quint64 device;
+        quint64 inode;
+        qint64 modificationTime;
+        quint64 size;
+
+        bool operator==(const Stamp& other) const;
+    };
+
+    struct Entry
+    {
+        Entry();
+        Stamp stamp;
+        qreal devicePixelRatio;
+        qint64 offset;  // Position of the PNG data inside the mapped file
+        qint64 length;
+        QByteArray png; // PNG data of previews that are not part of the mapped file
+        QImage image;   // Previews that have not been encoded yet
+    };
+
+    struct EncodedImage
+    {
+        qint64 imageKey; // QImage::cacheKey() of the encoded image
+        QByteArray png;
+    };
+
+    static Stamp stamp(const KFileItem& item);
+    static QString cacheFilePath(const QUrl& directory, const QByteArray& configuration);
+
+    /**
+     * Writes \a entries to the cache file \a filePath. The PNG data of the
+     * entries that are only part of the mapped file is read from \a data,
+     * which must stay mapped until the cache file has been written.
+     * @return The PNG data of the images of \a entries if the cache file has
+     *         been written successfully, otherwise an empty hash.
+     */
+    static QHash<QString, EncodedImage> writeCacheFile(const QString& filePath, const QHash<QString, Entry>& entries,
+                                                       const uchar* data);
+
+    /**
+     * Removes the least recently written cache files inside \a directoryPath until
+     * their total size does not exceed \a maximumSize. The cache file
+     * \a keptFilePath is never removed.
+     */
+    static void removeOldCacheFiles(const QString& directoryPath, qint64 maximumSize, const QString& keptFilePath);
+
+    /**
+     * Replaces the images of the entries by the PNG data \a encodedImages
+     * after the cache file \a filePath has been written.
+     */
+    void replaceEncodedImages(const QString& filePath, const QHash<QString, EncodedImage>& encodedImages);
+
+    void unload();
+
+private:
+    QString m_filePath;
+    QSharedPointer<QFile> m_file; // Shared with the writer threads, see flush()
+    const uchar* m_data;  // Mapped content of m_file
+    qint64 m_dataSize;
+    QHash<QString, Entry> m_entries;
+    bool m_modified;
+    QThreadPool* m_writerPool;
+
+    friend class KPreviewCacheTest; // For unit testing
+};
+
+#endif
@@ -42,7 +42,8 @@ ViewSettingsTab::ViewSettingsTab(Mode mode, QWidget* parent) :
     m_fontRequester(nullptr),
     m_widthBox(nullptr),
     m_maxLinesBox(nullptr),
-    m_expandableFolders(nullptr)
+    m_expandableFolders(nullptr),
+    m_directorySizeBox(nullptr)
 {
     QFormLayout* topLayout = new QFormLayout(this);
 
@@ -107,6 +108,11 @@ ViewSettingsTab::ViewSettingsTab(Mode mode, QWidget* parent) :
     case DetailsMode:
         m_expandableFolders = new QCheckBox(i18nc("@option:check", "Expandable"));
         topLayout->addRow(i18nc("@label:checkbox", "Folders:"), m_expandableFolders);
+
+        m_directorySizeBox = new QComboBox();
+        m_directorySizeBox->addItem(i18nc("@item:inlistbox Folder size", "Number of items"));
+        m_directorySizeBox->addItem(i18nc("@item:inlistbox Folder size", "Size of contents"));
+        topLayout->addRow(i18nc("@label:listbox", "Folder size:"), m_directorySizeBox);
         break;
     default:
         break;
@@ -128,6 +134,7 @@ ViewSettingsTab::ViewSettingsTab(Mode mode, QWidget* parent) :
         break;
     case DetailsMode:
         connect(m_expandableFolders, &QCheckBox::toggled, this, &ViewSettingsTab::changed);
+        connect(m_directorySizeBox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &ViewSettingsTab::changed);
         break;
     default:
         break;
@@ -153,6 +160,7 @@ void ViewSettingsTab::applySettings()
         break;
     case DetailsMode:
         DetailsModeSettings::setExpandableFolders(m_expandableFolders->isChecked());
+        DetailsModeSettings::setDirectorySizeCount(m_directorySizeBox->currentIndex() == 0);
         break;
     default:
         break;
@@ -201,6 +209,7 @@ void ViewSettingsTab::loadSettings()
         break;
     case DetailsMode:
         m_expandableFolders->setChecked(DetailsModeSettings::expandableFolders());
+        m_directorySizeBox->setCurrentIndex(DetailsModeSettings::directorySizeCount() ? 0 : 1);
         break;
     default:
         break;
@@ -72,6 +72,7 @@ private:
     QComboBox* m_widthBox;
     QComboBox* m_maxLinesBox;
     QCheckBox* m_expandableFolders;
+    QComboBox* m_directorySizeBox;
 };
 
 #endif
@@ -0,0 +1,181 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/private/kdirectorycontentscounter.h"
+#include "testdir.h"
+
+#include <KIO/UDSEntry>
+
+#include <QSignalSpy>
+#include <QTest>
+
+class KDirectoryContentsCounterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testCount();
+    void testSharedCache();
+    void testRecursiveSize();
+
+private:
+    KFileItem createItem(const QString& name, const QDateTime& modificationTime) const;
+
+private:
+    TestDir* m_testDir;
+    KFileItemModel* m_model;
+};
+
+void KDirectoryContentsCounterTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFiles({"a/1", "a/2", "a/3", "b/1"});
+
+    m_model = new KFileItemModel();
+}
+
+void KDirectoryContentsCounterTest::cleanup()
+{
+    delete m_model;
+    m_model = nullptr;
+
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KDirectoryContentsCounterTest::testCount()
+{
+    const QDateTime modificationTime = QDateTime::currentDateTime().addDays(-1);
+    const KFileItem a = createItem("a", modificationTime);
+    const KFileItem b = createItem("b", modificationTime);
+
+    KDirectoryContentsCounter counter(m_model);
+    QSignalSpy resultSpy(&counter, &KDirectoryContentsCounter::result);
+
+    // The directories are counted asynchronously. Requesting a directory
+    // which is being counted already does not result in another signal.
+    QCOMPARE(counter.addDirectory(a).count, -1);
+    QCOMPARE(counter.addDirectory(b).count, -1);
+    QCOMPARE(counter.addDirectory(a).count, -1);
+
+    while (resultSpy.count() < 2) {
+        QVERIFY(resultSpy.wait());
+    }
+    QVERIFY(!resultSpy.wait(100));
+    QCOMPARE(resultSpy.count(), 2);
+
+    QHash<QString, int> counts;
+    foreach (const QList<QVariant>& arguments, resultSpy) {
+        counts.insert(arguments.at(0).toString(), arguments.at(1).toInt());
+    }
+    QCOMPARE(counts.value(a.localPath()), 3);
+    QCOMPARE(counts.value(b.localPath()), 1);
+
+    // The cached numbers are returned synchronously.
+    resultSpy.clear();
+    QCOMPARE(counter.addDirectory(a).count, 3);
+    QCOMPARE(counter.addDirectory(b).count, 1);
+    QVERIFY(resultSpy.isEmpty());
+
+    // The cached number is not used if the directory has been modified.
+    QCOMPARE(counter.addDirectory(createItem("a", modificationTime.addSecs(60))).count, -1);
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(resultSpy.first().at(1).toInt(), 3);
+}
+
+void KDirectoryContentsCounterTest::testSharedCache()
+{
+    const QDateTime modificationTime = QDateTime::currentDateTime().addDays(-1);
+    const KFileItem a = createItem("a", modificationTime);
+
+    KDirectoryContentsCounter counter(m_model);
+    QSignalSpy resultSpy(&counter, &KDirectoryContentsCounter::result);
+    QCOMPARE(counter.addDirectory(a).count, -1);
+    QVERIFY(resultSpy.wait());
+
+    // Other counters use the same cache, and do not receive
+    // results which they have not requested.
+    KDirectoryContentsCounter otherCounter(m_model);
+    QSignalSpy otherResultSpy(&otherCounter, &KDirectoryContentsCounter::result);
+    QCOMPARE(otherCounter.addDirectory(a).count, 3);
+
+    QCOMPARE(otherCounter.addDirectory(createItem("b", modificationTime)).count, -1);
+    QVERIFY(otherResultSpy.wait());
+    QCOMPARE(resultSpy.count(), 1);
+}
+
+void KDirectoryContentsCounterTest::testRecursiveSize()
+{
+    m_testDir->createFile("c/1", "123456");
+    m_testDir->createFile("c/d/e/1");
+    m_testDir->createFile("c/d/e/2");
+
+    const QDateTime modificationTime = QDateTime::currentDateTime().addDays(-1);
+    const KFileItem c = createItem("c", modificationTime);
+
+    KDirectoryContentsCounter counter(m_model);
+    QSignalSpy resultSpy(&counter, &KDirectoryContentsCounter::result);
+
+    QVERIFY(!counter.countsRecursiveSize());
+    QCOMPARE(counter.addDirectory(c).count, -1);
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(resultSpy.first().at(1).toInt(), 2);
+    QCOMPARE(resultSpy.first().at(2).toLongLong(), qint64(-1));
+
+    // The number of items is cached independently from the size of the contents.
+    counter.setCountRecursiveSize(true);
+    QVERIFY(counter.countsRecursiveSize());
+
+    resultSpy.clear();
+    QCOMPARE(counter.addDirectory(c).count, -1);
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(resultSpy.first().at(1).toInt(), 2);
+    QCOMPARE(resultSpy.first().at(2).toLongLong(), qint64(6 + 4 + 4));
+
+    const KDirectoryContentsCounterWorker::CountResult result = counter.addDirectory(c);
+    QCOMPARE(result.count, 2);
+    QCOMPARE(result.size, qint64(6 + 4 + 4));
+
+    // The sizes of the sub directories have been cached while walking "c".
+    resultSpy.clear();
+    QCOMPARE(counter.addDirectory(createItem("c/d", modificationTime)).count, -1);
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(resultSpy.first().at(1).toInt(), 1);
+    QCOMPARE(resultSpy.first().at(2).toLongLong(), qint64(4 + 4));
+}
+
+KFileItem KDirectoryContentsCounterTest::createItem(const QString& name, const QDateTime& modificationTime) const
+{
+    KIO::UDSEntry entry;
+    entry.insert(KIO::UDSEntry::UDS_NAME, name);
+    entry.insert(KIO::UDSEntry::UDS_FILE_TYPE, 0040000);    // S_IFDIR might not be defined on non-Unix platforms.
+    entry.insert(KIO::UDSEntry::UDS_ACCESS, 0755);
+    entry.insert(KIO::UDSEntry::UDS_MODIFICATION_TIME, modificationTime.toSecsSinceEpoch());
+    entry.insert(KIO::UDSEntry::UDS_LOCAL_PATH, m_testDir->path() + '/' + name);
+
+    return KFileItem(entry, m_testDir->url(), false, true);
+}
+
+QTEST_GUILESS_MAIN(KDirectoryContentsCounterTest)
+
+#include "kdirectorycontentscountertest.moc"
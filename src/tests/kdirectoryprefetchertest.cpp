@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/private/kdirectoryprefetcher.h"
+#include "testdir.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+class KDirectoryPrefetcherTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testPrefetch();
+    void testMaximumDirectoryCount();
+
+private:
+    QUrl fileUrl(const QString& name) const;
+
+private:
+    TestDir* m_testDir;
+};
+
+void KDirectoryPrefetcherTest::init()
+{
+    m_testDir = new TestDir();
+}
+
+void KDirectoryPrefetcherTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KDirectoryPrefetcherTest::testPrefetch()
+{
+    m_testDir->createFile("a/script", "#!/bin/sh\necho test\n");
+    m_testDir->createFile("a/text.txt");
+    m_testDir->createDir("a/b");
+
+    KDirectoryPrefetcher prefetcher;
+    QSignalSpy prefetchingCompletedSpy(&prefetcher, &KDirectoryPrefetcher::prefetchingCompleted);
+
+    const QUrl url = fileUrl("a");
+    QVERIFY(!prefetcher.isPrefetched(url));
+
+    prefetcher.prefetch(url);
+    QVERIFY(prefetcher.isPrefetched(url));
+    QVERIFY(prefetchingCompletedSpy.wait());
+    QCOMPARE(prefetchingCompletedSpy.last().at(0).toUrl(), url);
+    QCOMPARE(prefetcher.itemCount(), 3);
+
+    // The MIME types of the prefetched files are known already.
+    const QHash<QUrl, KFileItem> items = prefetcher.takeItems(url);
+    QCOMPARE(items.value(fileUrl("a/script")).mimetype(), QStringLiteral("application/x-shellscript"));
+    QCOMPARE(items.value(fileUrl("a/text.txt")).mimetype(), QStringLiteral("text/plain"));
+
+    QVERIFY(!prefetcher.isPrefetched(url));
+    QCOMPARE(prefetcher.itemCount(), 0);
+    QVERIFY(prefetcher.takeItems(url).isEmpty());
+}
+
+void KDirectoryPrefetcherTest::testMaximumDirectoryCount()
+{
+    const QStringList names = {"a", "b", "c", "d"};
+    foreach (const QString& name, names) {
+        m_testDir->createFile(name + "/file");
+    }
+
+    KDirectoryPrefetcher prefetcher;
+    prefetcher.prefetch(fileUrl("a"));
+    prefetcher.prefetch(fileUrl("b"));
+    prefetcher.prefetch(fileUrl("c"));
+
+    // Requesting a directory again makes it the most recently requested one,
+    // so "b" is dropped instead of "a" when "d" is prefetched.
+    prefetcher.prefetch(fileUrl("a"));
+    prefetcher.prefetch(fileUrl("d"));
+
+    QVERIFY(prefetcher.isPrefetched(fileUrl("a")));
+    QVERIFY(!prefetcher.isPrefetched(fileUrl("b")));
+    QVERIFY(prefetcher.isPrefetched(fileUrl("c")));
+    QVERIFY(prefetcher.isPrefetched(fileUrl("d")));
+}
+
+QUrl KDirectoryPrefetcherTest::fileUrl(const QString& name) const
+{
+    return QUrl::fromLocalFile(m_testDir->path() + '/' + name);
+}
+
+QTEST_GUILESS_MAIN(KDirectoryPrefetcherTest)
+
+#include "kdirectoryprefetchertest.moc"
@@ -20,9 +20,18 @@
 
 #include <QTest>
 #include <QSignalSpy>
+#include <QElapsedTimer>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 #include <random>
 
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
 #include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/private/kfileitemmodelsortalgorithm.h"
 
@@ -46,6 +55,39 @@ void myMessageOutput(QtMsgType type, const QMessageLogContext& context, const QS
     }
 }
 
+// Count all invocations of the global operator new, so that the
+// number of heap allocations of a benchmark can be reported.
+static std::atomic<qint64> allocationCount(0);
+
+void* operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+/**
+ * @return The peak resident set size of the process in kilobytes,
+ *         or -1 if it cannot be determined.
+ */
+static long peakResidentSetSize()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return -1;
+}
+
 Q_DECLARE_METATYPE(KFileItemList)
 Q_DECLARE_METATYPE(KItemRangeList)
 
@@ -59,6 +101,7 @@ public:
 private slots:
     void insertAndRemoveManyItems_data();
     void insertAndRemoveManyItems();
+    void refreshItemsWithInterleavedInserts();
 
 private:
     static KFileItemList createFileItemList(const QStringList& fileNames, const QString& urlPrefix = QLatin1String("file:///"));
@@ -167,7 +210,11 @@ void KFileItemModelBenchmark::insertAndRemoveManyItems()
     QSignalSpy spyItemsInserted(&model, &KFileItemModel::itemsInserted);
     QSignalSpy spyItemsRemoved(&model, &KFileItemModel::itemsRemoved);
 
+    const qint64 allocationsBefore = allocationCount;
+    int iterations = 0;
+
     QBENCHMARK {
+        ++iterations;
         model.slotClear();
         model.slotItemsAdded(model.directory(), initialItems);
         model.slotCompleted();
@@ -185,6 +232,10 @@ void KFileItemModelBenchmark::insertAndRemoveManyItems()
         QCOMPARE(model.count(), initialItems.count() + newItems.count() - removedItems.count());
     }
 
+    const qint64 allocationsPerIteration = (allocationCount - allocationsBefore) / qMax(1, iterations);
+    fprintf(stdout, "%s: %lld allocations per iteration, peak RSS %ld KiB\n",
+            QTest::currentDataTag(), static_cast<long long>(allocationsPerIteration), peakResidentSetSize());
+
     QVERIFY(model.isConsistent());
 
     for (int i = 0; i < model.count(); ++i) {
@@ -204,6 +255,70 @@ void KFileItemModelBenchmark::insertAndRemoveManyItems()
     }
 }
 
+void KFileItemModelBenchmark::refreshItemsWithInterleavedInserts()
+{
+    // The model contains the items with even numbers initially. The
+    // items with odd numbers are inserted in small batches in between
+    // refreshing items, like it happens while a directory is loaded.
+    const int initialCount = 100000;
+    const int rounds = 100;
+    const int insertedPerRound = 100;
+    const int refreshedPerRound = 1000;
+
+    QStringList initialNames;
+    QStringList newNames;
+    for (int i = 0; i < 2 * initialCount; ++i) {
+        const QString name = QStringLiteral("%1").arg(i, 6, 10, QLatin1Char('0'));
+        if (i % 2 == 0) {
+            initialNames << name;
+        } else {
+            newNames << name;
+        }
+    }
+
+    const KFileItemList initialItems = createFileItemList(initialNames);
+    KFileItemList newItems = createFileItemList(newNames);
+
+    std::mt19937 randomGenerator(0);
+    std::shuffle(newItems.begin(), newItems.end(), randomGenerator);
+    std::uniform_int_distribution<int> randomIndex(0, initialCount - 1);
+
+    QList<QPair<KFileItem, KFileItem> > refreshedItems;
+    refreshedItems.reserve(rounds * refreshedPerRound);
+    for (int i = 0; i < rounds * refreshedPerRound; ++i) {
+        const KFileItem& item = initialItems.at(randomIndex(randomGenerator));
+        refreshedItems.append(qMakePair(item, item));
+    }
+
+    KFileItemModel model;
+    model.m_naturalSorting = false;
+    model.setRoles({"text"});
+    model.slotItemsAdded(model.directory(), initialItems);
+    model.slotCompleted();
+    QCOMPARE(model.count(), initialCount);
+
+    qint64 refreshNanoseconds = 0;
+    QElapsedTimer timer;
+
+    QBENCHMARK_ONCE {
+        for (int round = 0; round < rounds; ++round) {
+            model.slotItemsAdded(model.directory(), newItems.mid(round * insertedPerRound, insertedPerRound));
+            model.slotCompleted();
+
+            timer.start();
+            model.slotRefreshItems(refreshedItems.mid(round * refreshedPerRound, refreshedPerRound));
+            refreshNanoseconds += timer.nsecsElapsed();
+        }
+    }
+
+    QCOMPARE(model.count(), initialCount + rounds * insertedPerRound);
+    QVERIFY(model.isConsistent());
+
+    const double refreshesPerSecond = rounds * refreshedPerRound * 1e9 / qMax<qint64>(1, refreshNanoseconds);
+    fprintf(stdout, "%i refreshes on %i items: %.0f refreshes per second\n",
+            rounds * refreshedPerRound, model.count(), refreshesPerSecond);
+}
+
 KFileItemList KFileItemModelBenchmark::createFileItemList(const QStringList& fileNames, const QString& prefix)
 {
     // Suppress 'file does not exist anymore' messages from KFileItemPrivate::init().
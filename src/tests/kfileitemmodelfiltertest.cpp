@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/private/kfileitemmodelfilter.h"
+
+#include <KFileItem>
+
+#include <QTest>
+
+class KFileItemModelFilterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testMatches_data();
+    void testMatches();
+    void testNarrows_data();
+    void testNarrows();
+};
+
+void KFileItemModelFilterTest::testMatches_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("no pattern") << QString() << "abc" << true;
+
+    QTest::newRow("sub-string") << "b" << "abc" << true;
+    QTest::newRow("sub-string, other case") << "B" << "abc" << true;
+    QTest::newRow("sub-string, no match") << "bd" << "abc" << false;
+    QTest::newRow("sub-string, non-ASCII") << "Ä" << "bäcker" << true;
+
+    QTest::newRow("suffix") << "*.txt" << "a.txt" << true;
+    QTest::newRow("suffix, other case") << "*.TXT" << "a.txt" << true;
+    QTest::newRow("suffix, no match") << "*.txt" << "a.txt.bak" << false;
+    QTest::newRow("any character") << "a?c" << "abc" << true;
+    QTest::newRow("any character, no match") << "a?c" << "ac" << false;
+    QTest::newRow("several stars") << "a*b*c" << "aXXbYYc" << true;
+    QTest::newRow("several stars, no match") << "a*b*c" << "aXXcYYb" << false;
+    QTest::newRow("subsequent stars") << "a**c" << "ac" << true;
+    QTest::newRow("set") << "[ab]*" << "bcd" << true;
+    QTest::newRow("negated set") << "[!ab]*" << "bcd" << false;
+    QTest::newRow("range") << "[a-c]x" << "Bx" << true;
+    QTest::newRow("range, no match") << "[a-c]x" << "dx" << false;
+    QTest::newRow("bracket in set") << "[]]*" << "]a" << true;
+    QTest::newRow("escaped star") << "\\*" << "*" << true;
+    QTest::newRow("escaped star, no match") << "\\*" << "a" << false;
+    QTest::newRow("non-ASCII") << "ä*" << "Äpfel" << true;
+
+    // Patterns with many tokens are matched by QRegExp.
+    QTest::newRow("long pattern") << QString(70, '?') << QString(70, 'a') << true;
+    QTest::newRow("long pattern, no match") << QString(70, '?') << QString(69, 'a') << false;
+}
+
+void KFileItemModelFilterTest::testMatches()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, fileName);
+    QFETCH(bool, expected);
+
+    KFileItemModelFilter filter;
+    filter.setPattern(pattern);
+
+    const KFileItem item(QUrl::fromLocalFile(QStringLiteral("/kfileitemmodelfiltertest/") + fileName), QString(), KFileItem::Unknown);
+    QCOMPARE(item.text(), fileName);
+    QCOMPARE(filter.matches(item), expected);
+}
+
+void KFileItemModelFilterTest::testNarrows_data()
+{
+    QTest::addColumn<QString>("previousPattern");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("no previous pattern") << QString() << "*.txt" << true;
+    QTest::newRow("appended character") << "f" << "fo" << true;
+    QTest::newRow("prepended character") << "B" << "abc" << true;
+    QTest::newRow("removed character") << "fo" << "f" << false;
+    QTest::newRow("other sub-string") << "fo" << "fa" << false;
+    QTest::newRow("wildcard") << "*" << "*.txt" << false;
+    QTest::newRow("previous wildcard") << "*.txt" << "*.txt1" << false;
+}
+
+void KFileItemModelFilterTest::testNarrows()
+{
+    QFETCH(QString, previousPattern);
+    QFETCH(QString, pattern);
+    QFETCH(bool, expected);
+
+    KFileItemModelFilter filter;
+    filter.setPattern(pattern);
+    QCOMPARE(filter.narrows(previousPattern), expected);
+}
+
+QTEST_GUILESS_MAIN(KFileItemModelFilterTest)
+
+#include "kfileitemmodelfiltertest.moc"
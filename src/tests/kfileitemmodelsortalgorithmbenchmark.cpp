@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/private/kfileitemmodelsortalgorithm.h"
+
+#include <QTest>
+
+#include <random>
+
+// Simulates the sort keys that KFileItemModel extracts before sorting:
+// Many items share the same value, e.g., the same modification time.
+struct SortKey
+{
+    qint64 number;
+    int index;
+};
+
+enum Algorithm {
+    MergeSort,
+    ParallelMergeSort,
+    WorkStealingMergeSort
+};
+
+Q_DECLARE_METATYPE(Algorithm)
+
+class KFileItemModelSortAlgorithmBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sortKeys_data();
+    void sortKeys();
+
+private:
+    static QList<SortKey> createKeys(int count);
+};
+
+void KFileItemModelSortAlgorithmBenchmark::sortKeys_data()
+{
+    QTest::addColumn<Algorithm>("algorithm");
+    QTest::addColumn<int>("count");
+
+    QList<int> counts;
+    counts << 100000 << 1000000;
+
+    foreach (int count, counts) {
+        const QByteArray suffix = "--n=" + QByteArray::number(count);
+        QTest::newRow(("mergeSort" + suffix).constData()) << MergeSort << count;
+        QTest::newRow(("parallelMergeSort" + suffix).constData()) << ParallelMergeSort << count;
+        QTest::newRow(("workStealingMergeSort" + suffix).constData()) << WorkStealingMergeSort << count;
+    }
+}
+
+void KFileItemModelSortAlgorithmBenchmark::sortKeys()
+{
+    QFETCH(Algorithm, algorithm);
+    QFETCH(int, count);
+
+    const QList<SortKey> keys = createKeys(count);
+    const int numberOfThreads = QThread::idealThreadCount();
+    auto lessThan = [](const SortKey& a, const SortKey& b) {
+        return a.number < b.number;
+    };
+
+    QList<SortKey> sortedKeys;
+    QBENCHMARK {
+        sortedKeys = keys;
+        sortedKeys.detach();
+
+        switch (algorithm) {
+        case MergeSort:
+            mergeSort(sortedKeys.begin(), sortedKeys.end(), lessThan);
+            break;
+        case ParallelMergeSort:
+            parallelMergeSort(sortedKeys.begin(), sortedKeys.end(), lessThan, numberOfThreads);
+            break;
+        case WorkStealingMergeSort:
+            workStealingMergeSort(sortedKeys.begin(), sortedKeys.end(), lessThan, numberOfThreads);
+            break;
+        }
+    }
+
+    // All algorithms must sort stably.
+    QCOMPARE(sortedKeys.count(), count);
+    for (int i = 1; i < count; ++i) {
+        const SortKey& previous = sortedKeys.at(i - 1);
+        const SortKey& current = sortedKeys.at(i);
+        QVERIFY(previous.number < current.number
+                || (previous.number == current.number && previous.index < current.index));
+    }
+}
+
+QList<SortKey> KFileItemModelSortAlgorithmBenchmark::createKeys(int count)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, count / 10);
+
+    QList<SortKey> keys;
+    keys.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        SortKey key;
+        key.number = distribution(generator);
+        key.index = i;
+        keys.append(key);
+    }
+    return keys;
+}
+
+QTEST_GUILESS_MAIN(KFileItemModelSortAlgorithmBenchmark)
+
+#include "kfileitemmodelsortalgorithmbenchmark.moc"
@@ -25,6 +25,8 @@
 
 #include <kio/job.h>
 
+#include <algorithm>
+
 #include "kitemviews/kfileitemmodel.h"
 #include "kitemviews/private/kfileitemmodeldirlister.h"
 #include "testdir.h"
@@ -68,10 +70,16 @@ private slots:
     void testRemoveItems();
     void testDirLoadingCompleted();
     void testSetData();
+    void testSetItemsData();
+    void testTransaction();
+    void testItemFlags();
     void testSetDataWithModifiedSortRole_data();
     void testSetDataWithModifiedSortRole();
+    void testResortChangedItems();
+    void testResortChangedItemsChainedMoves();
     void testChangeSortRole();
     void testResortAfterChangingName();
+    void testSortDirectoriesBySize();
     void testModelConsistencyWhenInsertingItems();
     void testItemRangeConsistencyWhenInsertingItems();
     void testExpandItems();
@@ -93,9 +101,12 @@ private slots:
     void testChangeRolesForFilteredItems();
     void testChangeSortRoleWhileFiltering();
     void testRefreshFilteredItems();
+    void testToggleNameFilter();
     void testCollapseFolderWhileLoading();
     void testCreateMimeData();
     void testDeleteFileMoreThanOnce();
+    void testStreamingInsertion();
+    void testAsynchronousSorting();
 
 private:
     QStringList itemsInModel() const;
@@ -265,6 +276,166 @@ void KFileItemModelTest::testSetData()
     QVERIFY(m_model->isConsistent());
 }
 
+void KFileItemModelTest::testSetItemsData()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt", "e.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 5);
+
+    const KFileItem itemD = m_model->fileItem(3);
+
+    QVector<KFileItemModel::ItemValues> itemValues;
+    for (int index : {3, 0, 1, 4}) {
+        KFileItemModel::ItemValues values;
+        values.index = index;
+        values.values.insert("customRole", index);
+        itemValues.append(values);
+    }
+
+    // Setting a value that has not been changed does not result in a signal.
+    itemValues[3].values = m_model->data(4);
+
+    // Replace the KFileItem of "d.txt".
+    itemValues[0].item = KFileItem(itemD.url(), QStringLiteral("text/plain"), itemD.mode());
+
+    m_model->setItemsData(itemValues);
+
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    const QList<QVariant> arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 2) << KItemRange(3, 1));
+    QCOMPARE(arguments.at(1).value<QSet<QByteArray> >(), QSet<QByteArray>() << "customRole");
+
+    QCOMPARE(m_model->data(0).value("customRole").toInt(), 0);
+    QCOMPARE(m_model->data(1).value("customRole").toInt(), 1);
+    QVERIFY(!m_model->data(2).contains("customRole"));
+    QCOMPARE(m_model->data(3).value("customRole").toInt(), 3);
+    QVERIFY(!m_model->data(4).contains("customRole"));
+
+    QCOMPARE(m_model->fileItem(3).mimetype(), QStringLiteral("text/plain"));
+
+    // Replacing only the KFileItem does not result in a signal.
+    const KFileItem itemC = m_model->fileItem(2);
+    itemValues.clear();
+    KFileItemModel::ItemValues itemValue;
+    itemValue.index = 2;
+    itemValue.item = KFileItem(itemC.url(), QStringLiteral("text/plain"), itemC.mode());
+    itemValues.append(itemValue);
+    m_model->setItemsData(itemValues);
+
+    QVERIFY(itemsChangedSpy.isEmpty());
+    QCOMPARE(m_model->fileItem(2).mimetype(), QStringLiteral("text/plain"));
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testTransaction()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsChangedSpy(m_model, &KFileItemModel::itemsChanged);
+
+    m_testDir->createFiles({"a.txt", "b.txt", "c.txt", "d.txt", "e.txt"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 5);
+    QCOMPARE(m_model->itemsChangedPerSecond(), 0);
+
+    QHash<QByteArray, QVariant> values;
+    values.insert("customRole1", "Test1");
+
+    m_model->beginTransaction();
+    m_model->setData(4, values);
+    m_model->setData(0, values);
+
+    // Nested transactions are committed by the outermost endTransaction().
+    m_model->beginTransaction();
+    QVector<KFileItemModel::ItemValues> itemValues;
+    KFileItemModel::ItemValues itemValue;
+    itemValue.index = 1;
+    itemValue.values.insert("customRole2", "Test2");
+    itemValues.append(itemValue);
+    m_model->setItemsData(itemValues);
+    m_model->endTransaction();
+
+    // Setting the same values again does not result in a change.
+    m_model->setData(0, values);
+
+    // Items that are refreshed by the directory lister are collected as well.
+    const KFileItem refreshedItem = m_model->fileItem(2);
+    m_model->slotRefreshItems({qMakePair(refreshedItem, refreshedItem)});
+
+    QVERIFY(itemsChangedSpy.isEmpty());
+    QCOMPARE(m_model->data(0).value("customRole1").toString(), QString("Test1"));
+    QCOMPARE(m_model->data(1).value("customRole2").toString(), QString("Test2"));
+
+    m_model->endTransaction();
+
+    QCOMPARE(itemsChangedSpy.count(), 1);
+    const QList<QVariant> arguments = itemsChangedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).value<KItemRangeList>(), KItemRangeList() << KItemRange(0, 3) << KItemRange(4, 1));
+    QCOMPARE(arguments.at(1).value<QSet<QByteArray> >(), QSet<QByteArray>() << "customRole1" << "customRole2");
+    QCOMPARE(m_model->itemsChangedPerSecond(), 1);
+
+    // Nothing is emitted if no item has been changed.
+    m_model->beginTransaction();
+    m_model->endTransaction();
+    QVERIFY(itemsChangedSpy.isEmpty());
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testItemFlags()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    m_testDir->createFiles({"a", "b", "c"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c");
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::FinishedFlag), 0);
+
+    m_model->setItemFlag(0, KFileItemModel::FinishedFlag, true);
+    m_model->setItemFlag(2, KFileItemModel::FinishedFlag, true);
+    m_model->setItemFlag(2, KFileItemModel::FinishedFlag, true);
+    m_model->setItemFlag(2, KFileItemModel::ChangedFlag, true);
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::FinishedFlag), 2);
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::ChangedFlag), 1);
+
+    // Invalid indexes are ignored.
+    m_model->setItemFlag(3, KFileItemModel::ChangedFlag, true);
+    QVERIFY(!m_model->itemFlag(-1, KFileItemModel::FinishedFlag));
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::ChangedFlag), 1);
+
+    // The flags move together with the items.
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "c" << "b" << "a");
+    QVERIFY(m_model->itemFlag(0, KFileItemModel::FinishedFlag));
+    QVERIFY(m_model->itemFlag(0, KFileItemModel::ChangedFlag));
+    QVERIFY(!m_model->itemFlag(1, KFileItemModel::FinishedFlag));
+    QVERIFY(m_model->itemFlag(2, KFileItemModel::FinishedFlag));
+    QVERIFY(!m_model->itemFlag(2, KFileItemModel::ChangedFlag));
+
+    // The flags of items which are removed from the model are unset.
+    m_model->setNameFilter("a");
+    QCOMPARE(itemsInModel(), QStringList() << "a");
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::FinishedFlag), 1);
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::ChangedFlag), 0);
+
+    m_model->setNameFilter(QString());
+    QCOMPARE(itemsInModel(), QStringList() << "c" << "b" << "a");
+    QVERIFY(!m_model->itemFlag(0, KFileItemModel::FinishedFlag));
+    QVERIFY(m_model->itemFlag(2, KFileItemModel::FinishedFlag));
+
+    m_model->resetItemFlag(KFileItemModel::FinishedFlag);
+    QCOMPARE(m_model->itemFlagCount(KFileItemModel::FinishedFlag), 0);
+    QVERIFY(!m_model->itemFlag(2, KFileItemModel::FinishedFlag));
+    QVERIFY(m_model->isConsistent());
+}
+
 void KFileItemModelTest::testSetDataWithModifiedSortRole_data()
 {
     QTest::addColumn<int>("changedIndex");
@@ -350,6 +521,89 @@ void KFileItemModelTest::testSetDataWithModifiedSortRole()
     QVERIFY(m_model->isConsistent());
 }
 
+void KFileItemModelTest::testResortChangedItems()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QVERIFY(itemsInsertedSpy.isValid());
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+    QVERIFY(itemsMovedSpy.isValid());
+
+    m_model->setSortRole("rating");
+    m_testDir->createFiles({"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 10);
+
+    // Give the items the ratings 10, 20, ..., 100. Starting with the last
+    // item keeps the order intact, so no resorting is triggered.
+    for (int index = m_model->count() - 1; index >= 0; --index) {
+        QHash<QByteArray, QVariant> rating;
+        rating.insert("rating", (index + 1) * 10);
+        m_model->setData(index, rating);
+    }
+    QVERIFY(!m_model->m_resortAllItemsTimer->isActive());
+
+    // Change the ratings of "b" (20 -> 45) and "i" (90 -> 65). Only the items
+    // between the old and the new positions of the changed items may be moved.
+    QHash<QByteArray, QVariant> ratingB;
+    ratingB.insert("rating", 45);
+    m_model->setData(1, ratingB);
+
+    QHash<QByteArray, QVariant> ratingI;
+    ratingI.insert("rating", 65);
+    m_model->setData(8, ratingI);
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "c" << "d" << "b" << "e" << "f" << "i" << "g" << "h" << "j");
+    QCOMPARE(itemsMovedSpy.count(), 2);
+    QCOMPARE(itemsMovedSpy.first().at(0).value<KItemRange>(), KItemRange(1, 3));
+    QCOMPARE(itemsMovedSpy.takeFirst().at(1).value<QList<int> >(), QList<int>() << 3 << 1 << 2);
+    QCOMPARE(itemsMovedSpy.first().at(0).value<KItemRange>(), KItemRange(6, 3));
+    QCOMPARE(itemsMovedSpy.takeFirst().at(1).value<QList<int> >(), QList<int>() << 7 << 8 << 6);
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testResortChangedItemsChainedMoves()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QVERIFY(itemsInsertedSpy.isValid());
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+    QVERIFY(itemsMovedSpy.isValid());
+
+    m_model->setSortRole("rating");
+    m_testDir->createFiles({"a", "b", "c", "d"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(m_model->count(), 4);
+
+    for (int index = m_model->count() - 1; index >= 0; --index) {
+        QHash<QByteArray, QVariant> rating;
+        rating.insert("rating", (index + 1) * 10);
+        m_model->setData(index, rating);
+    }
+    QVERIFY(!m_model->m_resortAllItemsTimer->isActive());
+
+    // Change the ratings of "a" (10 -> 45) and "c" (30 -> 50), which results
+    // in the permutation [2, 0, 3, 1]. The block that starts with "a" must be
+    // extended by the item at its last index, so all items are moved at once.
+    QHash<QByteArray, QVariant> ratingA;
+    ratingA.insert("rating", 45);
+    m_model->setData(0, ratingA);
+
+    QHash<QByteArray, QVariant> ratingC;
+    ratingC.insert("rating", 50);
+    m_model->setData(2, ratingC);
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "b" << "d" << "a" << "c");
+    QCOMPARE(itemsMovedSpy.count(), 1);
+    QCOMPARE(itemsMovedSpy.first().at(0).value<KItemRange>(), KItemRange(0, 4));
+    QCOMPARE(itemsMovedSpy.first().at(1).value<QList<int> >(), QList<int>() << 2 << 0 << 3 << 1);
+    QVERIFY(m_model->isConsistent());
+}
+
 void KFileItemModelTest::testChangeSortRole()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -428,6 +682,47 @@ void KFileItemModelTest::testResortAfterChangingName()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "c.txt");
 }
 
+void KFileItemModelTest::testSortDirectoriesBySize()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsMovedSpy(m_model, &KFileItemModel::itemsMoved);
+
+    m_model->setSortRole("size");
+
+    m_testDir->createDir("a");
+    m_testDir->createDir("b");
+    m_testDir->createDir("c");
+    m_testDir->createDir("d");
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "a" << "b" << "c" << "d");
+
+    // The "size" of a directory is the number of its items. A known size of the
+    // contents is larger than any number of items, and directories with an
+    // unknown "size" are the smallest.
+    m_model->beginTransaction();
+    m_model->setData(0, {{"size", 5}});
+    m_model->setData(1, {{"size", 1}, {"contentsSize", QVariant::fromValue<KIO::filesize_t>(100)}});
+    m_model->setData(2, {{"size", 3}, {"contentsSize", QVariant::fromValue<KIO::filesize_t>(10)}});
+    m_model->endTransaction();
+
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "a" << "c" << "b");
+
+    QCOMPARE(m_model->data(1).value("size").type(), QVariant::Int);
+    QCOMPARE(m_model->data(1).value("size").toInt(), 5);
+    QVERIFY(!m_model->data(1).contains("contentsSize"));
+    QCOMPARE(m_model->data(3).value("size").toInt(), 1);
+    QCOMPARE(m_model->data(3).value("contentsSize").value<KIO::filesize_t>(), KIO::filesize_t(100));
+
+    // Resetting the size of the contents sorts the directory by its number of items.
+    itemsMovedSpy.clear();
+    m_model->setData(3, {{"contentsSize", QVariant()}});
+    QVERIFY(itemsMovedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "d" << "b" << "a" << "c");
+}
+
 void KFileItemModelTest::testModelConsistencyWhenInsertingItems()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1618,6 +1913,55 @@ void KFileItemModelTest::testRefreshFilteredItems()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "b.txt" << "d.jpg" << "e.jpg");
 }
 
+void KFileItemModelTest::testToggleNameFilter()
+{
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+    QSignalSpy itemsRemovedSpy(m_model, &KFileItemModel::itemsRemoved);
+
+    m_testDir->createFiles({"1a", "2b", "3a", "4b", "5a"});
+
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInModel(), QStringList() << "1a" << "2b" << "3a" << "4b" << "5a");
+    itemsInsertedSpy.clear();
+
+    // Hide the items which do not contain "b".
+    m_model->setNameFilter("b");
+    QCOMPARE(itemsInModel(), QStringList() << "2b" << "4b");
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    KItemRangeList itemRangeList = itemsRemovedSpy.takeFirst().at(0).value<KItemRangeList>();
+    QCOMPARE(itemRangeList, KItemRangeList() << KItemRange(0, 1) << KItemRange(2, 1) << KItemRange(4, 1));
+    QCOMPARE(itemsInsertedSpy.count(), 0);
+
+    // Swap the visible and the hidden items. The items which get visible
+    // again are inserted in between the remaining items.
+    m_model->setNameFilter("a");
+    QCOMPARE(itemsInModel(), QStringList() << "1a" << "3a" << "5a");
+    QCOMPARE(itemsRemovedSpy.count(), 1);
+    itemRangeList = itemsRemovedSpy.takeFirst().at(0).value<KItemRangeList>();
+    QCOMPARE(itemRangeList, KItemRangeList() << KItemRange(0, 2));
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    itemRangeList = itemsInsertedSpy.takeFirst().at(0).value<KItemRangeList>();
+    QCOMPARE(itemRangeList, KItemRangeList() << KItemRange(0, 3));
+
+    // Show all items again.
+    m_model->setNameFilter(QString());
+    QCOMPARE(itemsInModel(), QStringList() << "1a" << "2b" << "3a" << "4b" << "5a");
+    QCOMPARE(itemsRemovedSpy.count(), 0);
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    itemRangeList = itemsInsertedSpy.takeFirst().at(0).value<KItemRangeList>();
+    QCOMPARE(itemRangeList, KItemRangeList() << KItemRange(1, 1) << KItemRange(2, 1));
+
+    // Reverse the sort order while items are hidden, and verify that
+    // they are sorted correctly when they get visible again.
+    m_model->setNameFilter("b");
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QCOMPARE(itemsInModel(), QStringList() << "4b" << "2b");
+    m_model->setNameFilter(QString());
+    QCOMPARE(itemsInModel(), QStringList() << "5a" << "4b" << "3a" << "2b" << "1a");
+    QVERIFY(m_model->isConsistent());
+}
+
 void KFileItemModelTest::testCreateMimeData()
 {
     QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
@@ -1744,6 +2088,89 @@ void KFileItemModelTest::testDeleteFileMoreThanOnce()
     QCOMPARE(itemsInModel(), QStringList() << "a.txt" << "c.txt" << "d.txt");
 }
 
+void KFileItemModelTest::testStreamingInsertion()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+    QSignalSpy itemsInsertedSpy(m_model, &KFileItemModel::itemsInserted);
+
+    // Only local directories are inserted in batches.
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 0);
+
+    QStringList names;
+    KFileItemList items;
+    for (int i = 0; i < 2000; ++i) {
+        const QString name = QStringLiteral("%1").arg(i, 4, 10, QLatin1Char('0'));
+        names << name;
+        items.prepend(KFileItem(QUrl::fromLocalFile(m_testDir->path() + '/' + name), QString(), KFileItem::Unknown));
+    }
+
+    // Simulate that the dir lister reports many items in reverse order
+    // without completing the listing.
+    emit m_model->m_dirLister->itemsAdded(m_model->directory(), items);
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(m_model->m_streamingTimer->isActive());
+    QVERIFY(!m_model->m_maximumUpdateIntervalTimer->isActive());
+
+    // The first batch contains the 500 items at the top of the view.
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInsertedSpy.count(), 1);
+    QCOMPARE(itemsInModel(), names.mid(0, 500));
+    QVERIFY(m_model->isConsistent());
+
+    // The remaining items are merged into the model with the next batch.
+    QVERIFY(m_model->m_streamingTimer->isActive());
+    QVERIFY(itemsInsertedSpy.wait());
+    QCOMPARE(itemsInsertedSpy.count(), 2);
+    QCOMPARE(itemsInModel(), names);
+    QVERIFY(m_model->isConsistent());
+}
+
+void KFileItemModelTest::testAsynchronousSorting()
+{
+    QSignalSpy loadingCompletedSpy(m_model, &KFileItemModel::directoryLoadingCompleted);
+
+    // Only local directories are sorted asynchronously.
+    m_model->loadDirectory(m_testDir->url());
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(m_model->count(), 0);
+    loadingCompletedSpy.clear();
+
+    QStringList names;
+    KFileItemList items;
+    for (int i = 0; i < 20000; ++i) {
+        const QString name = QStringLiteral("%1").arg(i, 5, 10, QLatin1Char('0'));
+        names << name;
+        items.prepend(KFileItem(QUrl::fromLocalFile(m_testDir->path() + '/' + name), QString(), KFileItem::Unknown));
+    }
+
+    m_model->slotItemsAdded(m_model->directory(), items);
+    m_model->slotCompleted();
+
+    // The items are sorted by a worker thread. The loading is completed
+    // after the sorted items have been inserted.
+    QVERIFY(!m_model->m_itemsBeingSorted.isEmpty());
+    QCOMPARE(m_model->count(), 0);
+    QVERIFY(loadingCompletedSpy.wait());
+    QCOMPARE(itemsInModel(), names);
+    QVERIFY(m_model->isConsistent());
+
+    // Changing the sort order while the worker thread is running cancels it.
+    // The items are inserted when the loading has been completed.
+    m_model->slotClear();
+    m_model->slotItemsAdded(m_model->directory(), items);
+    m_model->slotCompleted();
+    QVERIFY(!m_model->m_itemsBeingSorted.isEmpty());
+    m_model->setSortOrder(Qt::DescendingOrder);
+    QVERIFY(m_model->m_itemsBeingSorted.isEmpty());
+    QVERIFY(loadingCompletedSpy.wait());
+
+    std::reverse(names.begin(), names.end());
+    QCOMPARE(itemsInModel(), names);
+    QVERIFY(m_model->isConsistent());
+}
+
 QStringList KFileItemModelTest::itemsInModel() const
 {
     QStringList items;
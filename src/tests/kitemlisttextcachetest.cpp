@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#include "kitemviews/private/kitemlisttextcache.h"
+
+#include <QTest>
+
+class KItemListTextCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void testHitsAndMisses();
+    void testKey();
+    void testCostLimit();
+};
+
+void KItemListTextCacheTest::init()
+{
+    KItemListTextCache::instance()->clear();
+}
+
+void KItemListTextCacheTest::testHitsAndMisses()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    const QFont font;
+    const KItemListTextCache::Key key = {"a.txt", font, 100, KItemListTextCache::DetailsText, 1};
+
+    QVERIFY(!cache->entry(key));
+    QCOMPARE(cache->hitCount(), 0);
+    QCOMPARE(cache->missCount(), 1);
+
+    const KItemListTextCache::Entry entry = {QStaticText("a.txt"), 30, 10};
+    cache->insert(key, entry);
+
+    const KItemListTextCache::Entry* cachedEntry = cache->entry(key);
+    QVERIFY(cachedEntry);
+    QCOMPARE(cachedEntry->staticText.text(), QStringLiteral("a.txt"));
+    QCOMPARE(cachedEntry->width, qreal(30));
+    QCOMPARE(cachedEntry->height, qreal(10));
+    QCOMPARE(cache->hitCount(), 1);
+    QCOMPARE(cache->missCount(), 1);
+
+    cache->clear();
+    QVERIFY(!cache->entry(key));
+    QCOMPARE(cache->hitCount(), 0);
+    QCOMPARE(cache->missCount(), 1);
+}
+
+void KItemListTextCacheTest::testKey()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    QFont font;
+    const KItemListTextCache::Key key = {"a.txt", font, 100, KItemListTextCache::IconsNameText, 3};
+    const KItemListTextCache::Entry entry = {QStaticText("a.txt"), 30, 10};
+    cache->insert(key, entry);
+
+    KItemListTextCache::Key otherKey = key;
+    otherKey.width = 50;
+    QVERIFY(!cache->entry(otherKey));
+
+    otherKey = key;
+    otherKey.type = KItemListTextCache::IconsRoleText;
+    QVERIFY(!cache->entry(otherKey));
+
+    otherKey = key;
+    otherKey.maxTextLines = 2;
+    QVERIFY(!cache->entry(otherKey));
+
+    otherKey = key;
+    otherKey.font.setBold(!font.bold());
+    QVERIFY(!cache->entry(otherKey));
+
+    otherKey = key;
+    QVERIFY(cache->entry(otherKey));
+}
+
+void KItemListTextCacheTest::testCostLimit()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    const QFont font;
+
+    // Many short texts fit into the cache.
+    for (int i = 0; i < 4000; ++i) {
+        const QString text = QString::number(i);
+        const KItemListTextCache::Key key = {text, font, 100, KItemListTextCache::DetailsText, 1};
+        cache->insert(key, {QStaticText(text), 30, 10});
+    }
+    const KItemListTextCache::Key firstShortKey = {"0", font, 100, KItemListTextCache::DetailsText, 1};
+    QVERIFY(cache->entry(firstShortKey));
+
+    // Long texts need more memory, so fewer of them are kept.
+    const int longTextCount = 100;
+    for (int i = 0; i < longTextCount; ++i) {
+        const QString text = QString(10000, QLatin1Char('a' + i % 26)) + QString::number(i);
+        const KItemListTextCache::Key key = {text, font, 100, KItemListTextCache::DetailsText, 1};
+        cache->insert(key, {QStaticText(text), 30, 10});
+    }
+
+    const QString firstLongText = QString(10000, QLatin1Char('a')) + QString::number(0);
+    const QString lastLongText = QString(10000, QLatin1Char('a' + (longTextCount - 1) % 26)) + QString::number(longTextCount - 1);
+    QVERIFY(!cache->entry({firstLongText, font, 100, KItemListTextCache::DetailsText, 1}));
+    QVERIFY(cache->entry({lastLongText, font, 100, KItemListTextCache::DetailsText, 1}));
+    QVERIFY(!cache->entry(firstShortKey));
+}
+
+QTEST_MAIN(KItemListTextCacheTest)
+
+#include "kitemlisttextcachetest.moc"
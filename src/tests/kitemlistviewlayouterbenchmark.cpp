@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+
+#include "kitemviews/kfileitemlistview.h"
+#include "kitemviews/kfileitemmodel.h"
+#include "kitemviews/kitemlistcontroller.h"
+
+#include <QTest>
+
+void myMessageOutput(QtMsgType type, const QMessageLogContext& context, const QString& msg)
+{
+    Q_UNUSED(context);
+
+    switch (type) {
+    case QtCriticalMsg:
+        fprintf(stderr, "Critical: %s\n", msg.toLocal8Bit().data());
+        break;
+    case QtFatalMsg:
+        fprintf(stderr, "Fatal: %s\n", msg.toLocal8Bit().data());
+        abort();
+    default:
+       break;
+    }
+}
+
+class KItemListViewLayouterBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void insertItemIntoIconsView();
+    void changeItemInIconsView();
+
+private:
+    static KFileItemList createFileItemList(const QStringList& fileNames);
+    static void fillModel(KFileItemModel* model);
+};
+
+/**
+ * Inserts and removes a single item in the middle of an Icons view
+ * that contains 100000 items.
+ */
+void KItemListViewLayouterBenchmark::insertItemIntoIconsView()
+{
+    KFileItemModel model;
+    KFileItemListView view;
+    view.setItemLayout(KFileItemListView::IconsLayout);
+    KItemListController controller(&model, &view);
+    view.setGeometry(QRectF(0, 0, 800, 600));
+
+    fillModel(&model);
+    QVERIFY(view.maximumScrollOffset() > 0);
+
+    const KFileItemList newItems = createFileItemList({"050001"});
+    QBENCHMARK {
+        model.slotItemsAdded(model.directory(), newItems);
+        model.slotCompleted();
+        QCOMPARE(model.count(), 100001);
+        view.maximumScrollOffset();
+
+        model.slotItemsDeleted(newItems);
+        QCOMPARE(model.count(), 100000);
+        view.maximumScrollOffset();
+    }
+}
+
+/**
+ * Changes the name of a single item in the middle of an Icons view
+ * that contains 100000 items, which might change the height of its row.
+ */
+void KItemListViewLayouterBenchmark::changeItemInIconsView()
+{
+    KFileItemModel model;
+    KFileItemListView view;
+    view.setItemLayout(KFileItemListView::IconsLayout);
+    KItemListController controller(&model, &view);
+    view.setGeometry(QRectF(0, 0, 800, 600));
+
+    fillModel(&model);
+    QVERIFY(view.maximumScrollOffset() > 0);
+
+    QHash<QByteArray, QVariant> longName;
+    longName.insert("text", QStringLiteral("050000 with a name that needs to be wrapped into several lines"));
+    QHash<QByteArray, QVariant> shortName;
+    shortName.insert("text", QStringLiteral("050000"));
+
+    QBENCHMARK {
+        model.setData(50000, longName);
+        view.maximumScrollOffset();
+
+        model.setData(50000, shortName);
+        view.maximumScrollOffset();
+    }
+}
+
+KFileItemList KItemListViewLayouterBenchmark::createFileItemList(const QStringList& fileNames)
+{
+    // Suppress 'file does not exist anymore' messages from KFileItemPrivate::init().
+    qInstallMessageHandler(myMessageOutput);
+
+    KFileItemList result;
+    foreach (const QString& name, fileNames) {
+        const KFileItem item(QUrl::fromLocalFile(QLatin1String("/") + name), QString(), KFileItem::Unknown);
+        result << item;
+    }
+    return result;
+}
+
+void KItemListViewLayouterBenchmark::fillModel(KFileItemModel* model)
+{
+    // Only use even numbers, so that inserting an odd number
+    // results in an item in the middle of the view.
+    QStringList fileNames;
+    for (int i = 0; i < 200000; i += 2) {
+        fileNames << QStringLiteral("%1").arg(i, 6, 10, QLatin1Char('0'));
+    }
+
+    model->slotItemsAdded(model->directory(), createFileItemList(fileNames));
+    model->slotCompleted();
+    QCOMPARE(model->count(), 100000);
+}
+
+QTEST_MAIN(KItemListViewLayouterBenchmark)
+
+#include "kitemlistviewlayouterbenchmark.moc"
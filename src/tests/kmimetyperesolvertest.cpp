@@ -0,0 +1,139 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/private/kmimetyperesolver.h"
+#include "testdir.h"
+
+#include <KIO/UDSEntry>
+
+#include <QSignalSpy>
+#include <QTest>
+
+class KMimeTypeResolverTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testResolve();
+    void testDetermineMimeTypes();
+
+private:
+    KFileItem createItem(const QString& name) const;
+
+private:
+    TestDir* m_testDir;
+    KFileItemList m_items;
+};
+
+void KMimeTypeResolverTest::initTestCase()
+{
+    qRegisterMetaType<QHash<QUrl, KFileItem> >();
+}
+
+void KMimeTypeResolverTest::init()
+{
+    m_testDir = new TestDir();
+
+    // The content of the files without extension must be inspected to
+    // determine their MIME types.
+    m_testDir->createFile("script", "#!/bin/sh\necho test\n");
+    m_testDir->createFile("page", "<html><body>test</body></html>\n");
+    m_testDir->createFile("text.txt");
+
+    m_items.clear();
+    m_items << createItem("script") << createItem("page") << createItem("text.txt");
+}
+
+void KMimeTypeResolverTest::cleanup()
+{
+    m_items.clear();
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KMimeTypeResolverTest::testResolve()
+{
+    KMimeTypeResolver resolver;
+    QSignalSpy mimeTypesResolvedSpy(&resolver, &KMimeTypeResolver::mimeTypesResolved);
+
+    foreach (const KFileItem& item, m_items) {
+        QVERIFY(KMimeTypeResolver::canResolve(item));
+    }
+
+    resolver.resolve(m_items);
+    QVERIFY(resolver.isResolving());
+
+    // Items which are being resolved already are ignored.
+    resolver.resolve(m_items);
+
+    QHash<QUrl, KFileItem> resolvedItems;
+    while (resolver.isResolving()) {
+        QVERIFY(mimeTypesResolvedSpy.wait());
+    }
+    foreach (const QList<QVariant>& arguments, mimeTypesResolvedSpy) {
+        const QHash<QUrl, KFileItem> items = arguments.at(0).value<QHash<QUrl, KFileItem> >();
+        for (QHash<QUrl, KFileItem>::const_iterator it = items.constBegin(); it != items.constEnd(); ++it) {
+            QVERIFY(!resolvedItems.contains(it.key()));
+            resolvedItems.insert(it.key(), it.value());
+        }
+    }
+
+    QCOMPARE(resolvedItems.count(), m_items.count());
+    QCOMPARE(resolvedItems.value(m_items.at(0).url()).mimetype(), QStringLiteral("application/x-shellscript"));
+    QCOMPARE(resolvedItems.value(m_items.at(1).url()).mimetype(), QStringLiteral("text/html"));
+    QCOMPARE(resolvedItems.value(m_items.at(2).url()).mimetype(), QStringLiteral("text/plain"));
+
+    // The passed items are not modified.
+    foreach (const KFileItem& item, m_items) {
+        QVERIFY(!item.isMimeTypeKnown());
+        QVERIFY(resolvedItems.value(item.url()).isMimeTypeKnown());
+        QVERIFY(!KMimeTypeResolver::canResolve(resolvedItems.value(item.url())));
+    }
+}
+
+void KMimeTypeResolverTest::testDetermineMimeTypes()
+{
+    // No MIME type is determined if the timeout has been exceeded already.
+    QCOMPARE(KMimeTypeResolver::determineMimeTypes(m_items, -1).count(), m_items.count());
+
+    QVERIFY(KMimeTypeResolver::determineMimeTypes(m_items, 10000).isEmpty());
+    QCOMPARE(m_items.at(0).mimetype(), QStringLiteral("application/x-shellscript"));
+    QCOMPARE(m_items.at(1).mimetype(), QStringLiteral("text/html"));
+    QCOMPARE(m_items.at(2).mimetype(), QStringLiteral("text/plain"));
+}
+
+KFileItem KMimeTypeResolverTest::createItem(const QString& name) const
+{
+    KIO::UDSEntry entry;
+    entry.insert(KIO::UDSEntry::UDS_NAME, name);
+    entry.insert(KIO::UDSEntry::UDS_FILE_TYPE, 0100000);    // S_IFREG might not be defined on non-Unix platforms.
+    entry.insert(KIO::UDSEntry::UDS_ACCESS, 0644);
+    entry.insert(KIO::UDSEntry::UDS_SIZE, 0);
+
+    // Delay the MIME type determination like KDirLister does.
+    return KFileItem(entry, m_testDir->url(), true, true);
+}
+
+QTEST_GUILESS_MAIN(KMimeTypeResolverTest)
+
+#include "kmimetyperesolvertest.moc"
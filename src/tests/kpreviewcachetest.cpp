@@ -0,0 +1,235 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/private/kpreviewcache.h"
+#include "testdir.h"
+
+#include <KFileItem>
+#include <KIO/UDSEntry>
+
+#include <QFile>
+#include <QImage>
+#include <QPixmap>
+#include <QStandardPaths>
+#include <QTest>
+
+class KPreviewCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testPreview();
+    void testPersistence();
+    void testDevicePixelRatio();
+    void testEncodedImages();
+    void testFlushAfterLoadingOtherDirectory();
+    void testRemoveOldCacheFiles();
+
+private:
+    KFileItem createItem(const QString& name, qint64 modificationTime, qint64 size) const;
+
+private:
+    TestDir* m_testDir;
+    QImage m_image;
+};
+
+void KPreviewCacheTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    m_image = QImage(16, 8, QImage::Format_ARGB32_Premultiplied);
+    m_image.fill(Qt::red);
+}
+
+void KPreviewCacheTest::init()
+{
+    m_testDir = new TestDir();
+    m_testDir->createFiles({"a", "b"});
+}
+
+void KPreviewCacheTest::cleanup()
+{
+    delete m_testDir;
+    m_testDir = nullptr;
+}
+
+void KPreviewCacheTest::testPreview()
+{
+    const KFileItem item = createItem("a", 1000, 4);
+    QVERIFY(KPreviewCache::canCache(item));
+    QVERIFY(!KPreviewCache::canCache(KFileItem(QUrl("http://example.org/a"))));
+
+    KPreviewCache cache;
+    cache.load(m_testDir->url(), "configuration");
+    QVERIFY(cache.preview(item).isNull());
+
+    cache.insert(item, m_image);
+    QCOMPARE(cache.preview(item).size(), m_image.size());
+
+    // Previews of modified files are invalid.
+    QVERIFY(cache.preview(createItem("a", 2000, 4)).isNull());
+    QVERIFY(cache.preview(createItem("a", 1000, 5)).isNull());
+    QVERIFY(cache.preview(createItem("b", 1000, 4)).isNull());
+}
+
+void KPreviewCacheTest::testPersistence()
+{
+    const KFileItem item = createItem("a", 1000, 4);
+    const KFileItem deletedItem = createItem("c", 1000, 4);
+
+    {
+        KPreviewCache cache;
+        cache.load(m_testDir->url(), "configuration");
+        cache.insert(item, m_image);
+        cache.insert(deletedItem, m_image);
+
+        // The previews are written to disk when the cache is destroyed.
+    }
+
+    KPreviewCache cache;
+    cache.load(m_testDir->url(), "configuration");
+
+    const QPixmap preview = cache.preview(item);
+    QCOMPARE(preview.size(), m_image.size());
+    QCOMPARE(preview.toImage().pixelColor(0, 0), QColor(Qt::red));
+
+    // Previews of files that do not exist are not stored.
+    QVERIFY(cache.preview(deletedItem).isNull());
+
+    // The previews of another configuration are stored separately.
+    cache.load(m_testDir->url(), "other configuration");
+    QVERIFY(cache.preview(item).isNull());
+
+    cache.load(m_testDir->url(), "configuration");
+    QVERIFY(!cache.preview(item).isNull());
+}
+
+void KPreviewCacheTest::testDevicePixelRatio()
+{
+    const KFileItem item = createItem("a", 1000, 4);
+
+    QImage image = m_image;
+    image.setDevicePixelRatio(2);
+
+    {
+        KPreviewCache cache;
+        cache.load(m_testDir->url(), "configuration");
+        cache.insert(item, image);
+        QCOMPARE(cache.preview(item).devicePixelRatio(), qreal(2));
+    }
+
+    KPreviewCache cache;
+    cache.load(m_testDir->url(), "configuration");
+    QCOMPARE(cache.preview(item).devicePixelRatio(), qreal(2));
+}
+
+void KPreviewCacheTest::testEncodedImages()
+{
+    const KFileItem item = createItem("a", 1000, 4);
+    const QString path = item.localPath();
+
+    KPreviewCache cache;
+    cache.load(m_testDir->url(), "configuration");
+    cache.insert(item, m_image);
+    QVERIFY(!cache.m_entries.value(path).image.isNull());
+
+    // The image is replaced by its PNG data after the cache file has been written.
+    cache.flush();
+    QTRY_VERIFY(cache.m_entries.value(path).image.isNull());
+    QVERIFY(!cache.m_entries.value(path).png.isEmpty());
+
+    const QPixmap preview = cache.preview(item);
+    QCOMPARE(preview.size(), m_image.size());
+    QCOMPARE(preview.toImage().pixelColor(0, 0), QColor(Qt::red));
+}
+
+void KPreviewCacheTest::testFlushAfterLoadingOtherDirectory()
+{
+    const KFileItem itemA = createItem("a", 1000, 4);
+    const KFileItem itemB = createItem("b", 1000, 4);
+
+    {
+        KPreviewCache cache;
+        cache.load(m_testDir->url(), "configuration");
+        cache.insert(itemA, m_image);
+    }
+
+    {
+        // The cache file is still mapped while the preview of "a" is read
+        // by the writer thread, although another directory is loaded.
+        KPreviewCache cache;
+        cache.load(m_testDir->url(), "configuration");
+        QVERIFY(!cache.preview(itemA).isNull());
+        cache.insert(itemB, m_image);
+        cache.flush();
+        cache.load(m_testDir->url(), "other configuration");
+        QVERIFY(cache.m_file.isNull());
+    }
+
+    KPreviewCache cache;
+    cache.load(m_testDir->url(), "configuration");
+    QCOMPARE(cache.preview(itemA).toImage().pixelColor(0, 0), QColor(Qt::red));
+    QCOMPARE(cache.preview(itemB).toImage().pixelColor(0, 0), QColor(Qt::red));
+}
+
+void KPreviewCacheTest::testRemoveOldCacheFiles()
+{
+    TestDir directory;
+
+    // Create cache files with a size of 10 bytes, "000..." is the oldest one.
+    const QDateTime now = QDateTime::currentDateTime();
+    QStringList filePaths;
+    for (int i = 0; i < 4; ++i) {
+        const QString filePath = directory.path() + QLatin1Char('/') + QString(32, QLatin1Char('0' + i));
+        directory.createFile(filePath, QByteArray(10, 'x'), now.addSecs(i * 60 - 600));
+        filePaths.append(filePath);
+    }
+
+    // Temporary files of QSaveFile are not removed.
+    const QString temporaryFilePath = filePaths.first() + QLatin1String(".abcdef");
+    directory.createFile(temporaryFilePath, QByteArray(100, 'x'), now.addSecs(-3600));
+
+    // The oldest file is kept because it has just been written.
+    KPreviewCache::removeOldCacheFiles(directory.path(), 25, filePaths.at(0));
+    QVERIFY(QFile::exists(filePaths.at(0)));
+    QVERIFY(!QFile::exists(filePaths.at(1)));
+    QVERIFY(!QFile::exists(filePaths.at(2)));
+    QVERIFY(QFile::exists(filePaths.at(3)));
+    QVERIFY(QFile::exists(temporaryFilePath));
+}
+
+KFileItem KPreviewCacheTest::createItem(const QString& name, qint64 modificationTime, qint64 size) const
+{
+    KIO::UDSEntry entry;
+    entry.insert(KIO::UDSEntry::UDS_NAME, name);
+    entry.insert(KIO::UDSEntry::UDS_FILE_TYPE, 0100000);    // S_IFREG might not be defined on non-Unix platforms.
+    entry.insert(KIO::UDSEntry::UDS_ACCESS, 0644);
+    entry.insert(KIO::UDSEntry::UDS_SIZE, size);
+    entry.insert(KIO::UDSEntry::UDS_MODIFICATION_TIME, modificationTime);
+
+    return KFileItem(entry, m_testDir->url(), true, true);
+}
+
+QTEST_MAIN(KPreviewCacheTest)
+
+#include "kpreviewcachetest.moc"
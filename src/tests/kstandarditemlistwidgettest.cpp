@@ -0,0 +1,244 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by the Dolphin developers                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA            *
+ ***************************************************************************/
+
+#include "kitemviews/kitemlistcontroller.h"
+#include "kitemviews/kstandarditem.h"
+#include "kitemviews/kstandarditemlistview.h"
+#include "kitemviews/kstandarditemlistwidget.h"
+#include "kitemviews/kstandarditemmodel.h"
+#include "kitemviews/private/kitemlisttextcache.h"
+
+#include <QTest>
+
+Q_DECLARE_METATYPE(KStandardItemListView::ItemLayout)
+
+namespace {
+    // Provides a text for the "rating" role that is too long for the widget.
+    class LongRatingTextInformant : public KStandardItemListWidgetInformant
+    {
+    protected:
+        QString roleText(const QByteArray& role, const QHash<QByteArray, QVariant>& values) const override
+        {
+            if (role == "rating") {
+                return QString(200, QLatin1Char('x'));
+            }
+            return KStandardItemListWidgetInformant::roleText(role, values);
+        }
+    };
+}
+
+class KStandardItemListWidgetTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void testParallelSizeHints_data();
+    void testParallelSizeHints();
+    void testRecycledWidgetTextCache();
+    void testRatingWidth();
+    void testElidedRatingTextWidth();
+
+private:
+    static void initIconsWidget(KStandardItemListWidget* widget, qreal width, const QList<QByteArray>& roles);
+};
+
+void KStandardItemListWidgetTest::init()
+{
+    KItemListTextCache::instance()->clear();
+}
+
+void KStandardItemListWidgetTest::testParallelSizeHints_data()
+{
+    QTest::addColumn<KStandardItemListView::ItemLayout>("layout");
+
+    QTest::newRow("Icons") << KStandardItemListView::IconsLayout;
+    QTest::newRow("Compact") << KStandardItemListView::CompactLayout;
+}
+
+/**
+ * The texts of more than 1000 items are measured on all CPU cores when the
+ * size hints are calculated, and the texts of fewer items are measured in the
+ * GUI thread. Both must result in the same size hints.
+ */
+void KStandardItemListWidgetTest::testParallelSizeHints()
+{
+    QFETCH(KStandardItemListView::ItemLayout, layout);
+
+    const int count = 2500;
+    KStandardItemModel model;
+    for (int i = 0; i < count; ++i) {
+        // Texts of different lengths, so that they are wrapped differently
+        model.appendItem(new KStandardItem(QString("Item %1 ").arg(i).repeated(i % 7 + 1)));
+    }
+
+    KStandardItemListView view;
+    view.setItemLayout(layout);
+    view.setVisibleRoles({"text"});
+    KItemListController controller(&model, &view);
+    view.setGeometry(QRectF(0, 0, 800, 600));
+
+    QVector<qreal> parallelHints(count, 0.0);
+    qreal parallelWidthHint = 0.0;
+    view.calculateItemSizeHints(parallelHints, parallelWidthHint);
+
+    // Calculate the size hints of chunks of 500 items. Items with a
+    // non-zero size hint are skipped.
+    const int chunkSize = 500;
+    QVector<qreal> serialHints(count, 0.0);
+    qreal serialWidthHint = 0.0;
+    for (int begin = 0; begin < count; begin += chunkSize) {
+        QVector<qreal> hints(count, 1.0);
+        for (int i = begin; i < begin + chunkSize; ++i) {
+            hints[i] = 0.0;
+        }
+
+        view.calculateItemSizeHints(hints, serialWidthHint);
+
+        for (int i = begin; i < begin + chunkSize; ++i) {
+            serialHints[i] = hints.at(i);
+        }
+    }
+
+    QCOMPARE(parallelWidthHint, serialWidthHint);
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(parallelHints.at(i) > 0.0);
+        QCOMPARE(parallelHints.at(i), serialHints.at(i));
+    }
+}
+
+/**
+ * Widgets are recycled for other items while scrolling. The elided name and
+ * its width are taken from the text cache when the widget shows an item again.
+ */
+void KStandardItemListWidgetTest::testRecycledWidgetTextCache()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    KStandardItemListWidgetInformant informant;
+    const QString longText = QString("Long name ").repeated(20);
+
+    KStandardItemListWidget widget(&informant, nullptr);
+    initIconsWidget(&widget, 100, {"text"});
+
+    widget.setIndex(0);
+    widget.setData({{"text", longText}});
+    const QRectF longTextRect = widget.textRect();
+    const QString elidedText = widget.m_textInfo.value("text")->staticText.text();
+    QVERIFY(elidedText.length() < longText.length());
+    QCOMPARE(cache->hitCount(), 0);
+    QCOMPARE(cache->missCount(), 1);
+
+    widget.setIndex(1);
+    widget.setData({{"text", "a"}});
+    QVERIFY(widget.textRect().height() < longTextRect.height());
+    QCOMPARE(widget.m_textInfo.value("text")->staticText.text(), QStringLiteral("a"));
+    QCOMPARE(cache->missCount(), 2);
+
+    widget.setIndex(0);
+    widget.setData({{"text", longText}});
+    QCOMPARE(widget.textRect(), longTextRect);
+    QCOMPARE(widget.m_textRect, longTextRect);
+    QCOMPARE(widget.m_textInfo.value("text")->staticText.text(), elidedText);
+    QCOMPARE(cache->hitCount(), 1);
+    QCOMPARE(cache->missCount(), 2);
+
+    // A new widget that does not use the cache gets the same result.
+    cache->clear();
+    KStandardItemListWidget otherWidget(&informant, nullptr);
+    initIconsWidget(&otherWidget, 100, {"text"});
+    otherWidget.setIndex(0);
+    otherWidget.setData({{"text", longText}});
+    QCOMPARE(otherWidget.textRect(), longTextRect);
+    QCOMPARE(otherWidget.m_textInfo.value("text")->staticText.text(), elidedText);
+    QCOMPARE(cache->missCount(), 1);
+}
+
+/**
+ * The rating is shown as pixmap instead of its empty text, so the text
+ * rectangle must contain the pixmap, also if the text is taken from the cache.
+ */
+void KStandardItemListWidgetTest::testRatingWidth()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    KStandardItemListWidgetInformant informant;
+
+    KStandardItemListWidget widget(&informant, nullptr);
+    initIconsWidget(&widget, 200, {"text", "rating"});
+    const qreal padding = widget.styleOption().padding;
+
+    for (int index = 0; index < 2; ++index) {
+        widget.setIndex(index);
+        widget.setData({{"text", "a"}, {"rating", 4}});
+
+        const QRectF textRect = widget.textRect();
+        QVERIFY(!widget.m_rating.isNull());
+        QCOMPARE(textRect.width(), widget.m_rating.width() + 2 * padding);
+    }
+
+    QCOMPARE(cache->missCount(), 2);
+    QCOMPARE(cache->hitCount(), 2);
+}
+
+/**
+ * A rating text that has been elided keeps the width of the elided text,
+ * also if it is taken from the cache.
+ */
+void KStandardItemListWidgetTest::testElidedRatingTextWidth()
+{
+    KItemListTextCache* cache = KItemListTextCache::instance();
+    LongRatingTextInformant informant;
+
+    KStandardItemListWidget widget(&informant, nullptr);
+    initIconsWidget(&widget, 40, {"text", "rating"});
+    const qreal padding = widget.styleOption().padding;
+    const qreal maxWidth = widget.size().width() - 2 * padding;
+
+    for (int index = 0; index < 2; ++index) {
+        widget.setIndex(index);
+        widget.setData({{"text", "a"}, {"rating", 4}});
+
+        const QRectF textRect = widget.textRect();
+        QVERIFY(widget.m_rating.width() > maxWidth);
+        QVERIFY(widget.m_textInfo.value("rating")->staticText.text().length() < 200);
+        QVERIFY(textRect.width() <= maxWidth + 2 * padding);
+    }
+
+    QCOMPARE(cache->hitCount(), 2);
+}
+
+void KStandardItemListWidgetTest::initIconsWidget(KStandardItemListWidget* widget, qreal width, const QList<QByteArray>& roles)
+{
+    KItemListStyleOption option;
+    option.font = QFont();
+    option.font.setPixelSize(12);
+    option.fontMetrics = QFontMetrics(option.font);
+    option.padding = 2;
+    option.iconSize = 32;
+    option.maxTextLines = 2;
+
+    widget->setLayout(KStandardItemListWidget::IconsLayout);
+    widget->setStyleOption(option);
+    widget->setVisibleRoles(roles);
+    widget->resize(width, 150);
+}
+
+QTEST_MAIN(KStandardItemListWidgetTest)
+
+#include "kstandarditemlistwidgettest.moc"
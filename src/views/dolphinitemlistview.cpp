@@ -85,6 +85,7 @@ void DolphinItemListView::readSettings()
 
     setEnabledSelectionToggles(GeneralSettings::showSelectionToggle());
     setSupportsItemExpanding(itemLayoutSupportsItemExpanding(itemLayout()));
+    setDirectoryContentsSizeShown(!DetailsModeSettings::directorySizeCount());
 
     updateFont();
     updateGridSize();
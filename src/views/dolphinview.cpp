@@ -31,6 +31,7 @@
 #include "kitemviews/kitemlistcontroller.h"
 #include "kitemviews/kitemlistheader.h"
 #include "kitemviews/kitemlistselectionmanager.h"
+#include "kitemviews/private/kdirectoryprefetcher.h"
 #include "renamedialog.h"
 #include "versioncontrol/versioncontrolobserver.h"
 #include "viewproperties.h"
@@ -93,7 +94,10 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_clearSelectionBeforeSelectingNewItems(false),
     m_markFirstNewlySelectedItemAsCurrent(false),
     m_versionControlObserver(nullptr),
-    m_twoClicksRenamingTimer(nullptr)
+    m_twoClicksRenamingTimer(nullptr),
+    m_prefetcher(nullptr),
+    m_prefetchTimer(nullptr),
+    m_prefetchUrl()
 {
     m_topLayout = new QVBoxLayout(this);
     m_topLayout->setSpacing(0);
@@ -121,9 +125,10 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     const int delay = GeneralSettings::autoExpandFolders() ? 750 : -1;
     controller->setAutoActivationDelay(delay);
 
-    // The EnlargeSmallPreviews setting can only be changed after the model
-    // has been set in the view by KItemListController.
+    // The EnlargeSmallPreviews and DirectorySizeCount settings can only be
+    // changed after the model has been set in the view by KItemListController.
     m_view->setEnlargeSmallPreviews(GeneralSettings::enlargeSmallPreviews());
+    m_view->setDirectoryContentsSizeShown(!DetailsModeSettings::directorySizeCount());
 
     m_container = new KItemListContainer(controller, this);
     m_container->installEventFilter(this);
@@ -175,6 +180,8 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     KItemListSelectionManager* selectionManager = controller->selectionManager();
     connect(selectionManager, &KItemListSelectionManager::selectionChanged,
             this, &DolphinView::slotSelectionChanged);
+    connect(selectionManager, &KItemListSelectionManager::currentChanged,
+            this, &DolphinView::slotCurrentChanged);
 
 #ifdef HAVE_BALOO
     m_toolTipManager = new ToolTipManager(this);
@@ -191,6 +198,14 @@ DolphinView::DolphinView(const QUrl& url, QWidget* parent) :
     m_twoClicksRenamingTimer->setSingleShot(true);
     connect(m_twoClicksRenamingTimer, &QTimer::timeout, this, &DolphinView::slotTwoClicksRenamingTimerTimeout);
 
+    // Folders that are hovered or current for a short time are listed in the
+    // background, so that they can be shown immediately when they are entered.
+    m_prefetcher = new KDirectoryPrefetcher(this);
+    m_prefetchTimer = new QTimer(this);
+    m_prefetchTimer->setSingleShot(true);
+    m_prefetchTimer->setInterval(300);
+    connect(m_prefetchTimer, &QTimer::timeout, this, &DolphinView::slotPrefetchTimerTimeout);
+
     applyViewProperties();
     m_topLayout->addWidget(m_container);
 
@@ -1039,6 +1054,8 @@ void DolphinView::slotItemHovered(int index)
     }
 
     emit requestItemInfo(item);
+
+    schedulePrefetching(index);
 }
 
 void DolphinView::slotItemUnhovered(int index)
@@ -1046,6 +1063,14 @@ void DolphinView::slotItemUnhovered(int index)
     Q_UNUSED(index);
     hideToolTip();
     emit requestItemInfo(KFileItem());
+
+    m_prefetchTimer->stop();
+}
+
+void DolphinView::slotCurrentChanged(int current, int previous)
+{
+    Q_UNUSED(previous);
+    schedulePrefetching(current);
 }
 
 void DolphinView::slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event)
@@ -1615,13 +1640,36 @@ void DolphinView::loadDirectory(const QUrl& url, bool reload)
         return;
     }
 
+    m_prefetchTimer->stop();
+
     if (reload) {
         m_model->refreshDirectory(url);
     } else {
+        // If the folder has been prefetched, the items with known MIME types are
+        // handed over to the model. The dir lister of the model gets the items
+        // from the KIO dir lister cache, which has been filled by the prefetcher.
+        m_model->setPrefetchedItems(m_prefetcher->takeItems(url));
         m_model->loadDirectory(url);
     }
 }
 
+void DolphinView::schedulePrefetching(int index)
+{
+    const KFileItem item = m_model->fileItem(index);
+    if (item.isNull() || !item.isDir() || !item.isLocalFile() || m_model->isExpanded(index)) {
+        m_prefetchTimer->stop();
+        return;
+    }
+
+    m_prefetchUrl = item.url();
+    m_prefetchTimer->start();
+}
+
+void DolphinView::slotPrefetchTimerTimeout()
+{
+    m_prefetcher->prefetch(m_prefetchUrl);
+}
+
 void DolphinView::applyViewProperties()
 {
     const ViewProperties props(viewPropertiesUrl());
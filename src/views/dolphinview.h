@@ -36,6 +36,7 @@
 typedef KIO::FileUndoManager::CommandType CommandType;
 class QVBoxLayout;
 class DolphinItemListView;
+class KDirectoryPrefetcher;
 class KFileItemModel;
 class KItemListContainer;
 class KItemModelBase;
@@ -573,6 +574,7 @@ private slots:
     void slotHeaderColumnWidthChangeFinished(const QByteArray& role, qreal current);
     void slotItemHovered(int index);
     void slotItemUnhovered(int index);
+    void slotCurrentChanged(int current, int previous);
     void slotItemDropEvent(int index, QGraphicsSceneDragDropEvent* event);
     void slotModelChanged(KItemModelBase* current, KItemModelBase* previous);
     void slotMouseButtonPressed(int itemIndex, Qt::MouseButtons buttons);
@@ -710,9 +712,23 @@ private slots:
 
     void slotTwoClicksRenamingTimerTimeout();
 
+    /**
+     * Starts prefetching the folder that has been scheduled by
+     * schedulePrefetching().
+     */
+    void slotPrefetchTimerTimeout();
+
 private:
     void loadDirectory(const QUrl& url, bool reload = false);
 
+    /**
+     * Schedules prefetching the item with the index \a index, if it is a
+     * local folder that is likely to be entered next, because it is hovered
+     * or the current item. The folder is prefetched only if the item stays
+     * hovered or current for a short time.
+     */
+    void schedulePrefetching(int index);
+
     /**
      * Applies the view properties which are defined by the current URL
      * to the DolphinView properties. The view properties are read from a
@@ -812,6 +828,10 @@ private:
     QTimer* m_twoClicksRenamingTimer;
     QUrl m_twoClicksRenamingItemUrl;
 
+    KDirectoryPrefetcher* m_prefetcher;
+    QTimer* m_prefetchTimer;
+    QUrl m_prefetchUrl;
+
     // For unit tests
     friend class TestBase;
     friend class DolphinDetailsViewTest;